@@ -17,6 +17,9 @@
 
 #include "command.h"
 #include "image.h"
+#include "math/lanczos.h"
+
+#include <random>
 
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
@@ -29,6 +32,12 @@ const char* const dtypes[] = { "float32", "float64", NULL };
 
 const char* const estimators[] = { "exp1", "exp2", NULL };
 
+const char* const solvers[] = { "full", "lanczos", NULL };
+
+// maximum residual norm of a Ritz pair, relative to its Ritz value, for it to
+// be considered to have converged in the truncated decomposition:
+constexpr double lanczos_tolerance = 1.0e-3;
+
 
 void usage ()
 {
@@ -94,7 +103,17 @@ void usage ()
     + Option ("estimator", "Select the noise level estimator (default = Exp2), either: \n"
                            "* Exp1: the original estimator used in Veraart et al. (2016), or \n"
                            "* Exp2: the improved estimator introduced in Cordero-Grande et al. (2019).")
-    +   Argument ("Exp1/Exp2").type_choice(estimators);
+    +   Argument ("Exp1/Exp2").type_choice(estimators)
+
+    + Option ("solver", "Select the eigenvalue solver (default = full), either: \n"
+                        "* full: the complete eigenvalue decomposition of the patch covariance matrix, or \n"
+                        "* lanczos: a truncated decomposition using the Lanczos algorithm, which only resolves "
+                        "the signal components and the largest noise components, as required to determine the "
+                        "Marchenko-Pastur cut-off. This is considerably faster for large patch sizes on data "
+                        "with many volumes, at the expense of a small approximation error in the noise level "
+                        "estimate; the full decomposition is used for any patch where the cut-off cannot be "
+                        "located within the components that have converged.")
+    +   Argument ("full/lanczos").type_choice(solvers);
 
 
   COPYRIGHT = "Copyright (c) 2016 New York University, University of Antwerp, and the MRtrix3 contributors \n \n"
@@ -128,15 +147,35 @@ class DenoisingFunctor {
 
   using MatrixType = Eigen::Matrix<F, Eigen::Dynamic, Eigen::Dynamic>;
   using SValsType = Eigen::VectorXd;
+  // the Gram matrix is accumulated in double precision in sliding-window
+  // mode, to avoid drift from the repeated addition & subtraction of planes:
+  using GramValueType = typename std::conditional<is_complex<F>::value, cdouble, double>::type;
+  using GramType = Eigen::Matrix<GramValueType, Eigen::Dynamic, Eigen::Dynamic>;
 
   DenoisingFunctor (int ndwi, const vector<uint32_t>& extent,
-                    Image<bool>& mask, Image<real_type>& noise, bool exp1)
+                    Image<bool>& mask, Image<real_type>& noise, bool exp1, bool lanczos)
     : extent {{extent[0]/2, extent[1]/2, extent[2]/2}},
       m (ndwi), n (extent[0]*extent[1]*extent[2]),
-      r (std::min(m,n)), q (std::max(m,n)), exp1(exp1),
+      r (std::min(m,n)), q (std::max(m,n)), exp1(exp1), lanczos (lanczos),
       X (m,n), pos {{0, 0, 0}},
       mask (mask), noise (noise)
-  { }
+  {
+    if (lanczos) {
+      // fixed pseudo-random starting vector, for reproducible results:
+      std::mt19937 rng (r);
+      std::normal_distribution<double> normal;
+      v0.resize (r);
+      for (ssize_t i = 0; i < r; ++i)
+        v0[i] = normal (rng);
+      v0.normalize();
+    }
+  }
+
+  //! whether the Gram matrix can be updated incrementally along each row
+  /*! This is only possible when the Gram matrix is computed as X*X^T
+   * (i.e. the number of volumes does not exceed the number of voxels in the
+   * window), since its size is then independent of the window. */
+  bool sliding_window () const { return m <= n; }
 
   template <typename ImageType>
   void operator () (ImageType& dwi, ImageType& out)
@@ -157,37 +196,72 @@ class DenoisingFunctor {
       XtX.template triangularView<Eigen::Lower>() = X * X.adjoint();
     else
       XtX.template triangularView<Eigen::Lower>() = X.adjoint() * X;
-    Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
-    // eigenvalues sorted in increasing order:
-    SValsType s = eig.eigenvalues().template cast<double>();
 
-    // Marchenko-Pastur optimal threshold
-    const double lam_r = std::max(s[0], 0.0) / q;
-    double clam = 0.0;
-    sigma2 = 0.0;
-    ssize_t cutoff_p = 0;
-    for (ssize_t p = 0; p < r; ++p)     // p+1 is the number of noise components
-    {                                   // (as opposed to the paper where p is defined as the number of signal components)
-      double lam = std::max(s[p], 0.0) / q;
-      clam += lam;
-      double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
-      double sigsq1 = clam / double(p+1);
-      double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
-      // sigsq2 > sigsq1 if signal else noise
-      if (sigsq2 < sigsq1) {
-        sigma2 = sigsq1;
-        cutoff_p = p+1;
+    denoise (XtX, dwi, out);
+  }
+
+  //! process all voxels along the row of the image passing through the current position
+  /*! The Gram matrix X*X^T is a sum of contributions from each y-z plane
+   * of the window, so as the window slides along the row, it can be updated
+   * by adding the contributions of the planes entering the window, and
+   * subtracting those of the planes leaving it, rather than being
+   * recomputed in full for every voxel. */
+  template <typename ImageType>
+  void process_row (ImageType& dwi, ImageType& out)
+  {
+    assert (sliding_window());
+    window.clear();
+    for (auto l = Loop (0) (dwi, out); l; ++l) {
+      if (mask.valid()) {
+        assign_pos_of (dwi, 0, 3).to (mask);
+        if (!mask.value())
+          continue;
       }
+
+      update_gram (dwi);
+      MatrixType XtX (r,r);
+      XtX.template triangularView<Eigen::Lower>() = gram.template cast<F>();
+      X.col (n/2) = dwi.row(3);
+
+      denoise (XtX, dwi, out);
+    }
+  }
+
+private:
+  const std::array<ssize_t, 3> extent;
+  const ssize_t m, n, r, q;
+  const bool exp1, lanczos;
+  MatrixType X;
+  Eigen::Matrix<F, Eigen::Dynamic, 1> v0;
+  std::array<ssize_t, 3> pos;
+  double sigma2;
+  Image<bool> mask;
+  Image<real_type> noise;
+  // sliding-window state: Gram matrix & x indices of the planes it includes
+  GramType gram, plane;
+  vector<ssize_t> window;
+
+  template <typename ImageType>
+  void denoise (MatrixType& XtX, ImageType& dwi, ImageType& out)
+  {
+    // eigenvectors of signal components:
+    MatrixType U;
+    ssize_t cutoff_p = -1;
+    if (lanczos)
+      cutoff_p = truncated_eig (XtX, U);
+    if (cutoff_p < 0) {
+      Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
+      // eigenvalues sorted in increasing order:
+      cutoff_p = threshold (eig.eigenvalues().template cast<double>(), 0, 0.0);
+      U = eig.eigenvectors().rightCols (r-cutoff_p);
     }
 
     if (cutoff_p > 0) {
       // recombine data using only eigenvectors above threshold:
-      s.head (cutoff_p).setZero();
-      s.tail (r-cutoff_p).setOnes();
       if (m <= n)
-        X.col (n/2) = eig.eigenvectors() * ( s.cast<F>().asDiagonal() * ( eig.eigenvectors().adjoint() * X.col(n/2) ));
+        X.col (n/2) = U * ( U.adjoint() * X.col(n/2) );
       else
-        X.col (n/2) = X * ( eig.eigenvectors() * ( s.cast<F>().asDiagonal() * eig.eigenvectors().adjoint().col(n/2) ));
+        X.col (n/2) = X * ( U * U.row(n/2).adjoint() );
     }
 
     // Store output
@@ -201,15 +275,73 @@ class DenoisingFunctor {
     }
   }
 
-private:
-  const std::array<ssize_t, 3> extent;
-  const ssize_t m, n, r, q;
-  const bool exp1;
-  MatrixType X;
-  std::array<ssize_t, 3> pos;
-  double sigma2;
-  Image<bool> mask;
-  Image<real_type> noise;
+  // Marchenko-Pastur optimal threshold
+  /*! \a s holds the eigenvalues from index \a first onwards, sorted in
+   * increasing order; \a unresolved is the sum of the remaining (smallest)
+   * eigenvalues. Returns the number of noise components, and sets sigma2
+   * accordingly; if no noise component can be identified amongst those
+   * eigenvalues provided, returns -1 if \a first > 0. */
+  ssize_t threshold (const SValsType& s, ssize_t first, double unresolved)
+  {
+    const double lam_r = std::max(s[0], 0.0) / q;
+    double clam = std::max(unresolved, 0.0) / q;
+    sigma2 = 0.0;
+    ssize_t cutoff_p = first ? -1 : 0;
+    for (ssize_t p = first; p < r; ++p)     // p+1 is the number of noise components
+    {                                       // (as opposed to the paper where p is defined as the number of signal components)
+      double lam = std::max(s[p], 0.0) / q;
+      clam += lam;
+      double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
+      double sigsq1 = clam / double(p+1);
+      double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
+      // sigsq2 > sigsq1 if signal else noise
+      if (sigsq2 < sigsq1) {
+        sigma2 = sigsq1;
+        cutoff_p = p+1;
+      }
+    }
+    return cutoff_p;
+  }
+
+  // truncated eigendecomposition using the Lanczos algorithm
+  /*! The largest Ritz values are taken to have converged to the largest
+   * eigenvalues for as long as their residual remains within tolerance,
+   * with the smallest Ritz value providing the estimate of the smallest
+   * eigenvalue. The number of iterations is doubled until the
+   * Marchenko-Pastur cut-off lies within the converged components. Returns
+   * the number of noise components, and sets \a U to the eigenvectors of
+   * the signal components, or returns -1 if a full decomposition is
+   * required. */
+  ssize_t truncated_eig (const MatrixType& XtX, MatrixType& U)
+  {
+    const double trace = XtX.diagonal().real().template cast<double>().sum();
+    Math::Lanczos<MatrixType> solver;
+    for (ssize_t k = std::min<ssize_t> (32, r/2); k > 1 && 2*k <= r; k *= 2) {
+      // breakdown: invariant subspace found, cannot proceed reliably
+      if (!solver.compute (XtX, v0, k))
+        return -1;
+
+      const auto& theta = solver.eigenvalues();
+      const auto& residual = solver.residuals();
+      ssize_t resolved = 0;
+      while (resolved < k-1 && residual[k-1-resolved] <= lanczos_tolerance * std::abs (theta[k-1-resolved]))
+        ++resolved;
+      if (!resolved)
+        continue;
+
+      SValsType s (r);
+      s[0] = theta[0];
+      s.tail (resolved) = theta.tail (resolved);
+      const ssize_t first = r - resolved;
+      const ssize_t cutoff_p = threshold (s, first, trace - s.tail (resolved).sum());
+      if (cutoff_p < 0)
+        continue;
+
+      U = solver.eigenvectors (r-cutoff_p);
+      return cutoff_p;
+    }
+    return -1;
+  }
 
   template <typename ImageType>
   void load_data (ImageType& dwi) {
@@ -233,6 +365,60 @@ class DenoisingFunctor {
     dwi.index(2) = pos[2];
   }
 
+  template <typename ImageType>
+  void update_gram (ImageType& dwi) {
+    pos[0] = dwi.index(0); pos[1] = dwi.index(1); pos[2] = dwi.index(2);
+
+    // x indices of planes in current window, accounting for edge handling:
+    vector<ssize_t> current;
+    for (int x = -extent[0]; x <= extent[0]; x++)
+      current.push_back (wrapindex(x, 0, dwi.size(0)));
+
+    // identify planes entering & leaving the window:
+    vector<ssize_t> entering, leaving (window);
+    for (auto x : current) {
+      auto it = std::find (leaving.begin(), leaving.end(), x);
+      if (it == leaving.end())
+        entering.push_back (x);
+      else
+        leaving.erase (it);
+    }
+
+    if (window.empty() || entering.size() + leaving.size() >= current.size()) {
+      gram.setZero (m, m);
+      for (auto x : current)
+        add_plane (dwi, x, 1.0);
+    }
+    else {
+      for (auto x : entering)
+        add_plane (dwi, x, 1.0);
+      for (auto x : leaving)
+        add_plane (dwi, x, -1.0);
+    }
+    window.swap (current);
+
+    // reset image position
+    dwi.index(0) = pos[0];
+    dwi.index(1) = pos[1];
+    dwi.index(2) = pos[2];
+  }
+
+  template <typename ImageType>
+  void add_plane (ImageType& dwi, ssize_t x, double weight) {
+    plane.resize (m, (2*extent[1]+1) * (2*extent[2]+1));
+    dwi.index(0) = x;
+    size_t k = 0;
+    for (int z = -extent[2]; z <= extent[2]; z++) {
+      dwi.index(2) = wrapindex(z, 2, dwi.size(2));
+      for (int y = -extent[1]; y <= extent[1]; y++, k++) {
+        dwi.index(1) = wrapindex(y, 1, dwi.size(1));
+        X.col(0) = dwi.row(3);
+        plane.col(k) = X.col(0).template cast<GramValueType>();
+      }
+    }
+    gram.template selfadjointView<Eigen::Lower>().rankUpdate (plane, weight);
+  }
+
   inline size_t wrapindex(int r, int axis, int max) const {
     // patch handling at image edges
     int rr = pos[axis] + r;
@@ -244,9 +430,30 @@ class DenoisingFunctor {
 };
 
 
+
+template <typename F, class ImageType>
+class RowDenoisingFunctor {
+  MEMALIGN(RowDenoisingFunctor)
+
+public:
+  RowDenoisingFunctor (const DenoisingFunctor<F>& func, const ImageType& dwi, const ImageType& out) :
+    func (func), dwi (dwi), out (out) { }
+
+  void operator() (const Iterator& pos)
+  {
+    assign_pos_of (pos, 1, 3).to (dwi, out);
+    func.process_row (dwi, out);
+  }
+
+private:
+  DenoisingFunctor<F> func;
+  ImageType dwi, out;
+};
+
+
 template <typename T>
 void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
-                    const std::string& output_name, const vector<uint32_t>& extent, bool exp1)
+                    const std::string& output_name, const vector<uint32_t>& extent, bool exp1, bool lanczos)
   {
     auto input = data.get_image<T>().with_direct_io(3);
     // create output
@@ -254,8 +461,14 @@ void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
     header.datatype() = DataType::from<T>();
     auto output = Image<T>::create (output_name, header);
     // run
-    DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1);
-    ThreadedLoop ("running MP-PCA denoising", data, 0, 3).run (func, input, output);
+    DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1, lanczos);
+    if (func.sliding_window()) {
+      // process entire rows along x, so that the Gram matrix can be updated incrementally:
+      ThreadedLoop ("running MP-PCA denoising", data, vector<size_t> ({ 1, 2 }), vector<size_t> ({ 0 }))
+        .run_outer (RowDenoisingFunctor<T,Image<T>> (func, input, output));
+    }
+    else
+      ThreadedLoop ("running MP-PCA denoising", data, 0, 3).run (func, input, output);
   }
 
 
@@ -299,6 +512,7 @@ void run ()
   INFO("selected patch size: " + str(extent[0]) + " x " + str(extent[1]) + " x " + str(extent[2]) + ".");
 
   bool exp1 = get_option_value("estimator", 1) == 0;    // default: Exp2 (unbiased estimator)
+  bool lanczos = get_option_value("solver", 0) == 1;    // default: full eigendecomposition
 
   Image<real_type> noise;
   opt = get_options("noise");
@@ -314,19 +528,19 @@ void run ()
   switch (prec) {
     case 0:
       INFO("select real float32 for processing");
-      process_image<float>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<float>(dwi, mask, noise, argument[1], extent, exp1, lanczos);
       break;
     case 1:
       INFO("select real float64 for processing");
-      process_image<double>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<double>(dwi, mask, noise, argument[1], extent, exp1, lanczos);
       break;
     case 2:
       INFO("select complex float32 for processing");
-      process_image<cfloat>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<cfloat>(dwi, mask, noise, argument[1], extent, exp1, lanczos);
       break;
     case 3:
       INFO("select complex float64 for processing");
-      process_image<cdouble>(dwi, mask, noise, argument[1], extent, exp1);
+      process_image<cdouble>(dwi, mask, noise, argument[1], extent, exp1, lanczos);
       break;
   }
 
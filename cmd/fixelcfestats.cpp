@@ -199,7 +199,7 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
 
 void run()
 {
-  if (Path::has_suffix (argument[4], ".tck"))
+  if (Path::has_suffix (argument[4], { ".tck", ".tckz" }))
     throw Exception ("This version of fixelcfestats requires as input not a track file, but a "
                      "pre-calculated fixel-fixel connectivity matrix; in addition, input fixel "
                      "data must be pre-smoothed. Please check command / pipeline documentation "
@@ -52,6 +52,8 @@
       Op_##OPTION () : OpUnary (FEEDBACK, FLAGS & COMPLEX_MAPS_TO_REAL, FLAGS & REAL_MAPS_TO_COMPLEX) { } \
       complex_type R (real_type v) const REAL_OPERATION \
       complex_type Z (complex_type v) const COMPLEX_OPERATION \
+      template <typename ValueType> \
+        ValueType real_op (ValueType v) const { return to_real<ValueType> ([&] () REAL_OPERATION ()); } \
   };
 
 #define BINARY_OP(OPTION,FEEDBACK,FLAGS,DESCRIPTION,REAL_OPERATION,COMPLEX_OPERATION) \
@@ -60,6 +62,8 @@
       Op_##OPTION () : OpBinary (FEEDBACK, FLAGS & COMPLEX_MAPS_TO_REAL, FLAGS & REAL_MAPS_TO_COMPLEX) { } \
       complex_type R (real_type a, real_type b) const REAL_OPERATION \
       complex_type Z (complex_type a, complex_type b) const COMPLEX_OPERATION \
+      template <typename ValueType> \
+        ValueType real_op (ValueType a, ValueType b) const { return to_real<ValueType> ([&] () REAL_OPERATION ()); } \
   };
 
 #define TERNARY_OP(OPTION,FEEDBACK,FLAGS,DESCRIPTION,REAL_OPERATION,COMPLEX_OPERATION) \
@@ -68,6 +72,8 @@
       Op_##OPTION () : OpTernary (FEEDBACK, FLAGS & COMPLEX_MAPS_TO_REAL, FLAGS & REAL_MAPS_TO_COMPLEX) { } \
       complex_type R (real_type a, real_type b, real_type c) const REAL_OPERATION \
       complex_type Z (complex_type a, complex_type b, complex_type c) const COMPLEX_OPERATION \
+      template <typename ValueType> \
+        ValueType real_op (ValueType a, ValueType b, ValueType c) const { return to_real<ValueType> ([&] () REAL_OPERATION ()); } \
   };
 
 # elif SECTION == 3 // parsing section
@@ -196,6 +202,10 @@ static bool transform_mis_match_reported (false);
 
 inline bool is_true (const complex_type& z) { return z.real() || z.imag(); }
 
+// convert the result of a real-valued operation to the working precision:
+template <typename ValueType, typename T> inline ValueType to_real (const T& v) { return v; }
+template <typename ValueType, typename T> inline ValueType to_real (const std::complex<T>& z) { return z.real(); }
+
 
 void usage () {
 
@@ -227,7 +237,12 @@ DESCRIPTION
   "single-voxel 4D image of size [ 1 1 1 N ], multiplied by a 3D image of "
   "size [ X Y Z ], which would allow the creation of a 4D image where each "
   "volume consists of the 3D image scaled by the corresponding value for "
-  "that volume in the single-voxel image.";
+  "that volume in the single-voxel image."
+
+  + "Where no complex values are involved at any stage of the calculation, "
+  "the operations are evaluated directly on real values, in double precision "
+  "if the output datatype requires it (i.e. 64-bit floating-point or 32/64-bit "
+  "integer types), and in single precision otherwise.";
 
 EXAMPLES
   + Example ("Double the value stored in every voxel",
@@ -272,6 +287,7 @@ OPTIONS
 
 
 class Evaluator;
+template <typename ValueType> class RealStorage;
 
 
 class Chunk : public vector<complex_type> { NOMEMALIGN
@@ -322,13 +338,34 @@ class ThreadLocalStorage : public vector<ThreadLocalStorageItem> { NOMEMALIGN
 
 
 
-class LoadedImage { NOMEMALIGN
+// the header of each input image is held open until the precision of the
+// calculation is known, at which point the data are accessed using the
+// matching value type:
+class LoadedImage { MEMALIGN (LoadedImage)
   public:
-    LoadedImage (std::shared_ptr<Image<complex_type>>& i, const bool c) :
-        image (i),
-        image_is_complex (c) { }
-    std::shared_ptr<Image<complex_type>> image;
-    bool image_is_complex;
+    LoadedImage (Header&& H) :
+        header (std::move (H)),
+        is_complex (header.datatype().is_complex()) { }
+
+    template <typename ValueType>
+      Image<ValueType> get_image () {
+        Image<ValueType>& image (get (static_cast<ValueType*> (nullptr)));
+        if (!image.valid())
+          image = header.get_image<ValueType>();
+        return image;
+      }
+
+    Header header;
+    const bool is_complex;
+
+  private:
+    Image<complex_type> complex_image;
+    Image<float> float_image;
+    Image<double> double_image;
+
+    Image<complex_type>& get (complex_type*) { return complex_image; }
+    Image<float>& get (float*) { return float_image; }
+    Image<double>& get (double*) { return double_image; }
 };
 
 
@@ -339,14 +376,12 @@ class StackEntry { NOMEMALIGN
 
     StackEntry (const char* entry) :
         arg (entry),
-        rng_gaussian (false),
-        image_is_complex (false) { }
+        rng_gaussian (false) { }
 
     StackEntry (Evaluator* evaluator_p) :
         arg (nullptr),
         evaluator (evaluator_p),
-        rng_gaussian (false),
-        image_is_complex (false) { }
+        rng_gaussian (false) { }
 
     void load () {
       if (!arg)
@@ -354,15 +389,12 @@ class StackEntry { NOMEMALIGN
       auto search = image_list.find (arg);
       if (search != image_list.end()) {
         DEBUG (std::string ("image \"") + arg + "\" already loaded - re-using exising image");
-        image = search->second.image;
-        image_is_complex = search->second.image_is_complex;
+        image = search->second;
       }
       else {
         try {
-          auto header = Header::open (arg);
-          image_is_complex = header.datatype().is_complex();
-          image.reset (new Image<complex_type> (header.get_image<complex_type>()));
-          image_list.insert (std::make_pair (arg, LoadedImage (image, image_is_complex)));
+          image = std::make_shared<LoadedImage> (Header::open (arg));
+          image_list.insert (std::make_pair (arg, image));
         }
         catch (Exception& e_image) {
           try {
@@ -389,20 +421,22 @@ class StackEntry { NOMEMALIGN
 
     const char* arg;
     std::shared_ptr<Evaluator> evaluator;
-    std::shared_ptr<Image<complex_type>> image;
+    std::shared_ptr<LoadedImage> image;
     copy_ptr<Math::RNG> rng;
     complex_type value;
     bool rng_gaussian;
-    bool image_is_complex;
 
     bool is_complex () const;
+    bool is_real_valued () const;
 
-    static std::map<std::string, LoadedImage> image_list;
+    static std::map<std::string, std::shared_ptr<LoadedImage>> image_list;
 
     Chunk& evaluate (ThreadLocalStorage& storage) const;
+    template <typename ValueType>
+      ValueType* evaluate (RealStorage<ValueType>& storage) const;
 };
 
-std::map<std::string, LoadedImage> StackEntry::image_list;
+std::map<std::string, std::shared_ptr<LoadedImage>> StackEntry::image_list;
 
 
 class Evaluator { NOMEMALIGN
@@ -430,6 +464,19 @@ class Evaluator { NOMEMALIGN
     virtual Chunk& evaluate (Chunk& a, Chunk& b) const { throw Exception ("operation \"" + id + "\" not supported!"); return a; }
     virtual Chunk& evaluate (Chunk& a, Chunk& b, Chunk& c) const { throw Exception ("operation \"" + id + "\" not supported!"); return a; }
 
+    // evaluate the operands for the current block, then apply the operation
+    // in place to the first of them:
+    template <typename ValueType>
+      ValueType* evaluate (RealStorage<ValueType>& storage) const {
+        ValueType* in[3];
+        for (size_t n = 0; n < num_args(); ++n)
+          in[n] = operands[n].evaluate (storage);
+        evaluate_block (in, storage.block_size());
+        return in[0];
+      }
+    virtual void evaluate_block (float** in, size_t num) const { throw Exception ("operation \"" + id + "\" not supported!"); }
+    virtual void evaluate_block (double** in, size_t num) const { throw Exception ("operation \"" + id + "\" not supported!"); }
+
     virtual bool is_complex () const {
       for (size_t n = 0; n < operands.size(); ++n)
         if (operands[n].is_complex())
@@ -443,7 +490,7 @@ class Evaluator { NOMEMALIGN
 
 
 inline bool StackEntry::is_complex () const {
-  if (image) return image_is_complex;
+  if (image) return image->is_complex;
   if (evaluator) return evaluator->is_complex();
   if (rng) return false;
   return value.imag() != 0.0;
@@ -451,6 +498,20 @@ inline bool StackEntry::is_complex () const {
 
 
 
+// true if no complex values are involved at any stage of the calculation:
+inline bool StackEntry::is_real_valued () const {
+  if (is_complex())
+    return false;
+  if (evaluator) {
+    for (const auto& operand : evaluator->operands)
+      if (!operand.is_real_valued())
+        return false;
+  }
+  return true;
+}
+
+
+
 inline Chunk& StackEntry::evaluate (ThreadLocalStorage& storage) const
 {
   if (evaluator) return evaluator->evaluate (storage);
@@ -473,6 +534,15 @@ inline Chunk& StackEntry::evaluate (ThreadLocalStorage& storage) const
 
 
 
+template <typename ValueType>
+inline ValueType* StackEntry::evaluate (RealStorage<ValueType>& storage) const
+{
+  if (evaluator) return evaluator->evaluate (storage);
+  return storage.next();
+}
+
+
+
 
 
 
@@ -500,7 +570,7 @@ inline void replace (std::string& orig, size_t n, const std::string& value)
 std::string operation_string (const StackEntry& entry)
 {
   if (entry.image)
-    return entry.image->name();
+    return entry.image->header.name();
   else if (entry.rng)
     return entry.rng_gaussian ? "randn()" : "rand()";
   else if (entry.evaluator) {
@@ -537,6 +607,16 @@ class UnaryEvaluator : public Evaluator { NOMEMALIGN
 
       return in;
     }
+
+    virtual void evaluate_block (float** in, size_t num) const { evaluate_real (in, num); }
+    virtual void evaluate_block (double** in, size_t num) const { evaluate_real (in, num); }
+
+    template <typename ValueType>
+      void evaluate_real (ValueType** in, size_t num) const {
+        ValueType* a (in[0]);
+        for (size_t n = 0; n < num; ++n)
+          a[n] = op.real_op (a[n]);
+      }
 };
 
 
@@ -573,6 +653,17 @@ class BinaryEvaluator : public Evaluator { NOMEMALIGN
       return out;
     }
 
+    virtual void evaluate_block (float** in, size_t num) const { evaluate_real (in, num); }
+    virtual void evaluate_block (double** in, size_t num) const { evaluate_real (in, num); }
+
+    template <typename ValueType>
+      void evaluate_real (ValueType** in, size_t num) const {
+        ValueType* a (in[0]);
+        const ValueType* b (in[1]);
+        for (size_t n = 0; n < num; ++n)
+          a[n] = op.real_op (a[n], b[n]);
+      }
+
 };
 
 
@@ -609,6 +700,18 @@ class TernaryEvaluator : public Evaluator { NOMEMALIGN
       return out;
     }
 
+    virtual void evaluate_block (float** in, size_t num) const { evaluate_real (in, num); }
+    virtual void evaluate_block (double** in, size_t num) const { evaluate_real (in, num); }
+
+    template <typename ValueType>
+      void evaluate_real (ValueType** in, size_t num) const {
+        ValueType* a (in[0]);
+        const ValueType* b (in[1]);
+        const ValueType* c (in[2]);
+        for (size_t n = 0; n < num; ++n)
+          a[n] = op.real_op (a[n], b[n], c[n]);
+      }
+
 };
 
 
@@ -711,26 +814,28 @@ void get_header (const StackEntry& entry, Header& header)
   if (!entry.image)
     return;
 
+  const Header& image (entry.image->header);
+
   if (header.ndim() == 0) {
-    header = *entry.image;
+    header = image;
     return;
   }
 
-  if (header.ndim() < entry.image->ndim())
-    header.ndim() = entry.image->ndim();
-  for (size_t n = 0; n < std::min<size_t> (header.ndim(), entry.image->ndim()); ++n) {
-    if (header.size(n) > 1 && entry.image->size(n) > 1 && header.size(n) != entry.image->size(n))
+  if (header.ndim() < image.ndim())
+    header.ndim() = image.ndim();
+  for (size_t n = 0; n < std::min<size_t> (header.ndim(), image.ndim()); ++n) {
+    if (header.size(n) > 1 && image.size(n) > 1 && header.size(n) != image.size(n))
       throw Exception ("dimensions of input images do not match - aborting");
-    if (!voxel_grids_match_in_scanner_space (header, *(entry.image), 1.0e-4) && !transform_mis_match_reported) {
+    if (!voxel_grids_match_in_scanner_space (header, image, 1.0e-4) && !transform_mis_match_reported) {
       WARN ("header transformations of input images do not match");
       transform_mis_match_reported = true;
     }
-    header.size(n) = std::max (header.size(n), entry.image->size(n));
+    header.size(n) = std::max (header.size(n), image.size(n));
     if (!std::isfinite (header.spacing(n)))
-      header.spacing(n) = entry.image->spacing(n);
+      header.spacing(n) = image.spacing(n);
   }
 
-  header.merge_keyval (entry.image->keyval());
+  header.merge_keyval (image.keyval());
 }
 
 
@@ -763,7 +868,7 @@ class ThreadFunctor { NOMEMALIGN
 
       storage.push_back (ThreadLocalStorageItem());
       if (entry.image) {
-        storage.back().image.reset (new Image<complex_type> (*entry.image));
+        storage.back().image.reset (new Image<complex_type> (entry.image->get_image<complex_type>()));
         storage.back().chunk.resize (chunk_size);
         return;
       }
@@ -798,6 +903,197 @@ class ThreadFunctor { NOMEMALIGN
 
 
 
+/**********************************************************************
+   REAL-VALUED EVALUATION:
+ **********************************************************************/
+
+// When the calculation is real-valued throughout, it is evaluated in blocks
+// of voxels along the innermost axis: each block is loaded from the inputs,
+// and passed through the whole operator tree (overwriting its operands in
+// place) while it remains in cache, before being written to the output.
+
+constexpr size_t real_block_size = 256;
+
+
+template <typename ValueType>
+class RealStorageItem { NOMEMALIGN
+  public:
+    RealStorageItem () : block (real_block_size), value (0.0), rng_gaussian (false) { }
+    vector<ValueType> block;
+    Image<ValueType> image;
+    copy_ptr<Math::RNG> rng;
+    ValueType value;
+    bool rng_gaussian;
+};
+
+
+template <typename ValueType>
+class RealStorage : public vector<RealStorageItem<ValueType>> { NOMEMALIGN
+  public:
+
+    // set the position of all input images to the start of the current
+    // slice, along all axes other than the inner axes:
+    void set_position (const Iterator& iter) {
+      for (auto& item : *this) {
+        if (item.image.valid()) {
+          for (size_t n = 0; n < item.image.ndim(); ++n)
+            if (item.image.size(n) > 1)
+              item.image.index(n) = iter.index(n);
+        }
+      }
+    }
+
+    void reset (size_t x, size_t y, size_t num) {
+      current = 0;
+      pos[0] = x;
+      pos[1] = y;
+      size = num;
+    }
+
+    ValueType* next () {
+      RealStorageItem<ValueType>& item ((*this)[current++]);
+      ValueType* block (item.block.data());
+      if (item.image.valid())
+        load (block, item.image);
+      else if (item.rng) {
+        if (item.rng_gaussian) {
+          std::normal_distribution<ValueType> dis (0.0, 1.0);
+          for (size_t n = 0; n < size; ++n)
+            block[n] = dis (*item.rng);
+        }
+        else {
+          std::uniform_real_distribution<ValueType> dis (0.0, 1.0);
+          for (size_t n = 0; n < size; ++n)
+            block[n] = dis (*item.rng);
+        }
+      }
+      else
+        std::fill (block, block + size, item.value);
+      return block;
+    }
+
+    size_t block_size () const { return size; }
+
+    vector<size_t> axes;
+
+  private:
+    size_t current, pos[2], size;
+
+    bool varies_along (const Image<ValueType>& image, size_t axis) const {
+      return axis < image.ndim() && image.size (axis) > 1;
+    }
+
+    void load (ValueType* block, Image<ValueType>& image) {
+      if (varies_along (image, axes[1]))
+        image.index (axes[1]) = pos[1];
+      if (!varies_along (image, axes[0])) {
+        std::fill (block, block + size, ValueType (image.value()));
+        return;
+      }
+      image.index (axes[0]) = pos[0];
+      if (image.is_direct_io()) {
+        const ValueType* data (image.address());
+        const ssize_t stride (image.stride (axes[0]));
+        for (size_t n = 0; n < size; ++n)
+          block[n] = data[ssize_t(n)*stride];
+      }
+      else {
+        for (size_t n = 0; n < size; ++n) {
+          image.index (axes[0]) = pos[0] + n;
+          block[n] = image.value();
+        }
+      }
+    }
+};
+
+
+
+
+template <typename ValueType>
+class RealThreadFunctor { NOMEMALIGN
+  public:
+    RealThreadFunctor (
+        const vector<size_t>& inner_axes,
+        const StackEntry& top_of_stack,
+        Image<ValueType>& output_image) :
+      top_entry (top_of_stack),
+      image (output_image),
+      axes (inner_axes) {
+        storage.axes = axes;
+        allocate_storage (top_entry);
+      }
+
+    void allocate_storage (const StackEntry& entry) {
+      if (entry.evaluator) {
+        for (size_t n = 0; n < entry.evaluator->operands.size(); ++n)
+          allocate_storage (entry.evaluator->operands[n]);
+        return;
+      }
+
+      storage.push_back (RealStorageItem<ValueType>());
+      if (entry.image)
+        storage.back().image = entry.image->get_image<ValueType>();
+      else if (entry.rng) {
+        storage.back().rng = entry.rng;
+        storage.back().rng_gaussian = entry.rng_gaussian;
+      }
+      else storage.back().value = entry.value.real();
+    }
+
+
+    void operator() (const Iterator& iter) {
+      assign_pos_of (iter).to (image);
+      storage.set_position (iter);
+
+      const size_t size0 = image.size (axes[0]);
+      const size_t size1 = image.size (axes[1]);
+      for (size_t y = 0; y < size1; ++y) {
+        image.index (axes[1]) = y;
+        for (size_t x = 0; x < size0; x += real_block_size) {
+          const size_t num = std::min (real_block_size, size0 - x);
+          storage.reset (x, y, num);
+          const ValueType* block (top_entry.evaluate (storage));
+
+          image.index (axes[0]) = x;
+          if (image.is_direct_io()) {
+            ValueType* data (image.address());
+            const ssize_t stride (image.stride (axes[0]));
+            for (size_t n = 0; n < num; ++n)
+              data[ssize_t(n)*stride] = block[n];
+          }
+          else {
+            for (size_t n = 0; n < num; ++n) {
+              image.index (axes[0]) = x + n;
+              image.value() = block[n];
+            }
+          }
+        }
+      }
+    }
+
+
+    const StackEntry& top_entry;
+    Image<ValueType> image;
+    const vector<size_t> axes;
+    RealStorage<ValueType> storage;
+};
+
+
+
+
+template <typename ValueType>
+void run_real_operations (const StackEntry& top_of_stack, const Header& header, const std::string& output_path)
+{
+  auto output = Header::create (output_path, header).get_image<ValueType>();
+  auto loop = ThreadedLoop ("computing: " + operation_string (top_of_stack), output, 0, output.ndim(), 2);
+  RealThreadFunctor<ValueType> functor (loop.inner_axes, top_of_stack, output);
+  loop.run_outer (functor);
+}
+
+
+
+
+
 void run_operations (const vector<StackEntry>& stack)
 {
   Header header;
@@ -831,6 +1127,19 @@ void run_operations (const vector<StackEntry>& stack)
   }
   else header.datatype() = DataType::from_command_line (DataType::Float32);
 
+  if (stack[0].is_real_valued()) {
+    const DataType datatype (header.datatype());
+    if (datatype.bytes() > 4 || (datatype.is_integer() && datatype.bytes() == 4)) {
+      DEBUG ("evaluating real-valued operations in double precision");
+      run_real_operations<double> (stack[0], header, stack[1].arg);
+    }
+    else {
+      DEBUG ("evaluating real-valued operations in single precision");
+      run_real_operations<float> (stack[0], header, stack[1].arg);
+    }
+    return;
+  }
+
   auto output = Header::create (stack[1].arg, header).get_image<complex_type>();
 
   auto loop = ThreadedLoop ("computing: " + operation_string(stack[0]), output, 0, output.ndim(), 2);
@@ -376,6 +376,8 @@ void copy_permute (const InputType& in, Header& header_out, const std::string& o
 template <typename T>
 void extract (Header& header_in, Header& header_out, const vector<vector<uint32_t>>& pos, const std::string& output_filename)
 {
+  for (size_t axis = 0; axis < pos.size(); ++axis)
+    header_in.restrict_access (axis, pos[axis]);
   auto in = header_in.get_image<T>();
   if (pos.empty()) {
     copy_permute<T, decltype(in)> (in, header_out, output_filename);
@@ -23,6 +23,7 @@
 
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/range.h"
 #include "dwi/tractography/weights.h"
 #include "dwi/tractography/mapping/loader.h"
 #include "dwi/tractography/connectome/connectome.h"
@@ -100,6 +101,7 @@ void usage ()
   + MR::DWI::Tractography::Connectome::EdgeStatisticOption
 
   + Tractography::TrackWeightsInOption
+  + Tractography::TrackRangeOption
 
   + Option ("keep_unassigned", "By default, the program discards the information regarding those streamlines that are not successfully assigned to a node pair. "
                                "Set this option to keep these values (will be the first row/column in the output matrix)")
@@ -146,6 +148,7 @@ void execute (Image<node_t>& node_image, const node_t max_node_index, const std:
   // Prepare for reading the track data
   Tractography::Properties properties;
   Tractography::Reader<float> reader (argument[0], properties);
+  Tractography::set_range_from_option (reader, properties);
 
   // Initialise classes in preparation for multi-threading
   Mapping::TrackLoader loader (reader, properties["count"].empty() ? 0 : to<size_t>(properties["count"]), "Constructing connectome");
@@ -40,6 +40,7 @@ void usage ()
 
   DESCRIPTION
     + "The program currently supports MRtrix .tck files (input/output), "
+    "compressed MRtrix .tckz files (input/output), "
     "ascii text files (input/output), VTK polydata files (input/output), "
     "and RenderMan RIB (export only)."
 
@@ -732,7 +733,7 @@ void run ()
   // Reader
   Properties properties;
   std::unique_ptr<ReaderInterface<float> > reader;
-  if (Path::has_suffix(argument[0], ".tck")) {
+  if (Path::has_suffix(argument[0], {".tck", ".tckz"})) {
     reader.reset (new Reader<float>(argument[0], properties));
   }
   else if (Path::has_suffix(argument[0], ".txt")) {
@@ -748,7 +749,7 @@ void run ()
 
   // Writer
   std::unique_ptr<WriterInterface<float> > writer;
-  if (Path::has_suffix(argument[1], ".tck")) {
+  if (Path::has_suffix(argument[1], {".tck", ".tckz"})) {
     writer.reset (new Writer<float>(argument[1], properties));
   }
   else if (Path::has_suffix(argument[1], ".vtk")) {
@@ -254,17 +254,40 @@ void run ()
   Tracking::load_streamline_properties_and_rois (properties);
   properties.compare_stepsize_rois();
 
+  const bool reproducible = properties.find ("reproducible") != properties.end();
+  if (reproducible && properties.find ("seed_dynamic") != properties.end())
+    throw Exception ("Reproducible tracking (-reproducible option) is not compatible with dynamic seeding");
+  size_t seed_start = 0;
+  if (properties.find ("seed_start") != properties.end()) {
+    if (!reproducible)
+      throw Exception ("The -seed_start option can only be used for reproducible tracking (-reproducible option)");
+    seed_start = to<size_t> (properties["seed_start"]);
+  }
+
   // Check validity of options -select and -seeds; these are meaningless if seeds are number-limited
   // By over-riding the values in properties, the progress bar should still be valid
   if (properties.seeds.is_finite()) {
 
+    size_t num_seeds = properties.seeds.get_total_count();
+    if (seed_start >= num_seeds)
+      throw Exception ("Seed index provided by -seed_start option exceeds the number of seeds available (" + str(num_seeds) + ")");
+    num_seeds -= seed_start;
+
     if (properties["max_num_tracks"].size())
       WARN ("Overriding -select option (desired number of successful streamline selections), as seeds can only provide a finite number");
-    properties["max_num_tracks"] = str (properties.seeds.get_total_count());
 
-    if (properties["max_num_seeds"].size())
-      WARN ("Overriding -seeds option (maximum number of seeds that will be attempted to track from), as seeds can only provide a finite number");
-    properties["max_num_seeds"] = str (properties.seeds.get_total_count());
+    // When splitting a reproducible run into ranges of seeds, -seeds sets the size of the range
+    if (properties["max_num_seeds"].size()) {
+      if (reproducible) {
+        if (to<size_t> (properties["max_num_seeds"]))
+          num_seeds = std::min (num_seeds, to<size_t> (properties["max_num_seeds"]));
+      } else {
+        WARN ("Overriding -seeds option (maximum number of seeds that will be attempted to track from), as seeds can only provide a finite number");
+      }
+    }
+
+    properties["max_num_tracks"] = str (num_seeds);
+    properties["max_num_seeds"] = str (num_seeds);
 
   }
 
@@ -26,6 +26,7 @@
 #include "dwi/gradient.h"
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/range.h"
 #include "dwi/tractography/weights.h"
 
 #include "dwi/tractography/mapping/loader.h"
@@ -148,7 +149,13 @@ const OptionGroup MappingOption = OptionGroup ("Options for the streamline-to-vo
       "(these lengths are then taken into account during TWI calculation)")
 
   + Option ("ends_only",
-      "only map the streamline endpoints to the image");
+      "only map the streamline endpoints to the image")
+
+  + Option ("sharded",
+      "accumulate the output image separately within each thread, and combine the results once all "
+      "streamlines have been mapped, rather than passing all mapped voxels to a single writer thread. "
+      "This allows generation of images from very large tractograms to scale with the number of threads, "
+      "at the expense of one additional copy of the output image buffer in memory per thread.");
 
 
 
@@ -213,7 +220,8 @@ OPTIONS
   + OutputDimOption
   + TWIOption
   + MappingOption
-  + Tractography::TrackWeightsInOption;
+  + Tractography::TrackWeightsInOption
+  + Tractography::TrackRangeOption;
 
 }
 
@@ -222,6 +230,16 @@ OPTIONS
 
 
 
+template <class MapperType, class SetType>
+void run_sharded (TrackLoader& loader, const MapperType& mapper, MapWriterBase& writer)
+{
+  ShardedMapWriter<MapperType, SetType> sink (mapper, writer);
+  Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (sink));
+  sink.merge();
+}
+
+
+
 MapWriterBase* make_writer (Header& H, const std::string& name, const vox_stat_t stat_vox, const writer_dim dim)
 {
   MapWriterBase* writer = nullptr;
@@ -266,6 +284,7 @@ void run () {
 
   Tractography::Properties properties;
   Tractography::Reader<float> file (argument[0], properties);
+  Tractography::set_range_from_option (file, properties);
 
   const size_t num_tracks = properties["count"].empty() ? 0 : to<size_t> (properties["count"]);
 
@@ -606,15 +625,34 @@ void run () {
   // Finally get to do some number crunching!
   // Complete branch here for Gaussian track-wise statistic; it's a nightmare to manage, so am
   //   keeping the code as separate as possible
+  const bool sharded = get_options ("sharded").size();
   if (stat_tck == GAUSSIAN) {
     Gaussian::TrackMapper* const mapper_ptr = dynamic_cast<Gaussian::TrackMapper*>(mapper.get());
     mapper_ptr->set_gaussian_FWHM (gaussian_fwhm_tck);
+    if (sharded) {
+      switch (writer_type) {
+        case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
+        case GREYSCALE: run_sharded<Gaussian::TrackMapper, Gaussian::SetVoxel>    (loader, *mapper_ptr, *writer); break;
+        case DEC:       run_sharded<Gaussian::TrackMapper, Gaussian::SetVoxelDEC> (loader, *mapper_ptr, *writer); break;
+        case DIXEL:     run_sharded<Gaussian::TrackMapper, Gaussian::SetDixel>    (loader, *mapper_ptr, *writer); break;
+        case TOD:       run_sharded<Gaussian::TrackMapper, Gaussian::SetVoxelTOD> (loader, *mapper_ptr, *writer); break;
+      }
+    } else {
+      switch (writer_type) {
+        case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
+        case GREYSCALE: Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxel()),    *writer); break;
+        case DEC:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelDEC()), *writer); break;
+        case DIXEL:     Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetDixel()),    *writer); break;
+        case TOD:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelTOD()), *writer); break;
+      }
+    }
+  } else if (sharded) {
     switch (writer_type) {
       case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
-      case GREYSCALE: Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxel()),    *writer); break;
-      case DEC:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelDEC()), *writer); break;
-      case DIXEL:     Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetDixel()),    *writer); break;
-      case TOD:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelTOD()), *writer); break;
+      case GREYSCALE: run_sharded<TrackMapperTWI, SetVoxel>    (loader, *mapper, *writer); break;
+      case DEC:       run_sharded<TrackMapperTWI, SetVoxelDEC> (loader, *mapper, *writer); break;
+      case DIXEL:     run_sharded<TrackMapperTWI, SetDixel>    (loader, *mapper, *writer); break;
+      case TOD:       run_sharded<TrackMapperTWI, SetVoxelTOD> (loader, *mapper, *writer); break;
     }
   } else {
     switch (writer_type) {
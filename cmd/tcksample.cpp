@@ -22,6 +22,7 @@
 #include "ordered_thread_queue.h"
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/range.h"
 #include "dwi/tractography/scalar_file.h"
 #include "dwi/tractography/mapping/mapper.h"
 #include "file/ofstream.h"
@@ -77,7 +78,9 @@ void usage ()
             "in each voxel based on the fraction of the track density "
             "contributed by that streamline (this is only appropriate for "
             "processing a whole-brain tractogram, and images for which the "
-            "quantiative parameter is additive)");
+            "quantiative parameter is additive)")
+
+  + DWI::Tractography::TrackRangeOption;
 
 
   // TODO add support for SH amplitude along tangent
@@ -458,6 +461,7 @@ void run ()
 {
   DWI::Tractography::Properties properties;
   DWI::Tractography::Reader<value_type> reader (argument[0], properties);
+  DWI::Tractography::set_range_from_option (reader, properties);
   auto H = Header::open (argument[1]);
   auto image = H.get_image<value_type>();
 
@@ -479,11 +483,13 @@ void run ()
   if (get_options ("use_tdi_fraction").size()) {
     if (statistic == stat_tck::NONE)
       throw Exception ("Cannot use -use_tdi_fraction option unless a per-streamline statistic is used");
-    DWI::Tractography::Reader<value_type> tdi_reader (argument[0], properties);
+    // track density is computed from all streamlines, even if only a range is to be sampled:
+    DWI::Tractography::Properties tdi_properties;
+    DWI::Tractography::Reader<value_type> tdi_reader (argument[0], tdi_properties);
     DWI::Tractography::Mapping::TrackMapperBase mapper (H);
     mapper.set_use_precise_mapping (interp == interp_type::PRECISE);
     tdi = Image<value_type>::scratch (H, "TDI scratch image");
-    TDI tdi_fill (tdi, num_tracks);
+    TDI tdi_fill (tdi, tdi_properties.find("count") == tdi_properties.end() ? 0 : to<size_t>(tdi_properties["count"]));
     Thread::run_queue (tdi_reader,
                        Thread::batch (DWI::Tractography::Streamline<value_type>()),
                        Thread::multi (mapper),
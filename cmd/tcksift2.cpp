@@ -155,7 +155,7 @@ void run ()
   if (get_options("max_factor").size() && get_options("max_coeff").size())
     throw Exception ("Options -max_factor and -max_coeff are mutually exclusive");
 
-  if (Path::has_suffix (argument[2], ".tck"))
+  if (Path::has_suffix (argument[2], { ".tck", ".tckz" }))
     throw Exception ("Output of tcksift2 command should be a text file, not a tracks file");
 
   auto in_dwi = Image<float>::open (argument[1]);
@@ -172,6 +172,7 @@ void run ()
   tckfactor.perform_FOD_segmentation (in_dwi);
   tckfactor.scale_FDs_by_GM();
 
+  tckfactor.set_out_of_core (get_options ("out_of_core").size());
   tckfactor.map_streamlines (argument[0]);
 
   tckfactor.store_orig_TDs();
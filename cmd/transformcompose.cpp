@@ -27,22 +27,27 @@ class TransformBase { MEMALIGN(TransformBase)
   public:
     virtual ~TransformBase(){}
     virtual Eigen::Vector3d transform_point (const Eigen::Vector3d& input) = 0;
+    virtual std::unique_ptr<TransformBase> clone () const = 0;
 };
 
 
 class Warp : public TransformBase { MEMALIGN(Warp)
   public:
-    Warp (Image<default_type>& in) : interp (in) {}
+    Warp (const Image<default_type>& in) : interp (in) {}
 
     Eigen::Vector3d transform_point (const Eigen::Vector3d &input) {
       Eigen::Vector3d output;
       if (interp.scanner (input))
-        output = interp.row(3);
+        interp.cached_row (output, 3);
       else
         output.fill (NaN);
       return output;
     }
 
+    std::unique_ptr<TransformBase> clone () const {
+      return std::unique_ptr<TransformBase> (new Warp (*this));
+    }
+
   protected:
     Interp::Linear<Image<default_type> > interp;
 };
@@ -57,6 +62,10 @@ class Linear : public TransformBase { MEMALIGN(Linear)
        return output;
     }
 
+    std::unique_ptr<TransformBase> clone () const {
+      return std::unique_ptr<TransformBase> (new Linear (*this));
+    }
+
     const transform_type transform;
 };
 
@@ -94,6 +103,41 @@ void usage ()
 using value_type = float;
 
 
+// each thread holds its own copy of the transforms, since warp interpolators are stateful:
+class ComposeKernel { MEMALIGN(ComposeKernel)
+  public:
+    ComposeKernel (const vector<std::unique_ptr<TransformBase>>& transforms, const Image<value_type>& output) :
+      template_transform (output) {
+        for (const auto& t : transforms)
+          transform_list.push_back (t->clone());
+      }
+
+    ComposeKernel (const ComposeKernel& that) :
+      template_transform (that.template_transform) {
+        for (const auto& t : that.transform_list)
+          transform_list.push_back (t->clone());
+      }
+
+    void operator() (Image<value_type>& output) {
+      Eigen::Vector3d voxel ((default_type) output.index(0),
+                             (default_type) output.index(1),
+                             (default_type) output.index(2));
+
+      Eigen::Vector3d position = template_transform.voxel2scanner * voxel;
+      ssize_t index = transform_list.size() - 1;
+      while (index >= 0) {
+        position = transform_list[index]->transform_point (position);
+        index--;
+      }
+      output.row(3) = position;
+    }
+
+  protected:
+    vector<std::unique_ptr<TransformBase>> transform_list;
+    const Transform template_transform;
+};
+
+
 void run ()
 {
   vector<std::unique_ptr<TransformBase>> transform_list;
@@ -156,19 +200,6 @@ void run ()
 
     Image<float> output = Image<value_type>::create (argument [argument.size() - 1], output_header);
 
-    Transform template_transform (output);
-    for (auto i = Loop ("composing transformations", output, 0, 3) (output); i ; ++i) {
-      Eigen::Vector3d voxel ((default_type) output.index(0),
-                            (default_type) output.index(1),
-                            (default_type) output.index(2));
-
-      Eigen::Vector3d position = template_transform.voxel2scanner * voxel;
-      ssize_t index = transform_list.size() - 1;
-      while (index >= 0) {
-        position = transform_list[index]->transform_point (position);
-        index--;
-      }
-      output.row(3) = position;
-    }
+    ThreadedLoop ("composing transformations", output, 0, 3).run (ComposeKernel (transform_list, output), output);
   }
 }
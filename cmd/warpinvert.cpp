@@ -74,7 +74,7 @@ void run ()
   Image<default_type> image_out (Image<default_type>::create (argument[1], header_out));
 
   if (displacement) {
-    Registration::Warp::invert_displacement (image_in, image_out);
+    Registration::Warp::invert_displacement (image_in, image_out, 50, 0.0001, false);
   } else {
     Registration::Warp::invert_deformation (image_in, image_out);
   }
@@ -0,0 +1,144 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "algo/threaded_loop.h"
+#include "file/config.h"
+
+namespace MR
+{
+  namespace Algo
+  {
+
+
+    bool threaded_loop_work_stealing ()
+    {
+      //CONF option: ThreadedLoopWorkStealing
+      //CONF default: 1 (true)
+      //CONF A boolean value to indicate whether multi-threaded image loops
+      //CONF should distribute work across threads using a work-stealing
+      //CONF scheduler with adaptive chunk sizes. If false, each thread
+      //CONF instead obtains one position at a time from a single shared
+      //CONF iterator, which may incur more contention between threads.
+      static const bool value = File::Config::get_bool ("ThreadedLoopWorkStealing", true);
+      return value;
+    }
+
+
+
+
+    ThreadedLoopScheduler::ThreadedLoopScheduler (size_t num_items, size_t num_threads) :
+        num_threads (std::max (num_threads, size_t(1))),
+        ranges (new Range [this->num_threads]),
+        num_registered (0)
+    {
+      for (size_t t = 0; t < this->num_threads; ++t) {
+        Range& r (ranges[t]);
+        r.begin = (num_items * t) / this->num_threads;
+        r.end = (num_items * (t+1)) / this->num_threads;
+        r.items = r.chunks = r.steals = 0;
+        r.busy = 0.0;
+      }
+    }
+
+
+
+    size_t ThreadedLoopScheduler::register_thread ()
+    {
+      const size_t id = num_registered++;
+      assert (id < num_threads);
+      return id;
+    }
+
+
+
+    bool ThreadedLoopScheduler::next (size_t id, size_t& begin, size_t& end)
+    {
+      Range& r (ranges[id]);
+      do {
+        std::lock_guard<std::mutex> lock (r.mutex);
+        const size_t b = r.begin, e = r.end;
+        if (b < e) {
+          // claim a chunk proportional to the work remaining in this range,
+          // leaving the remainder available to other threads to steal:
+          const size_t chunk = std::max ((e - b) / 4, size_t(1));
+          begin = b;
+          end = b + chunk;
+          r.begin = end;
+          r.items += chunk;
+          ++r.chunks;
+          return true;
+        }
+      } while (steal (id));
+
+      return false;
+    }
+
+
+
+    bool ThreadedLoopScheduler::steal (size_t id)
+    {
+      while (true) {
+        size_t victim = num_threads, largest = 0;
+        for (size_t t = 0; t < num_threads; ++t) {
+          if (t == id)
+            continue;
+          const size_t b = ranges[t].begin, e = ranges[t].end;
+          if (e > b && e - b > largest) {
+            largest = e - b;
+            victim = t;
+          }
+        }
+        if (victim == num_threads)
+          return false;
+
+        size_t b, e;
+        {
+          Range& v (ranges[victim]);
+          std::lock_guard<std::mutex> lock (v.mutex);
+          b = v.begin;
+          e = v.end;
+          if (b >= e)
+            continue;
+          b += (e - b) / 2;
+          v.end = b;
+        }
+
+        Range& r (ranges[id]);
+        std::lock_guard<std::mutex> lock (r.mutex);
+        r.begin = b;
+        r.end = e;
+        ++r.steals;
+        return true;
+      }
+    }
+
+
+
+    void ThreadedLoopScheduler::report () const
+    {
+      const double wall = timer.elapsed();
+      for (size_t t = 0; t < num_registered; ++t) {
+        const Range& r (ranges[t]);
+        DEBUG ("loop thread " + str(t) + ": " + str(r.items) + " positions in "
+            + str(r.chunks) + " chunks (" + str(r.steals) + " steals); busy "
+            + str(r.busy, 3) + " s, idle " + str(std::max (wall - r.busy, 0.0), 3) + " s");
+      }
+    }
+
+
+  }
+}
+
@@ -17,7 +17,10 @@
 #ifndef __algo_threaded_loop_h__
 #define __algo_threaded_loop_h__
 
+#include <atomic>
+
 #include "debug.h"
+#include "timer.h"
 #include "algo/loop.h"
 #include "algo/iterator.h"
 #include "thread.h"
@@ -218,6 +221,21 @@ namespace MR
    * double rms = std::sqrt (SoS / voxel_count (vox));
    * \endcode
    *
+   * \section threaded_loop_scheduling Scheduling of the outer loop
+   *
+   * By default, the positions in the outer loop are distributed across
+   * threads using a work-stealing scheduler: each thread initially owns a
+   * contiguous range of outer positions, from which it claims chunks of
+   * decreasing size; once its own range is exhausted, it steals half of the
+   * largest remaining range of any other thread. This provides good load
+   * balancing for highly non-uniform workloads (e.g. masked operations, where
+   * most positions return immediately), without contention on a single
+   * shared iterator. Per-thread statistics (positions processed, number of
+   * chunks & steals, busy & idle time) are reported when running with the
+   * -debug option. The previous scheme, whereby threads obtain one outer
+   * position at a time from a shared iterator, can be selected by setting
+   * the ThreadedLoopWorkStealing configuration file option to false.
+   *
    * \section threaded_loop_run_outer The run_outer() method
    *
    * The run_outer() method can be used if needed to loop over the indices in
@@ -240,6 +258,58 @@ namespace MR
 
 
 
+  namespace Algo
+  {
+
+    //! whether ThreadedLoop should use the work-stealing scheduler
+    bool threaded_loop_work_stealing ();
+
+
+    //! work-stealing scheduler for the outer positions of a ThreadedLoop
+    /*! The \a num_items positions to be processed are initially split into
+     * one contiguous range per thread. Each thread claims chunks from the
+     * front of its own range, with the chunk size adapted to the amount of
+     * work remaining in that range. When its range is exhausted, the thread
+     * steals the back half of the largest range remaining across all other
+     * threads, and proceeds to process that range in the same way. */
+    class ThreadedLoopScheduler { NOMEMALIGN
+      public:
+        ThreadedLoopScheduler (size_t num_items, size_t num_threads);
+
+        //! to be called once by each thread on startup; returns its ID
+        size_t register_thread ();
+
+        //! obtain the next chunk [\a begin, \a end) of items to process for thread \a id
+        /*! \returns false once no work remains */
+        bool next (size_t id, size_t& begin, size_t& end);
+
+        //! record time spent processing items by thread \a id
+        void add_busy_time (size_t id, double seconds) { ranges[id].busy += seconds; }
+
+        //! report per-thread load balancing statistics at the DEBUG level
+        void report () const;
+
+      protected:
+        class Range { NOMEMALIGN
+          public:
+            std::mutex mutex;
+            std::atomic<size_t> begin, end;
+            size_t items, chunks, steals;
+            double busy;
+        };
+
+        const size_t num_threads;
+        std::unique_ptr<Range[]> ranges;
+        std::atomic<size_t> num_registered;
+        mutable Timer timer;
+
+        bool steal (size_t id);
+    };
+
+  }
+
+
+
   namespace {
 
     inline vector<size_t> get_inner_axes (const vector<size_t>& axes, size_t num_inner_axes) {
@@ -312,6 +382,16 @@ namespace MR
         loop->progress.run_update_thread (*threads);
       }
 
+      inline void __increment_progress (const void*, size_t, std::mutex&) { }
+      template <class LoopType>
+        inline auto __increment_progress (LoopType* loop, size_t count, std::mutex& mutex)
+        -> decltype((void) (&loop->progress), void())
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        for (size_t n = 0; n < count; ++n)
+          ++loop->progress;
+      }
+
 
     template <class OuterLoopType>
       struct ThreadedLoopRunOuter { MEMALIGN(ThreadedLoopRunOuter<OuterLoopType>)
@@ -329,6 +409,11 @@ namespace MR
               return;
             }
 
+            if (Algo::threaded_loop_work_stealing()) {
+              run_outer_work_stealing (functor);
+              return;
+            }
+
             std::mutex mutex;
             ProgressBar::SwitchToMultiThreaded progress_functions;
 
@@ -365,6 +450,65 @@ namespace MR
 
 
 
+        //! invoke \a functor (const Iterator& pos) per voxel <em> in the outer axes only</em>, using work-stealing
+        template <class Functor>
+          void run_outer_work_stealing (Functor&& functor)
+          {
+            std::mutex mutex;
+            ProgressBar::SwitchToMultiThreaded progress_functions;
+
+            struct Shared { MEMALIGN(Shared)
+              Iterator& iterator;
+              decltype (outer_loop (iterator)) loop;
+              std::mutex& mutex;
+              Algo::ThreadedLoopScheduler scheduler;
+
+              // set position in outer axes from index in outer loop:
+              FORCE_INLINE void set (Iterator& pos, size_t index) const {
+                for (auto axis : loop.axes) {
+                  pos.index (axis) = index % pos.size (axis);
+                  index /= pos.size (axis);
+                }
+              }
+              FORCE_INLINE void increment (Iterator& pos) const {
+                for (auto axis : loop.axes) {
+                  if (++pos.index (axis) < pos.size (axis))
+                    return;
+                  pos.index (axis) = 0;
+                }
+              }
+            } shared = { iterator, outer_loop (iterator), mutex,
+              { size_t (voxel_count (iterator, outer_loop.axes)), Thread::threads_to_execute() } };
+
+            struct PerThread { MEMALIGN(PerThread)
+              Shared& shared;
+              typename std::remove_reference<Functor>::type func;
+              void execute () {
+                Iterator pos = shared.iterator;
+                const size_t id = shared.scheduler.register_thread();
+                size_t begin, end;
+                while (shared.scheduler.next (id, begin, end)) {
+                  Timer timer;
+                  shared.set (pos, begin);
+                  for (size_t n = begin; n < end; ++n) {
+                    func (pos);
+                    shared.increment (pos);
+                  }
+                  shared.scheduler.add_busy_time (id, timer.elapsed());
+                  __increment_progress (&shared.loop, end - begin, shared.mutex);
+                }
+              }
+            } loop_thread = { shared, functor };
+
+            auto threads = Thread::run (Thread::multi (loop_thread), "loop threads");
+
+            __manage_progress (&shared.loop, &threads);
+            threads.wait();
+            shared.scheduler.report();
+          }
+
+
+
         //! invoke \a functor (const Iterator& pos) per voxel <em> in the outer axes only</em>
         template <class Functor, class... ImageType>
           void run (Functor&& functor, ImageType&&... vox)
@@ -21,6 +21,7 @@ namespace MR {
     namespace Dicom {
 
       std::unordered_map<uint32_t, const char*> Element::dict;
+      std::once_flag Element::dict_initialised;
 
 
       // Note this implementation does not account for multiplicity
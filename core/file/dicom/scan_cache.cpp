@@ -0,0 +1,304 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sys/stat.h>
+
+#include "raw.h"
+#include "file/config.h"
+#include "file/path.h"
+#include "file/dicom/scan_cache.h"
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      namespace
+      {
+
+        const char cache_magic[] = "mrtrix DICOM scan cache 2\n";
+
+        // the QuickScan fields stored in the cache, other than the image
+        // types, the image dimensions & the transfer syntax flag:
+        std::string QuickScan::* const string_fields[] = {
+          &QuickScan::modality,
+          &QuickScan::patient, &QuickScan::patient_ID, &QuickScan::patient_DOB,
+          &QuickScan::study, &QuickScan::study_ID, &QuickScan::study_UID, &QuickScan::study_date, &QuickScan::study_time,
+          &QuickScan::series, &QuickScan::series_ref_UID, &QuickScan::series_date, &QuickScan::series_time, &QuickScan::sequence
+        };
+        size_t QuickScan::* const size_fields[] = {
+          &QuickScan::series_number, &QuickScan::bits_alloc, &QuickScan::data
+        };
+
+
+        void put (std::ostream& out, uint64_t value)
+        {
+          uint8_t buffer[sizeof (uint64_t)];
+          Raw::store_LE (value, buffer);
+          out.write (reinterpret_cast<const char*> (buffer), sizeof (buffer));
+        }
+
+        void put (std::ostream& out, const std::string& value)
+        {
+          put (out, uint64_t (value.size()));
+          out.write (value.data(), value.size());
+        }
+
+        uint64_t get_uint (std::istream& in)
+        {
+          uint8_t buffer[sizeof (uint64_t)];
+          in.read (reinterpret_cast<char*> (buffer), sizeof (buffer));
+          if (!in)
+            throw 1;
+          return Raw::fetch_LE<uint64_t> (buffer);
+        }
+
+        std::string get_string (std::istream& in)
+        {
+          const uint64_t size = get_uint (in);
+          if (size > (1U<<24))
+            throw 1;
+          std::string value (size, '\0');
+          in.read (&value[0], size);
+          if (!in)
+            throw 1;
+          return value;
+        }
+
+
+
+        std::string absolute_path (const std::string& path)
+        {
+#ifdef MRTRIX_WINDOWS
+          char buffer[_MAX_PATH];
+          if (_fullpath (buffer, path.c_str(), _MAX_PATH))
+            return buffer;
+#else
+          char* resolved = realpath (path.c_str(), nullptr);
+          if (resolved) {
+            const std::string value (resolved);
+            free (resolved);
+            return value;
+          }
+#endif
+          return path;
+        }
+
+      }
+
+
+
+
+
+      ScanCache::ScanCache (const std::string& folder) :
+        folder (folder)
+      {
+        //CONF option: DicomScanCache
+        //CONF default: (none)
+        //CONF The path of a file in which to cache the results of scanning
+        //CONF DICOM folders. Files whose size and modification time are
+        //CONF unchanged since they were last scanned are not parsed again,
+        //CONF which speeds up repeated access to the same (large) folders.
+        //CONF If not set, no cache is used.
+        cache_file = File::Config::get ("DicomScanCache");
+        if (!enabled())
+          return;
+        absolute_folder = absolute_path (folder);
+        if (!load())
+          entries.clear();
+      }
+
+
+
+
+      bool ScanCache::stat (const std::string& filename, uint64_t& size, uint64_t& mtime)
+      {
+        struct stat sbuf;
+        if (::stat (filename.c_str(), &sbuf))
+          return false;
+        size = sbuf.st_size;
+        // use the full timestamp resolution, in nanoseconds, where available:
+#if defined(MRTRIX_WINDOWS)
+        mtime = uint64_t (sbuf.st_mtime) * 1000000000;
+#elif defined(MRTRIX_MACOSX)
+        mtime = uint64_t (sbuf.st_mtimespec.tv_sec) * 1000000000 + sbuf.st_mtimespec.tv_nsec;
+#else
+        mtime = uint64_t (sbuf.st_mtim.tv_sec) * 1000000000 + sbuf.st_mtim.tv_nsec;
+#endif
+        return true;
+      }
+
+
+
+
+      const ScanCache::Entry* ScanCache::find (const std::string& filename, uint64_t size, uint64_t mtime) const
+      {
+        const auto entry = entries.find (key (filename));
+        if (entry == entries.end() || entry->second.size != size || entry->second.mtime != mtime)
+          return nullptr;
+        return &entry->second;
+      }
+
+
+
+
+      void ScanCache::update (const std::string& filename, const Entry& entry)
+      {
+        updated[key (filename)] = entry;
+      }
+
+
+
+
+      std::string ScanCache::key (const std::string& filename) const
+      {
+        assert (filename.compare (0, folder.size(), folder) == 0);
+        return Path::join (absolute_folder, strip (filename.substr (folder.size()), PATH_SEPARATORS, true, false));
+      }
+
+
+
+
+      bool ScanCache::load ()
+      {
+        std::ifstream in (cache_file, std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        try {
+          std::string magic (sizeof (cache_magic) - 1, '\0');
+          in.read (&magic[0], magic.size());
+          if (!in || magic != cache_magic)
+            throw 1;
+
+          const uint64_t num_entries = get_uint (in);
+          for (uint64_t n = 0; n != num_entries; ++n) {
+            const std::string filename = get_string (in);
+            Entry entry;
+            entry.size = get_uint (in);
+            entry.mtime = get_uint (in);
+            entry.valid = get_uint (in);
+            if (entry.valid) {
+              QuickScan& scan (entry.scan);
+              for (auto field : string_fields)
+                scan.*field = get_string (in);
+              const uint64_t num_types = get_uint (in);
+              for (uint64_t t = 0; t != num_types; ++t) {
+                const std::string type = get_string (in);
+                scan.image_type[type] = get_uint (in);
+              }
+              for (auto field : size_fields)
+                scan.*field = get_uint (in);
+              scan.dim[0] = get_uint (in);
+              scan.dim[1] = get_uint (in);
+              scan.transfer_syntax_supported = get_uint (in);
+            }
+            entries[filename] = std::move (entry);
+          }
+        }
+        catch (...) {
+          DEBUG ("ignoring invalid DICOM scan cache file \"" + cache_file + "\"");
+          return false;
+        }
+
+        DEBUG ("loaded " + str(entries.size()) + " entries from DICOM scan cache file \"" + cache_file + "\"");
+        return true;
+      }
+
+
+
+
+      void ScanCache::save () const
+      {
+        if (!enabled())
+          return;
+
+        // merge with the entries for files outside of this folder:
+        auto in_folder = [&] (const std::string& filename) {
+          return filename.compare (0, absolute_folder.size(), absolute_folder) == 0 &&
+            ( filename.size() == absolute_folder.size() ||
+              absolute_folder.find_last_of (PATH_SEPARATORS) == absolute_folder.size()-1 ||
+              std::string (PATH_SEPARATORS).find (filename[absolute_folder.size()]) != std::string::npos );
+        };
+        std::map<std::string, Entry> merged (updated);
+        bool modified = false;
+        for (const auto& entry : entries) {
+          if (!in_folder (entry.first))
+            merged.insert (entry);
+          else if (!updated.count (entry.first))
+            modified = true;
+        }
+        for (const auto& entry : updated) {
+          const auto previous = entries.find (entry.first);
+          if (previous == entries.end() || previous->second.size != entry.second.size || previous->second.mtime != entry.second.mtime)
+            modified = true;
+        }
+        if (!modified)
+          return;
+
+        std::random_device random_device;
+        const std::string temp_path (cache_file + "-" + str(random_device()));
+        {
+          std::ofstream out (temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+          if (out) {
+            out.write (cache_magic, sizeof (cache_magic) - 1);
+            put (out, uint64_t (merged.size()));
+            for (const auto& item : merged) {
+              const Entry& entry (item.second);
+              put (out, item.first);
+              put (out, entry.size);
+              put (out, entry.mtime);
+              put (out, uint64_t (entry.valid));
+              if (entry.valid) {
+                const QuickScan& scan (entry.scan);
+                for (auto field : string_fields)
+                  put (out, scan.*field);
+                put (out, uint64_t (scan.image_type.size()));
+                for (const auto& type : scan.image_type) {
+                  put (out, type.first);
+                  put (out, uint64_t (type.second));
+                }
+                for (auto field : size_fields)
+                  put (out, uint64_t (scan.*field));
+                put (out, uint64_t (scan.dim[0]));
+                put (out, uint64_t (scan.dim[1]));
+                put (out, uint64_t (scan.transfer_syntax_supported));
+              }
+            }
+          }
+          if (!out) {
+            WARN ("unable to write DICOM scan cache file \"" + cache_file + "\"; scan results will not be cached");
+            out.close();
+            std::remove (temp_path.c_str());
+            return;
+          }
+        }
+
+        // rename into place, so that concurrent processes never see a partial cache:
+        if (std::rename (temp_path.c_str(), cache_file.c_str())) {
+          WARN ("unable to save DICOM scan cache file \"" + cache_file + "\": " + strerror (errno));
+          std::remove (temp_path.c_str());
+        }
+        else
+          DEBUG ("saved " + str(merged.size()) + " entries to DICOM scan cache file \"" + cache_file + "\"");
+      }
+
+
+    }
+  }
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_dicom_scan_cache_h__
+#define __file_dicom_scan_cache_h__
+
+#include <map>
+
+#include "types.h"
+#include "file/dicom/quick_scan.h"
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      //! an on-disk cache of the results of scanning DICOM files
+      /*! Entries are keyed by the absolute path of each file, and are only
+       * used if the size and modification time of the file are unchanged,
+       * such that repeated scans of the same folder can skip files that
+       * have already been parsed. A single cache file (as specified by the
+       * DicomScanCache config file option) holds the entries for all
+       * folders scanned.
+       *
+       * Once loaded, the const methods are thread-safe. */
+      class ScanCache { NOMEMALIGN
+        public:
+          class Entry { NOMEMALIGN
+            public:
+              uint64_t size, mtime;
+              //! whether the file could be parsed as DICOM
+              bool valid;
+              QuickScan scan;
+          };
+
+          //! load the entries for files in \a folder, if caching is enabled
+          ScanCache (const std::string& folder);
+
+          bool enabled () const { return cache_file.size(); }
+
+          //! get the size & modification time (in nanoseconds) of \a filename
+          /*! returns false if these cannot be determined. */
+          static bool stat (const std::string& filename, uint64_t& size, uint64_t& mtime);
+
+          //! the cached entry for \a filename, if present and up to date
+          const Entry* find (const std::string& filename, uint64_t size, uint64_t mtime) const;
+
+          //! record the entry for \a filename, to be saved in the cache
+          void update (const std::string& filename, const Entry& entry);
+
+          //! write the cache to file
+          /*! entries for files in the folder that were not found in this
+           * scan are discarded; those for other folders are retained. */
+          void save () const;
+
+        protected:
+          std::string cache_file, folder, absolute_folder;
+          std::map<std::string, Entry> entries, updated;
+
+          std::string key (const std::string& filename) const;
+          bool load ();
+      };
+
+    }
+  }
+}
+
+#endif
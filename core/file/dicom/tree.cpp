@@ -14,9 +14,11 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include "thread_queue.h"
 #include "file/path.h"
 #include "file/dicom/element.h"
 #include "file/dicom/quick_scan.h"
+#include "file/dicom/scan_cache.h"
 #include "file/dicom/image.h"
 #include "file/dicom/series.h"
 #include "file/dicom/study.h"
@@ -54,29 +56,127 @@ namespace MR {
 
 
 
-      void Tree::read_dir (const std::string& filename, ProgressBar& progress)
+      namespace
       {
-        try {
-          Path::Dir folder (filename);
-          std::string entry;
-          while ((entry = folder.read_name()).size()) {
-            std::string name (Path::join (filename, entry));
-            if (Path::is_dir (name))
-              read_dir (name, progress);
-            else {
+
+        // the result of scanning an entry in a DICOM folder:
+        class Scanned { NOMEMALIGN
+          public:
+            std::string path;
+            bool is_dir, cacheable;
+            vector<std::string> contents;
+            ScanCache::Entry file;
+            Exception error;
+        };
+
+
+        class Scanner { NOMEMALIGN
+          public:
+            Scanner (const ScanCache& cache) : cache (cache) { }
+
+            bool operator() (const std::string& path, Scanned& item)
+            {
+              item.path = path;
+              item.is_dir = item.cacheable = false;
+              item.contents.clear();
+              item.error = Exception();
+
+              try {
+                if (Path::is_dir (path)) {
+                  item.is_dir = true;
+                  Path::Dir folder (path);
+                  std::string entry;
+                  while ((entry = folder.read_name()).size())
+                    item.contents.push_back (Path::join (path, entry));
+                  return true;
+                }
+              }
+              catch (Exception& E) {
+                item.error = Exception (E, "error opening DICOM folder \"" + (item.is_dir ? path : Path::dirname (path)) + "\": " + strerror (errno));
+                return true;
+              }
+
+              ScanCache::Entry& file (item.file);
               try {
-                read_file (name);
+                item.cacheable = cache.enabled() && ScanCache::stat (path, file.size, file.mtime);
+                const ScanCache::Entry* cached = item.cacheable ? cache.find (path, file.size, file.mtime) : nullptr;
+                if (cached) {
+                  file = *cached;
+                  file.scan.filename = path;
+                }
+                else
+                  file.valid = !file.scan.read (path);
               }
               catch (Exception& E) {
                 E.display (3);
+                file.valid = item.cacheable = false;
               }
+              return true;
             }
-            ++progress;
-          }
-        }
-        catch (Exception& E) {
-          throw Exception (E, "error opening DICOM folder \"" + filename + "\": " + strerror (errno));
+
+          protected:
+            const ScanCache& cache;
+        };
+
+      }
+
+
+
+
+
+      void Tree::read_dir (const std::string& filename, ProgressBar& progress)
+      {
+        // scan each level of the folder hierarchy in turn, listing folders
+        // and parsing files in parallel:
+        ScanCache cache (filename);
+        vector<QuickScan> scans;
+        vector<std::string> paths (1, filename);
+        Exception error;
+
+        while (paths.size()) {
+          vector<std::string> next;
+          size_t n = 0;
+          auto source = [&] (std::string& path) {
+            if (n >= paths.size())
+              return false;
+            path = paths[n++];
+            return true;
+          };
+          Scanner scanner (cache);
+          auto sink = [&] (const Scanned& item) {
+            if (item.error.num()) {
+              error = item.error;
+              return false;
+            }
+            if (item.is_dir) {
+              next.insert (next.end(), item.contents.begin(), item.contents.end());
+            }
+            else {
+              if (item.cacheable)
+                cache.update (item.path, item.file);
+              if (item.file.valid)
+                scans.push_back (item.file.scan);
+              else
+                INFO ("error reading file \"" + item.path + "\" - ignored");
+            }
+            if (item.path != filename)
+              ++progress;
+            return true;
+          };
+          Thread::run_queue (source, std::string(), Thread::multi (scanner), Scanned(), sink);
+
+          if (error.num())
+            throw error;
+          paths.swap (next);
         }
+
+        // merge into the tree in a fixed order, independent of the order in
+        // which files were listed & parsed:
+        std::sort (scans.begin(), scans.end(), [] (const QuickScan& a, const QuickScan& b) { return a.filename < b.filename; });
+        for (const auto& scan : scans)
+          add (scan);
+
+        cache.save();
       }
 
 
@@ -90,9 +190,17 @@ namespace MR {
           INFO ("error reading file \"" + filename + "\" - ignored");
           return;
         }
+        add (reader);
+      }
+
 
+
+
+
+      void Tree::add (const QuickScan& reader)
+      {
         if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
-          INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored");
+          INFO ("DICOM file \"" + reader.filename + "\" does not seem to contain image data - ignored");
           return;
         }
 
@@ -103,7 +211,7 @@ namespace MR {
               reader.series_ref_UID,  reader.modality, reader.series_date, reader.series_time);
 
           std::shared_ptr<Image> image (new Image);
-          image->filename = filename;
+          image->filename = reader.filename;
           image->series = series.get();
           image->sequence_name = reader.sequence;
           image->image_type = image_type.first;
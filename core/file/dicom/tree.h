@@ -26,6 +26,7 @@ namespace MR {
 
       class Series;
       class Patient;
+      class QuickScan;
 
       class Tree : public vector<std::shared_ptr<Patient>> { NOMEMALIGN
         public:
@@ -46,6 +47,7 @@ namespace MR {
         protected:
           void read_dir (const std::string& filename, ProgressBar& progress);
           void read_file (const std::string& filename);
+          void add (const QuickScan& reader);
       };
 
       std::ostream& operator<< (std::ostream& stream, const Tree& item);
@@ -0,0 +1,388 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <zlib.h>
+
+#include "exception.h"
+#include "progressbar.h"
+#include "raw.h"
+#include "ordered_thread_queue.h"
+#include "file/config.h"
+#include "file/gz_block.h"
+
+// GZip member header: ID1 ID2 CM FLG MTIME(4) XFL OS XLEN(2), followed by a
+// single extra subfield: SI1 SI2 LEN(2) BSIZE(4), where BSIZE holds the total
+// size of the member (header, compressed data & trailer) in bytes
+#define GZBLOCK_HEADER_SIZE 20
+// GZip member trailer: CRC32(4) ISIZE(4)
+#define GZBLOCK_TRAILER_SIZE 8
+
+namespace MR
+{
+  namespace File
+  {
+    namespace GZBlock
+    {
+
+      namespace
+      {
+
+        const uint8_t member_header[] = {
+          0x1f, 0x8b, // GZip magic number
+          0x08,       // compression method: deflate
+          0x04,       // flags: FEXTRA
+          0x00, 0x00, 0x00, 0x00, // modification time: not available
+          0x00,       // extra flags
+          0xff,       // operating system: unknown
+          0x08, 0x00, // length of extra field
+          'M', 'R',   // subfield identifier
+          0x04, 0x00  // length of subfield data
+        };
+
+
+
+        class Compressed { NOMEMALIGN
+          public:
+            size_t index;
+            vector<uint8_t> data;
+        };
+
+        class Uncompressed { NOMEMALIGN
+          public:
+            const uint8_t* data;
+            size_t size;
+        };
+
+
+
+        class CompressedSource { NOMEMALIGN
+          public:
+            CompressedSource (const std::string& filename, const vector<Entry>& blocks, size_t first, size_t last) :
+              filename (filename),
+              in (filename, std::ios::in | std::ios::binary),
+              blocks (blocks),
+              current (first),
+              last (last) {
+                if (!in)
+                  throw Exception ("failed to open file \"" + filename + "\": " + strerror (errno));
+                if (current < last)
+                  in.seekg (blocks[current].compressed_offset, in.beg);
+              }
+
+            bool operator() (Compressed& item) {
+              if (current >= last)
+                return false;
+              item.index = current;
+              item.data.resize (blocks[current].compressed_size);
+              in.read (reinterpret_cast<char*> (item.data.data()), item.data.size());
+              if (!in.good())
+                throw Exception ("error reading compressed data from file \"" + filename + "\": " + strerror (errno));
+              ++current;
+              return true;
+            }
+
+          protected:
+            const std::string& filename;
+            std::ifstream in;
+            const vector<Entry>& blocks;
+            size_t current;
+            const size_t last;
+        };
+
+
+
+        class Inflator { NOMEMALIGN
+          public:
+            Inflator (const std::string& filename, const vector<Entry>& blocks, int64_t offset, uint8_t* data, int64_t size) :
+              filename (filename),
+              blocks (blocks),
+              offset (offset),
+              data (data),
+              size (size) { }
+
+            bool operator() (const Compressed& in, size_t& out) {
+              const Entry& entry = blocks[in.index];
+              const int64_t start = std::max (entry.offset, offset);
+              const int64_t end = std::min (entry.offset + int64_t (entry.size), offset + size);
+
+              // inflate directly into the destination if the entire block is
+              // required, otherwise go via a scratch buffer:
+              uint8_t* dest = data + (entry.offset - offset);
+              if (start != entry.offset || end != entry.offset + int64_t (entry.size)) {
+                buffer.resize (entry.size);
+                dest = buffer.data();
+              }
+
+              z_stream zstream;
+              zstream.zalloc = Z_NULL;
+              zstream.zfree = Z_NULL;
+              zstream.opaque = Z_NULL;
+              zstream.next_in = const_cast<uint8_t*> (in.data.data()) + GZBLOCK_HEADER_SIZE;
+              zstream.avail_in = in.data.size() - GZBLOCK_HEADER_SIZE - GZBLOCK_TRAILER_SIZE;
+              if (inflateInit2 (&zstream, -MAX_WBITS) != Z_OK)
+                throw Exception ("error initialising decompression for file \"" + filename + "\"");
+              zstream.next_out = dest;
+              zstream.avail_out = entry.size;
+              const int status = inflate (&zstream, Z_FINISH);
+              inflateEnd (&zstream);
+              if (status != Z_STREAM_END || zstream.avail_out)
+                throw Exception ("error uncompressing block " + str(in.index) + " of file \"" + filename + "\"");
+
+              const uint8_t* trailer = in.data.data() + in.data.size() - GZBLOCK_TRAILER_SIZE;
+              if (Raw::fetch_LE<uint32_t> (trailer) != uint32_t (crc32 (0L, dest, entry.size)))
+                throw Exception ("CRC mismatch for block " + str(in.index) + " of file \"" + filename + "\"");
+
+              if (dest == buffer.data())
+                memcpy (data + (start - offset), buffer.data() + (start - entry.offset), end - start);
+
+              out = in.index;
+              return true;
+            }
+
+          protected:
+            const std::string& filename;
+            const vector<Entry>& blocks;
+            const int64_t offset;
+            uint8_t* const data;
+            const int64_t size;
+            vector<uint8_t> buffer;
+        };
+
+
+
+        class UncompressedSource { NOMEMALIGN
+          public:
+            UncompressedSource (const uint8_t* data, size_t size, size_t bytes_per_block) :
+              data (data),
+              remaining (size),
+              bytes_per_block (bytes_per_block) { }
+
+            bool operator() (Uncompressed& item) {
+              if (!remaining)
+                return false;
+              item.data = data;
+              item.size = std::min (remaining, bytes_per_block);
+              data += item.size;
+              remaining -= item.size;
+              return true;
+            }
+
+          protected:
+            const uint8_t* data;
+            size_t remaining;
+            const size_t bytes_per_block;
+        };
+
+
+
+        class Deflator { NOMEMALIGN
+          public:
+            Deflator (const std::string& filename) : filename (filename) { }
+
+            bool operator() (const Uncompressed& in, vector<uint8_t>& out) {
+              z_stream zstream;
+              zstream.zalloc = Z_NULL;
+              zstream.zfree = Z_NULL;
+              zstream.opaque = Z_NULL;
+              if (deflateInit2 (&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                throw Exception ("error initialising compression for file \"" + filename + "\"");
+
+              out.resize (GZBLOCK_HEADER_SIZE + deflateBound (&zstream, in.size) + GZBLOCK_TRAILER_SIZE);
+              zstream.next_in = const_cast<uint8_t*> (in.data);
+              zstream.avail_in = in.size;
+              zstream.next_out = out.data() + GZBLOCK_HEADER_SIZE;
+              zstream.avail_out = out.size() - GZBLOCK_HEADER_SIZE - GZBLOCK_TRAILER_SIZE;
+              const int status = deflate (&zstream, Z_FINISH);
+              const size_t compressed_size = zstream.total_out;
+              deflateEnd (&zstream);
+              if (status != Z_STREAM_END)
+                throw Exception ("error compressing data for file \"" + filename + "\"");
+
+              out.resize (GZBLOCK_HEADER_SIZE + compressed_size + GZBLOCK_TRAILER_SIZE);
+              memcpy (out.data(), member_header, sizeof (member_header));
+              Raw::store_LE<uint32_t> (out.size(), out.data() + sizeof (member_header));
+              uint8_t* trailer = out.data() + out.size() - GZBLOCK_TRAILER_SIZE;
+              Raw::store_LE<uint32_t> (crc32 (0L, in.data, in.size), trailer);
+              Raw::store_LE<uint32_t> (in.size, trailer + 4);
+              return true;
+            }
+
+          protected:
+            const std::string& filename;
+        };
+
+      }
+
+
+
+
+
+      bool enabled ()
+      {
+        //CONF option: ImageGZBlockCompression
+        //CONF default: 1 (true)
+        //CONF A boolean value to indicate whether compressed images
+        //CONF (e.g. .nii.gz, .mif.gz) should be written as a series of
+        //CONF independently compressed GZip blocks. Such files remain valid
+        //CONF GZip files, but can be compressed and decompressed in parallel
+        //CONF by MRtrix3. Set to 0 / false to write a single GZip stream
+        //CONF instead.
+        static const bool value = File::Config::get_bool ("ImageGZBlockCompression", true);
+        return value;
+      }
+
+
+
+      size_t block_size ()
+      {
+        //CONF option: ImageGZBlockSize
+        //CONF default: 1048576
+        //CONF The size (in bytes) of the uncompressed data to be stored in
+        //CONF each independently compressed block when writing
+        //CONF block-compressed GZip images (see ImageGZBlockCompression).
+        static const size_t value = std::min (std::max (File::Config::get_int ("ImageGZBlockSize", 1048576), 65536), 268435456);
+        return value;
+      }
+
+
+
+
+
+      Reader::Reader (const std::string& filename) :
+        filename (filename)
+      {
+        std::ifstream in (filename, std::ios::in | std::ios::binary);
+        if (!in)
+          throw Exception ("failed to open file \"" + filename + "\": " + strerror (errno));
+        in.seekg (0, in.end);
+        const int64_t file_size = in.tellg();
+
+        int64_t compressed_offset = 0, offset = 0;
+        uint8_t header[GZBLOCK_HEADER_SIZE];
+        while (compressed_offset < file_size) {
+          in.seekg (compressed_offset, in.beg);
+          in.read (reinterpret_cast<char*> (header), GZBLOCK_HEADER_SIZE);
+          if (!in.good() || memcmp (header, member_header, sizeof (member_header))) {
+            blocks.clear();
+            break;
+          }
+
+          Entry entry;
+          entry.compressed_offset = compressed_offset;
+          entry.compressed_size = Raw::fetch_LE<uint32_t> (header + sizeof (member_header));
+          if (entry.compressed_size < GZBLOCK_HEADER_SIZE + GZBLOCK_TRAILER_SIZE ||
+              compressed_offset + entry.compressed_size > file_size) {
+            blocks.clear();
+            break;
+          }
+
+          uint8_t isize[4];
+          in.seekg (compressed_offset + entry.compressed_size - 4, in.beg);
+          in.read (reinterpret_cast<char*> (isize), 4);
+          if (!in.good()) {
+            blocks.clear();
+            break;
+          }
+          entry.offset = offset;
+          entry.size = Raw::fetch_LE<uint32_t> (isize);
+
+          blocks.push_back (entry);
+          compressed_offset += entry.compressed_size;
+          offset += entry.size;
+        }
+
+        DEBUG ("file \"" + filename + "\" is " + ( blocks.size() ?
+              "block-compressed (" + str(blocks.size()) + " blocks)" :
+              "not block-compressed" ));
+      }
+
+
+
+      size_t Reader::num_blocks (int64_t offset, int64_t size) const
+      {
+        size_t count = 0;
+        for (const auto& entry : blocks)
+          if (entry.offset < offset + size && entry.offset + int64_t (entry.size) > offset)
+            ++count;
+        return count;
+      }
+
+
+
+      void Reader::read (int64_t offset, uint8_t* data, int64_t size, ProgressBar* progress) const
+      {
+        if (offset < 0 || offset + size > Reader::size())
+          throw Exception ("requested range exceeds size of uncompressed data in file \"" + filename + "\"");
+
+        size_t first = 0;
+        while (first < blocks.size() && blocks[first].offset + int64_t (blocks[first].size) <= offset)
+          ++first;
+        size_t last = first;
+        while (last < blocks.size() && blocks[last].offset < offset + size)
+          ++last;
+
+        CompressedSource source (filename, blocks, first, last);
+        Inflator inflator (filename, blocks, offset, data, size);
+        auto sink = [&] (const size_t&) { if (progress) ++(*progress); return true; };
+        Thread::run_queue (source, Compressed(), Thread::multi (inflator), size_t(), sink);
+      }
+
+
+
+
+
+      Writer::Writer (const std::string& filename, size_t block_size) :
+        filename (filename),
+        out (filename, std::ios::out | std::ios::binary | std::ios::trunc),
+        bytes_per_block (block_size)
+      {
+        if (!out)
+          throw Exception ("error opening output file \"" + filename + "\": " + strerror (errno));
+      }
+
+
+
+      void Writer::write (const uint8_t* data, size_t size, ProgressBar* progress)
+      {
+        assert (out.is_open());
+        UncompressedSource source (data, size, bytes_per_block);
+        Deflator deflator (filename);
+        auto sink = [&] (const vector<uint8_t>& member) {
+          out.write (reinterpret_cast<const char*> (member.data()), member.size());
+          if (!out.good())
+            throw Exception ("error writing to file \"" + filename + "\": " + strerror (errno));
+          if (progress)
+            ++(*progress);
+          return true;
+        };
+        Thread::run_ordered_queue (source, Uncompressed(), Thread::multi (deflator), vector<uint8_t>(), sink);
+      }
+
+
+
+      void Writer::close ()
+      {
+        if (out.is_open()) {
+          out.close();
+          if (out.fail())
+            throw Exception ("error closing file \"" + filename + "\": " + strerror (errno));
+        }
+      }
+
+    }
+  }
+}
+
@@ -0,0 +1,124 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_gz_block_h__
+#define __file_gz_block_h__
+
+#include <fstream>
+
+#include "types.h"
+
+namespace MR
+{
+  class ProgressBar;
+
+  namespace File
+  {
+
+    //! Classes to handle block-compressed GZip files
+    /*! Block-compressed GZip files consist of a series of concatenated,
+     * independently compressed GZip members, each of which records its own
+     * total compressed size in an 'MR' subfield of the GZip header extra
+     * field (in the spirit of the BGZF format). Such files remain valid GZip
+     * streams that can be read by any GZip-aware software; however, their
+     * structure allows the individual members to be compressed and
+     * decompressed in parallel, and the member(s) corresponding to any
+     * uncompressed byte range to be located without inflating the entire
+     * stream. */
+    namespace GZBlock
+    {
+
+      //! whether images should be written in block-compressed form
+      bool enabled ();
+
+      //! the uncompressed size of each block written
+      size_t block_size ();
+
+
+
+      //! the location of a single block within a block-compressed GZip file
+      class Entry { NOMEMALIGN
+        public:
+          int64_t  compressed_offset, offset;
+          uint32_t compressed_size, size;
+      };
+
+
+
+      //! read (a byte range from) a block-compressed GZip file
+      /*! On construction, the headers of the GZip members in the file are
+       * scanned to build an index of the offsets of all blocks, in both
+       * compressed and uncompressed streams. If the file is not
+       * block-compressed (e.g. it consists of a single GZip stream), the
+       * index will be empty, and the caller should fall back to serial
+       * decompression using File::GZ. */
+      class Reader { NOMEMALIGN
+        public:
+          Reader (const std::string& filename);
+
+          const std::string& name () const { return filename; }
+          const vector<Entry>& index () const { return blocks; }
+          bool is_block_compressed () const { return blocks.size(); }
+
+          //! the total size of the uncompressed stream
+          int64_t size () const { return blocks.size() ? blocks.back().offset + blocks.back().size : 0; }
+
+          //! the number of blocks overlapping the uncompressed range requested
+          size_t num_blocks (int64_t offset, int64_t size) const;
+
+          //! decompress \a size bytes starting at \a offset in the uncompressed stream into \a data
+          /*! Only those blocks overlapping the requested range are read and
+           * inflated; this is done in parallel. If \a progress is non-null,
+           * it will be incremented once per block processed. */
+          void read (int64_t offset, uint8_t* data, int64_t size, ProgressBar* progress = nullptr) const;
+
+        protected:
+          std::string filename;
+          vector<Entry> blocks;
+      };
+
+
+
+      //! write a block-compressed GZip file
+      /*! Each call to write() splits the data provided into blocks of
+       * block_size() bytes (the last being possibly shorter), compresses
+       * them in parallel, and appends the resulting GZip members to the file
+       * in order. */
+      class Writer { NOMEMALIGN
+        public:
+          Writer (const std::string& filename, size_t block_size = GZBlock::block_size());
+
+          const std::string& name () const { return filename; }
+
+          //! compress and append \a size bytes from \a data
+          /*! If \a progress is non-null, it will be incremented once per
+           * block written. */
+          void write (const uint8_t* data, size_t size, ProgressBar* progress = nullptr);
+
+          void close ();
+
+        protected:
+          std::string filename;
+          std::ofstream out;
+          const size_t bytes_per_block;
+      };
+
+    }
+  }
+}
+
+#endif
+
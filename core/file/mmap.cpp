@@ -195,7 +195,7 @@ namespace MR
 #ifdef MRTRIX_WINDOWS
         if (!UnmapViewOfFile ( (LPVOID) addr))
 #else
-          if (munmap (addr, msize))
+          if (munmap (addr, start + msize))
 #endif
             WARN ("error unmapping file \"" + Entry::name + "\": " + strerror (errno));
         close (fd);
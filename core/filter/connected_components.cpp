@@ -97,57 +97,7 @@ namespace MR
     void Connector::run (vector<Cluster>& clusters,
                          vector<uint32_t>& labels) const
     {
-      assert (adjacency.size());
-      labels.resize (adjacency.size(), 0);
-      uint32_t current_label = 0;
-      for (uint32_t i = 0; i < labels.size(); i++) {
-        // This node has not been already clustered
-        if (!labels[i]) {
-          Cluster cluster (++current_label);
-          depth_first_search (i, cluster, labels);
-          clusters.push_back (cluster);
-        }
-      }
-      if (clusters.size() > std::numeric_limits<uint32_t>::max())
-        throw Exception ("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
-    }
-
-
-
-    bool Connector::next_neighbour (uint32_t& node, vector<uint32_t>& labels) const
-    {
-      for (auto n : adjacency[node]) {
-        if (!labels[n]) {
-          node = n;
-          return true;
-        }
-      }
-      return false;
-    }
-
-
-
-    void Connector::depth_first_search (const uint32_t root,
-                                        Cluster& cluster,
-                                        vector<uint32_t>& labels) const
-    {
-      uint32_t node = root;
-      std::stack<uint32_t> stack;
-      while (true) {
-        labels[node] = cluster.label;
-        stack.push (node);
-        cluster.size++;
-        if (next_neighbour (node, labels)) {
-          continue;
-        } else {
-          do {
-            if (stack.top() == root)
-              return;
-            stack.pop();
-            node = stack.top();
-          } while (!next_neighbour (node, labels));
-        }
-      }
+      label (clusters, labels, [] (const uint32_t) { return true; });
     }
 
 
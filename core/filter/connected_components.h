@@ -18,15 +18,18 @@
 #define __filter_connected_h__
 
 
+#include "app.h"
 #include "image.h"
 #include "memory.h"
+#include "thread.h"
+#include "thread_queue.h"
 #include "types.h"
 
 #include "filter/base.h"
 #include "misc/voxel2vector.h"
 
-#include <stack>
 #include <iostream>
+#include <thread>
 
 
 namespace MR
@@ -125,15 +128,28 @@ namespace MR
 
         // Utility functions that perform the actual connected
         //   components functionality
-        bool next_neighbour (uint32_t&, vector<uint32_t>&) const;
-        template <class VectorType>
-        bool next_neighbour (uint32_t&, vector<uint32_t>&,
-                             const VectorType&, const float) const;
+        template <class IncludeFunctor>
+        void label (vector<Cluster>&, vector<uint32_t>&, IncludeFunctor) const;
 
-        void depth_first_search (const uint32_t, Cluster&, vector<uint32_t>&) const;
-        template <class VectorType>
-        void depth_first_search (const uint32_t, Cluster&, vector<uint32_t>&,
-                                 const VectorType&, const float) const;
+        // Union-find operations, where the representative of each set is
+        //   always the element of that set with the lowest index
+        static uint32_t find (vector<uint32_t>& parent, uint32_t i)
+        {
+          while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+          }
+          return i;
+        }
+        static void unite (vector<uint32_t>& parent, const uint32_t i, const uint32_t j)
+        {
+          const uint32_t root_i = find (parent, i);
+          const uint32_t root_j = find (parent, j);
+          if (root_i < root_j)
+            parent[root_j] = root_i;
+          else if (root_j < root_i)
+            parent[root_i] = root_j;
+        }
 
 
     };
@@ -146,63 +162,106 @@ namespace MR
                          const VectorType& data,
                          const float threshold) const
     {
-      assert (adjacency.size());
-      labels.resize (adjacency.size(), 0);
-      uint32_t current_label = 0;
-      for (uint32_t i = 0; i < labels.size(); i++) {
-        // This node has not been already clustered and is above threshold
-        if (!labels[i] && data[i] > threshold) {
-          Cluster cluster (++current_label);
-          depth_first_search (i, cluster, labels, data, threshold);
-          clusters.push_back (cluster);
-        }
-      }
-      if (clusters.size() > std::numeric_limits<uint32_t>::max())
-        throw Exception ("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
+      label (clusters, labels, [&] (const uint32_t i) { return data[i] > threshold; });
     }
 
 
 
-    template <class VectorType>
-    bool Connector::next_neighbour (uint32_t& node,
-                                    vector<uint32_t>& labels,
-                                    const VectorType& data,
-                                    const float threshold) const
+    // Elements are assigned to sets using union-find, with the range of
+    //   element indices divided into contiguous blocks that are processed in
+    //   parallel; since adjacent elements are typically close in index, the
+    //   relatively small number of connections between blocks are merged
+    //   afterwards. Because the representative of each set is its lowest
+    //   index, labels are assigned in the same order as in a sequential
+    //   search through the elements.
+    template <class IncludeFunctor>
+    void Connector::label (vector<Cluster>& clusters,
+                           vector<uint32_t>& labels,
+                           IncludeFunctor include) const
     {
-      for (auto n : adjacency[node]) {
-        if (!labels[n] && data[n] > threshold) {
-          node = n;
-          return true;
-        }
-      }
-      return false;
-    }
-
+      assert (adjacency.size());
+      const uint32_t num_elements = adjacency.size();
+      labels.assign (num_elements, 0);
+      vector<uint32_t> parent (num_elements);
+      for (uint32_t i = 0; i != num_elements; ++i)
+        parent[i] = i;
+
+      // Labelling is only distributed across threads when invoked from the
+      //   main thread; where this is invoked concurrently from multiple
+      //   threads (e.g. during permutation testing), each invocation is
+      //   instead processed serially
+      const size_t num_blocks = (std::this_thread::get_id() == App::main_thread_ID && num_elements >= 65536) ?
+                                std::max (Thread::threads_to_execute(), size_t(1)) :
+                                1;
+      vector<vector<std::pair<uint32_t, uint32_t>>> boundaries (num_blocks);
+
+      class Worker
+      { NOMEMALIGN
+        public:
+          Worker (const Adjacency& adjacency,
+                  IncludeFunctor& include,
+                  vector<uint32_t>& parent,
+                  vector<vector<std::pair<uint32_t, uint32_t>>>& boundaries) :
+              adjacency (adjacency),
+              include (include),
+              parent (parent),
+              boundaries (boundaries) { }
+
+          bool operator() (const size_t block)
+          {
+            const uint32_t begin = (uint64_t(parent.size()) * block) / boundaries.size();
+            const uint32_t end = (uint64_t(parent.size()) * (block+1)) / boundaries.size();
+            for (uint32_t i = begin; i != end; ++i) {
+              if (!include (i))
+                continue;
+              for (auto n : adjacency[i]) {
+                // Each connection within the block is processed only once;
+                //   connections to preceding blocks are recorded by those blocks
+                if (n < i && n >= begin) {
+                  if (include (n))
+                    unite (parent, i, n);
+                } else if (n >= end) {
+                  if (include (n))
+                    boundaries[block].push_back (std::make_pair (i, uint32_t(n)));
+                }
+              }
+            }
+            return true;
+          }
 
+        private:
+          const Adjacency& adjacency;
+          IncludeFunctor& include;
+          vector<uint32_t>& parent;
+          vector<vector<std::pair<uint32_t, uint32_t>>>& boundaries;
+      };
+
+      Worker worker (adjacency, include, parent, boundaries);
+      if (num_blocks > 1)
+        Thread::run_queue (Thread::IndexSource (num_blocks), size_t(), Thread::multi (worker));
+      else
+        worker (0);
+
+      for (const auto& block : boundaries) {
+        for (const auto& connection : block)
+          unite (parent, connection.first, connection.second);
+      }
 
-    template <class VectorType>
-    void Connector::depth_first_search (const uint32_t root,
-                                        Cluster& cluster,
-                                        vector<uint32_t>& labels,
-                                        const VectorType& data,
-                                        const float threshold) const
-    {
-      uint32_t node = root;
-      std::stack<uint32_t> stack;
-      while (true) {
-        labels[node] = cluster.label;
-        stack.push (node);
-        cluster.size++;
-        if (next_neighbour (node, labels, data, threshold)) {
+      const size_t first_cluster = clusters.size();
+      uint32_t current_label = 0;
+      for (uint32_t i = 0; i != num_elements; ++i) {
+        if (!include (i))
           continue;
+        const uint32_t root = find (parent, i);
+        if (root == i) {
+          if (current_label == std::numeric_limits<uint32_t>::max())
+            throw Exception ("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
+          clusters.push_back (Cluster (++current_label));
+          labels[i] = current_label;
         } else {
-          do {
-            if (stack.top() == root)
-              return;
-            stack.pop();
-            node = stack.top();
-          } while (!next_neighbour (node, labels, data, threshold));
+          labels[i] = labels[root];
         }
+        clusters[first_cluster + labels[i] - 1].size++;
       }
     }
 
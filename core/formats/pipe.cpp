@@ -14,25 +14,132 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <iostream>
+#include <sstream>
 #include <unistd.h>
+#ifdef MRTRIX_WINDOWS
+# include <fcntl.h>
+# include <io.h>
+#endif
 
 #include "signal_handler.h"
+#include "file/config.h"
 #include "file/utils.h"
 #include "file/path.h"
 #include "header.h"
+#include "image_helpers.h"
 #include "image_io/pipe.h"
 #include "formats/list.h"
+#include "formats/mrtrix_utils.h"
 
 namespace MR
 {
   namespace Formats
   {
 
+    namespace
+    {
+
+      void set_binary_mode (FILE* stream)
+      {
+#ifdef MRTRIX_WINDOWS
+        _setmode (_fileno (stream), _O_BINARY);
+#else
+        (void) stream;
+#endif
+      }
+
+
+
+      //CONF option: PipedImageStreamMaxSize
+      //CONF default: 0
+      //CONF The size (in bytes) of the largest image that will be streamed
+      //CONF through a pipe between MRtrix3 commands; larger images are
+      //CONF instead written to a temporary file, and only its name is sent
+      //CONF through the pipe. The default of 0 always uses temporary files,
+      //CONF as is required to capture the name of the temporary file using
+      //CONF shell command substitution.
+      int64_t stream_max_size ()
+      {
+        static const int64_t value = to<int64_t> (File::Config::get ("PipedImageStreamMaxSize", "0"));
+        return value;
+      }
+
+
+
+      // reads the header of an image streamed through standard input,
+      // keeping track of the number of bytes consumed:
+      class StreamHeaderReader
+      { NOMEMALIGN
+        public:
+          StreamHeaderReader (size_t consumed) : consumed (consumed) { }
+
+          std::string getline () {
+            std::string line;
+            if (!std::getline (std::cin, line))
+              throw Exception ("unexpected end of header for piped image (did the previous command in the pipeline fail?)");
+            consumed += line.size() + 1;
+            return line;
+          }
+
+          size_t consumed;
+      };
+
+
+      bool next_keyvalue (StreamHeaderReader& in, std::string& key, std::string& value)
+      {
+        key.clear(); value.clear();
+        std::string line = in.getline();
+        line = strip (line.substr (0, line.find_first_of ('#')));
+        if (line.empty() || line == "END")
+          return false;
+
+        size_t colon = line.find_first_of (':');
+        if (colon == std::string::npos) {
+          INFO ("malformed key/value entry (\"" + line + "\") in piped image header - ignored");
+        } else {
+          key   = strip (line.substr (0, colon));
+          value = strip (line.substr (colon+1));
+          if (key.empty() || value.empty()) {
+            INFO ("malformed key/value entry (\"" + line + "\") in piped image header - ignored");
+            key.clear();
+            value.clear();
+          }
+        }
+        return true;
+      }
+
+
+
+      std::unique_ptr<ImageIO::Base> read_stream (Header& H, size_t consumed)
+      {
+        StreamHeaderReader in (consumed);
+        read_mrtrix_header (H, in);
+
+        std::string fname;
+        size_t offset;
+        get_mrtrix_file_path (H, "file", fname, offset);
+        if (fname != H.name() || offset < in.consumed)
+          throw Exception ("invalid data offset in header of piped image");
+        std::cin.ignore (offset - in.consumed);
+
+        return std::unique_ptr<ImageIO::Base> (new ImageIO::PipeStream (H));
+      }
+
+    }
+
+
+
+
     std::unique_ptr<ImageIO::Base> Pipe::read (Header& H) const
     {
       if (is_dash (H.name())) {
+        set_binary_mode (stdin);
         std::string name;
         getline (std::cin, name);
+        // images small enough are streamed in .mif format through the pipe:
+        if (name == "mrtrix image")
+          return read_stream (H, name.size() + 1);
         H.name() = name;
       }
       else {
@@ -66,6 +173,15 @@ namespace MR
       if (isatty (STDOUT_FILENO))
         throw Exception ("cannot create output piped image: no command connected at other end of pipe to receive that image");
 
+      H.ndim() = num_axes;
+      for (size_t i = 0; i < H.ndim(); i++)
+        if (H.size (i) < 1)
+          H.size(i) = 1;
+
+      // the image will be streamed if its name is left as a dash:
+      if (footprint (H) <= stream_max_size())
+        return true;
+
       H.name() = File::create_tempfile (0, "mif");
 
       SignalHandler::mark_file_for_deletion (H.name());
@@ -78,6 +194,25 @@ namespace MR
 
     std::unique_ptr<ImageIO::Base> Pipe::create (Header& H) const
     {
+      if (is_dash (H.name())) {
+        // send the header straight away, so that the next command can start
+        // setting up while this one processes the data:
+        std::stringstream header;
+        header << "mrtrix image\n";
+        write_mrtrix_header (H, header);
+        int64_t offset = int64_t(header.tellp()) + int64_t(24);
+        offset += ((4 - (offset % 4)) % 4);
+        header << "file: . " << offset << "\nEND\n";
+        while (int64_t(header.tellp()) < offset)
+          header << '\0';
+
+        set_binary_mode (stdout);
+        std::cout << header.str() << std::flush;
+        if (!std::cout)
+          throw Exception ("error sending header for piped image: " + std::string (strerror (errno)));
+        return std::unique_ptr<ImageIO::Base> (new ImageIO::PipeStream (H));
+      }
+
       std::unique_ptr<ImageIO::Base> original_handler (mrtrix_handler.create (H));
       std::unique_ptr<ImageIO::Pipe> io_handler (new ImageIO::Pipe (std::move (*original_handler)));
       return std::move (io_handler);
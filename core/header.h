@@ -330,6 +330,21 @@ namespace MR
 
       bool is_file_backed () const { return valid() ? io->is_file_backed() : false; }
 
+      //! indicate that only positions \a indices along \a axis will be accessed
+      /*! This can be invoked prior to get_image() for an existing image, to
+       * inform the image loader that only these positions along \a axis
+       * (e.g. a subset of volumes) will subsequently be read. For image
+       * formats that would otherwise need to be uncompressed in their
+       * entirety, this allows only the relevant portions of the file to be
+       * decompressed. Accessing the image at any other position along that
+       * axis yields undefined values.
+       *
+       * \sa ImageIO::Base::restrict_access() */
+      void restrict_access (size_t axis, const vector<uint32_t>& indices) {
+        if (valid())
+          io->restrict_access (axis, indices);
+      }
+
       //! make header self-consistent
       void sanitise () {
         DEBUG ("sanitising image information...");
@@ -34,6 +34,8 @@ namespace MR
 
     bool Base::is_file_backed () const { return true; }
 
+    void Base::restrict_access (size_t, const vector<uint32_t>&) { }
+
     void Base::open (const Header& header, size_t buffer_size)
     {
       if (addresses.size())
@@ -53,6 +53,15 @@ namespace MR
 
         virtual bool is_file_backed () const;
 
+        //! indicate that only positions \a indices along \a axis will be accessed
+        /*! This is only a hint: handlers that would otherwise need to load
+         * the entire image into memory (i.e. compressed images) may use it
+         * to avoid loading data that will never be accessed. The contents of
+         * the image at all other positions along that axis are then
+         * undefined. This has no effect if invoked after the image has been
+         * loaded, or for images opened read-write. */
+        virtual void restrict_access (size_t axis, const vector<uint32_t>& indices);
+
         // buffer_size is only used for scratch data; it is ignored in all
         // other (file-backed) handlers, where the buffer size is determined
         // from the information in the header
@@ -19,8 +19,10 @@
 #include "app.h"
 #include "progressbar.h"
 #include "header.h"
+#include "stride.h"
 #include "image_io/gz.h"
 #include "file/gz.h"
+#include "file/gz_block.h"
 
 #define BYTES_PER_ZCALL 524288
 
@@ -48,12 +50,32 @@ namespace MR
       if (is_new)
         memset (addresses[0].get(), 0, files.size() * bytes_per_segment);
       else {
-        ProgressBar progress ("uncompressing image \"" + header.name() + "\"",
-            files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+        // use parallel decompression for any block-compressed files (limited
+        // to those regions actually required), and fall back to serial
+        // decompression otherwise:
+        const auto ranges = required_ranges (header);
+        vector<File::GZBlock::Reader> readers;
+        size_t progress_target = 0;
         for (size_t n = 0; n < files.size(); n++) {
+          readers.push_back (File::GZBlock::Reader (files[n].name));
+          if (readers.back().is_block_compressed()) {
+            for (const auto& range : ranges)
+              progress_target += readers.back().num_blocks (files[n].start + range.first, range.second);
+          }
+          else
+            progress_target += bytes_per_segment / BYTES_PER_ZCALL;
+        }
+
+        ProgressBar progress ("uncompressing image \"" + header.name() + "\"", progress_target);
+        for (size_t n = 0; n < files.size(); n++) {
+          uint8_t* address = addresses[0].get() + n*bytes_per_segment;
+          if (readers[n].is_block_compressed()) {
+            for (const auto& range : ranges)
+              readers[n].read (files[n].start + range.first, address + range.first, range.second, &progress);
+            continue;
+          }
           File::GZ zf (files[n].name, "rb");
           zf.seek (files[n].start);
-          uint8_t* address = addresses[0].get() + n*bytes_per_segment;
           uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
           while (address < last) {
             zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
@@ -75,12 +97,74 @@ namespace MR
 
 
 
+    void GZ::restrict_access (size_t axis, const vector<uint32_t>& indices)
+    {
+      if (accessed.size() <= axis)
+        accessed.resize (axis+1);
+      accessed[axis] = indices;
+      std::sort (accessed[axis].begin(), accessed[axis].end());
+      accessed[axis].erase (std::unique (accessed[axis].begin(), accessed[axis].end()), accessed[axis].end());
+    }
+
+
+
+    vector<std::pair<int64_t,int64_t>> GZ::required_ranges (const Header& header) const
+    {
+      // access can only be restricted to contiguous slabs of data along the
+      // outermost axis, and only for images that will not be written back:
+      vector<std::pair<int64_t,int64_t>> ranges;
+      const size_t axis = Stride::order (header).back();
+      if (files.size() == 1 && !writable && header.datatype().bits() > 1 &&
+          axis < accessed.size() && accessed[axis].size()) {
+        const int64_t bytes_per_slab = footprint (header) / header.size (axis);
+        // slabs are stored in reverse order for negative strides, so sort
+        // their positions before merging adjacent slabs:
+        vector<int64_t> slabs;
+        for (const auto index : accessed[axis]) {
+          if (index >= header.size (axis))
+            throw Exception ("position " + str(index) + " along axis " + str(axis) + " is out of range for image \"" + header.name() + "\"");
+          slabs.push_back (header.stride (axis) > 0 ? index : header.size (axis) - 1 - index);
+        }
+        std::sort (slabs.begin(), slabs.end());
+        for (const auto slab : slabs) {
+          const int64_t start = bytes_per_slab * slab;
+          if (ranges.size() && ranges.back().first + ranges.back().second == start)
+            ranges.back().second += bytes_per_slab;
+          else
+            ranges.push_back ({ start, bytes_per_slab });
+        }
+        DEBUG ("restricting decompression of image \"" + header.name() + "\" to "
+            + str(accessed[axis].size()) + " of " + str(header.size (axis)) + " positions along axis " + str(axis));
+      }
+      else
+        ranges.push_back ({ 0, bytes_per_segment });
+      return ranges;
+    }
+
+
+
     void GZ::unload (const Header& header)
     {
       if (addresses.size()) {
         assert (addresses[0]);
 
-        if (writable) {
+        if (writable && File::GZBlock::enabled()) {
+          const size_t block_size = File::GZBlock::block_size();
+          auto num_blocks = [&] (size_t size) { return (size + block_size - 1) / block_size; };
+          ProgressBar progress ("compressing image \"" + header.name() + "\"",
+              files.size() * (num_blocks (lead_in_size) + num_blocks (bytes_per_segment) + num_blocks (lead_out_size)));
+          for (size_t n = 0; n < files.size(); n++) {
+            assert (files[n].start == int64_t (lead_in_size));
+            File::GZBlock::Writer zf (files[n].name, block_size);
+            if (lead_in)
+              zf.write (lead_in.get(), lead_in_size, &progress);
+            zf.write (addresses[0].get() + n*bytes_per_segment, bytes_per_segment, &progress);
+            if (lead_out)
+              zf.write (lead_out.get(), lead_out_size, &progress);
+            zf.close();
+          }
+        }
+        else if (writable) {
           ProgressBar progress ("compressing image \"" + header.name() + "\"",
               files.size() * bytes_per_segment / BYTES_PER_ZCALL);
           for (size_t n = 0; n < files.size(); n++) {
@@ -31,7 +31,8 @@ namespace MR
       public:
         GZ (GZ&&) = default;
         GZ (const Header& header, size_t file_header_size, size_t file_tailer_size = 0) :
-          Base (header), 
+          Base (header),
+          bytes_per_segment (0),
           lead_in_size (file_header_size),
           lead_out_size (file_tailer_size),
           lead_in (file_header_size ? new uint8_t [file_header_size] : nullptr),
@@ -45,10 +46,18 @@ namespace MR
           return lead_out.get();
         }
 
+        virtual void restrict_access (size_t axis, const vector<uint32_t>& indices) override;
+
+        //! the byte ranges (offset & size) of the data that need to be decompressed
+        /*! adjacent slabs are merged into a single range, whatever the sign
+         * of the stride along the restricted axis. */
+        vector<std::pair<int64_t,int64_t>> required_ranges (const Header& header) const;
+
       protected:
         int64_t  bytes_per_segment;
         size_t   lead_in_size, lead_out_size;
         std::unique_ptr<uint8_t[]> lead_in, lead_out;
+        vector<vector<uint32_t>> accessed;
 
         virtual void load (const Header&, size_t);
         virtual void unload (const Header&);
@@ -14,11 +14,14 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <cstring>
+#include <iostream>
 #include <limits>
 #include <unistd.h>
 
 #include "signal_handler.h"
 #include "header.h"
+#include "stride.h"
 #include "image_io/pipe.h"
 
 namespace MR
@@ -57,6 +60,77 @@ namespace MR
 
     bool Pipe::delete_piped_images = true;
 
+
+
+
+
+    PipeStream::PipeStream (const Header& header) :
+        Base (header),
+        bytes_per_segment ((header.datatype().bits() * segsize + 7) / 8),
+        received (false) { }
+
+
+
+    PipeStream::~PipeStream ()
+    {
+      if (!is_new && !received) {
+        DEBUG ("discarding data for unused piped image");
+        std::cin.ignore (bytes_per_segment);
+      }
+    }
+
+
+
+    void PipeStream::load (const Header& header, size_t)
+    {
+      if (double (bytes_per_segment) >= double (std::numeric_limits<size_t>::max()))
+        throw Exception ("image \"" + header.name() + "\" is larger than maximum accessible memory");
+
+      addresses.resize (1);
+      addresses[0].reset (new uint8_t [bytes_per_segment]);
+      if (is_new) {
+        DEBUG ("allocating RAM buffer for piped image \"" + header.name() + "\"...");
+        memset (addresses[0].get(), 0, bytes_per_segment);
+        return;
+      }
+
+      DEBUG ("receiving data for piped image \"" + header.name() + "\"...");
+      received = true;
+      const int64_t slab = bytes_per_slab (header);
+      char* const data = reinterpret_cast<char*> (addresses[0].get());
+      for (int64_t offset = 0; offset < bytes_per_segment; offset += slab) {
+        if (!std::cin.read (data + offset, std::min (slab, bytes_per_segment - offset)))
+          throw Exception ("unexpected end of data for piped image \"" + header.name() + "\" (did the previous command in the pipeline fail?)");
+      }
+    }
+
+
+
+    void PipeStream::unload (const Header& header)
+    {
+      if (!is_new)
+        return;
+
+      DEBUG ("sending data for piped image \"" + header.name() + "\"...");
+      const int64_t slab = bytes_per_slab (header);
+      const char* const data = reinterpret_cast<const char*> (addresses[0].get());
+      for (int64_t offset = 0; offset < bytes_per_segment && std::cout; offset += slab)
+        std::cout.write (data + offset, std::min (slab, bytes_per_segment - offset));
+      std::cout.flush();
+      if (!std::cout)
+        throw Exception ("error sending data for piped image \"" + header.name() + "\": " + strerror (errno));
+    }
+
+
+
+    int64_t PipeStream::bytes_per_slab (const Header& header) const
+    {
+      // bit-packed slabs need not start on a byte boundary:
+      if (header.datatype().bits() == 1)
+        return bytes_per_segment;
+      return bytes_per_segment / header.size (Stride::order (header).back());
+    }
+
   }
 }
 
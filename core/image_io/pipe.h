@@ -26,6 +26,9 @@ namespace MR
   namespace ImageIO
   {
 
+    //! handles piped images passed via a temporary file
+    /*! The image is written to a temporary .mif file, and only its
+     * filename is sent through the pipe. */
     class Pipe : public Base
     { NOMEMALIGN
       public:
@@ -41,6 +44,32 @@ namespace MR
 
     };
 
+
+
+    //! handles piped images streamed through the pipe itself
+    /*! The header (in .mif format) is sent as soon as the image is created,
+     * and the voxel data once the image is closed, as slabs along the
+     * outermost axis. The data are held in RAM at both ends of the pipe. */
+    class PipeStream : public Base
+    { NOMEMALIGN
+      public:
+        PipeStream (const Header& header);
+
+        //! discards the data of an input image that was never loaded
+        /*! this ensures the upstream command is not left blocked on (or
+         * killed by) writing to a pipe that is not being read. */
+        ~PipeStream ();
+
+      protected:
+        int64_t bytes_per_segment;
+        bool received;
+
+        virtual void load (const Header&, size_t);
+        virtual void unload (const Header&);
+
+        int64_t bytes_per_slab (const Header& header) const;
+    };
+
   }
 }
 
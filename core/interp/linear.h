@@ -141,7 +141,8 @@ namespace MR
         using LinearBase::eps;
 
         LinearInterp (const ImageType& parent, value_type value_when_out_of_bounds = Base<ImageType>::default_out_of_bounds_value()) :
-            LinearInterpBase <ImageType, LinearInterpProcessingType::Value> (parent, value_when_out_of_bounds)
+            LinearInterpBase <ImageType, LinearInterpProcessingType::Value> (parent, value_when_out_of_bounds),
+            cached_axis (std::numeric_limits<size_t>::max())
         { }
 
         //! Set the current position to <b>voxel space</b> position \a pos
@@ -245,8 +246,49 @@ namespace MR
           return coeff_matrix * factors;
         }
 
+        //! Read interpolated values from volumes along axis >= 3 into \a values
+        /*! This is equivalent to row(), except that the values of the 8
+         * voxels neighbouring the current position are retained between
+         * calls, and only fetched again from the image when the position
+         * moves into a different neighbourhood. This avoids most of the
+         * image accesses when interpolating at closely-spaced positions, as
+         * is typical of the samples along a streamline. Note that this
+         * assumes that the image contents are not modified between calls. */
+        template <class VectorType>
+        void cached_row (VectorType& values, size_t axis) {
+          if (Base<ImageType>::out_of_bounds) {
+            values.setConstant (ImageType::size(axis), Base<ImageType>::out_of_bounds_value);
+            return;
+          }
+
+          ssize_t c[] = { ssize_t (std::floor (P[0])), ssize_t (std::floor (P[1])), ssize_t (std::floor (P[2])) };
+
+          if (axis != cached_axis || c[0] != cached_corner[0] || c[1] != cached_corner[1] || c[2] != cached_corner[2]) {
+            cached_neighbourhood.resize (ImageType::size(axis), 8);
+            size_t i(0);
+            for (ssize_t z = 0; z < 2; ++z) {
+              ImageType::index(2) = clamp (c[2] + z, ImageType::size (2));
+              for (ssize_t y = 0; y < 2; ++y) {
+                ImageType::index(1) = clamp (c[1] + y, ImageType::size (1));
+                for (ssize_t x = 0; x < 2; ++x) {
+                  ImageType::index(0) = clamp (c[0] + x, ImageType::size (0));
+                  cached_neighbourhood.col (i++) = ImageType::row (axis);
+                }
+              }
+            }
+            cached_axis = axis;
+            for (size_t n = 0; n < 3; ++n)
+              cached_corner[n] = c[n];
+          }
+
+          values = cached_neighbourhood * factors;
+        }
+
       protected:
         Eigen::Matrix<coef_type, 8, 1> factors;
+        Eigen::Matrix<value_type, Eigen::Dynamic, 8> cached_neighbourhood;
+        size_t cached_axis;
+        ssize_t cached_corner[3];
     };
 
 
@@ -275,6 +275,72 @@ namespace MR
         }
 
 
+      //! evaluate a batch of SH series, each along its own direction
+      /*! This computes the amplitude of the SH series stored in each row of
+       * \a coefs along the unit direction stored in the corresponding row of
+       * \a unit_dirs, writing the results into the first coefs.rows() entries
+       * of \a amplitudes. Rather than performing the Legendre & azimuthal
+       * recursions independently for each direction as value() does, these
+       * are performed on arrays spanning up to 64 directions at a time,
+       * allowing the compiler to vectorise the computation across
+       * directions. For efficiency, \a coefs should be column-major, so that
+       * each coefficient is stored contiguously across the batch. */
+      template <class VectorType, class MatrixType1, class MatrixType2>
+        inline void values (VectorType& amplitudes, const MatrixType1& coefs, const MatrixType2& unit_dirs, int lmax)
+        {
+          using value_type = typename MatrixType1::Scalar;
+          using array_type = Eigen::Array<value_type,Eigen::Dynamic,1,0,64>;
+          assert (amplitudes.size() >= coefs.rows());
+          assert (unit_dirs.rows() == coefs.rows());
+
+          for (ssize_t start = 0; start < coefs.rows(); start += 64) {
+            const ssize_t num = std::min (coefs.rows() - start, ssize_t(64));
+            const auto C = coefs.middleRows (start, num);
+            const array_type x = unit_dirs.col(2).segment (start, num).array();
+            const array_type dx = unit_dirs.col(0).segment (start, num).array();
+            const array_type dy = unit_dirs.col(1).segment (start, num).array();
+            const array_type rxy = (dx.square() + dy.square()).sqrt();
+            const array_type cp = (rxy > value_type(0.0)).select (dx / rxy, value_type(1.0));
+            const array_type sp = (rxy > value_type(0.0)).select (dy / rxy, value_type(0.0));
+            const array_type one_minus_x2 = (value_type(1.0) - x.square()).max (value_type(0.0));
+
+            array_type amp = array_type::Zero (num);
+            array_type c = array_type::Ones (num), s = array_type::Zero (num);
+            array_type Pmm = array_type::Constant (num, value_type(0.282094791773878));
+            array_type P0 (num), P1 (num), P2 (num);
+
+            for (int m = 0; m <= lmax; ++m) {
+              if (m) {
+                // incremental form of Legendre::Plm_sph() for P(m,m),
+                // together with cos(m*azimuth) & sin(m*azimuth):
+                Pmm *= -(one_minus_x2 * (value_type(2*m+1) / value_type(2*m))).sqrt();
+                const array_type c_next = c * cp - s * sp;
+                s = s * cp + c * sp;
+                c = c_next;
+              }
+
+              P0 = Pmm;
+              value_type f = std::sqrt (value_type (2*m+3));
+              P1 = f * x * P0;
+              for (int l = m; l <= lmax; ++l) {
+                if (!(l&1)) {
+                  if (m)
+                    amp += P0 * Math::sqrt2 * (c * C.col (index (l,m)).array() + s * C.col (index (l,-m)).array());
+                  else
+                    amp += P0 * C.col (index (l,0)).array();
+                }
+                P2 = x * P1 - P0 / f;
+                f = std::sqrt (value_type (4*pow2 (l+2)-1) / value_type (pow2 (l+2)-pow2 (m)));
+                P0 = P1;
+                P1 = f * P2;
+              }
+            }
+
+            amplitudes.segment (start, num) = amp.matrix();
+          }
+        }
+
+
       template <class VectorType1, class VectorType2>
         inline VectorType1& delta (VectorType1& delta_vec, const VectorType2& unit_dir, int lmax)
         {
@@ -494,6 +560,59 @@ namespace MR
               return v;
             }
 
+          //! evaluate a batch of SH series, each along its own direction
+          /*! See Math::SH::values() for details; this version obtains the
+           * associated Legendre functions from the lookup table rather than
+           * computing them, and vectorises the remaining computations across
+           * up to 64 directions at a time. */
+          template <class VectorType, class MatrixType1, class MatrixType2>
+            void values (VectorType& amplitudes, const MatrixType1& coefs, const MatrixType2& unit_dirs) const {
+              using array_type = Eigen::Array<ValueType,Eigen::Dynamic,1,0,64>;
+              assert (amplitudes.size() >= coefs.rows());
+              assert (unit_dirs.rows() == coefs.rows());
+
+              for (ssize_t start = 0; start < coefs.rows(); start += 64) {
+                const ssize_t num = std::min (coefs.rows() - start, ssize_t(64));
+                const auto C = coefs.middleRows (start, num);
+                array_type f1 (num), f2 (num), cp (num), sp (num), AL_interp (num);
+                size_t offset1[64], offset2[64];
+                for (ssize_t n = 0; n < num; ++n) {
+                  const auto unit_dir = unit_dirs.row (start + n);
+                  PrecomputedFraction<ValueType> f;
+                  set (f, std::acos (unit_dir[2]));
+                  f1[n] = f.f1;
+                  f2[n] = f.f2;
+                  offset1[n] = f.p1 - AL.begin();
+                  // p2 lies beyond the table when clamped to the last elevation:
+                  offset2[n] = f.f2 ? offset1[n] + nAL : offset1[n];
+                  ValueType rxy = std::sqrt ( pow2(unit_dir[1]) + pow2(unit_dir[0]) );
+                  cp[n] = (rxy) ? unit_dir[0]/rxy : 1.0;
+                  sp[n] = (rxy) ? unit_dir[1]/rxy : 0.0;
+                }
+
+                auto interp_AL = [&] (int l, int m) -> const array_type& {
+                  const size_t i = index_mpos (l,m);
+                  for (ssize_t n = 0; n < num; ++n)
+                    AL_interp[n] = f1[n] * AL[offset1[n]+i] + f2[n] * AL[offset2[n]+i];
+                  return AL_interp;
+                };
+
+                array_type amp = array_type::Zero (num);
+                for (int l = 0; l <= lmax; l+=2)
+                  amp += interp_AL (l,0) * C.col (index (l,0)).array();
+                array_type c = array_type::Ones (num), s = array_type::Zero (num);
+                for (int m = 1; m <= lmax; m++) {
+                  const array_type c_next = c * cp - s * sp;
+                  s = s * cp + c * sp;
+                  c = c_next;
+                  for (int l = ( (m&1) ? m+1 : m); l <= lmax; l+=2)
+                    amp += interp_AL (l,m) * Math::sqrt2 * (c * C.col (index (l,m)).array() + s * C.col (index (l,-m)).array());
+                }
+
+                amplitudes.segment (start, num) = amp.matrix();
+              }
+            }
+
         protected:
           int lmax, ndir, nAL;
           ValueType inc;
@@ -504,6 +623,145 @@ namespace MR
 
 
 
+      //! Precomputed SH basis - used to speed up evaluation of SH amplitudes
+      /*! This holds the full (even-degree) SH basis row evaluated on a fine
+       * grid of directions, so that the amplitude along any direction can be
+       * obtained by bilinear interpolation of the dot products of the SH
+       * coefficients with the 4 nearest basis rows, with no trigonometric
+       * functions or Legendre recursions involved.
+       *
+       * The grid is defined on the faces of a cube: the direction is
+       * projected onto the face corresponding to its largest component,
+       * which is divided into a regular grid of \a resolution x \a
+       * resolution cells. Since even-degree SH series are antipodally
+       * symmetric, only the 3 positive faces need to be stored. The
+       * angular spacing between grid points is at most 2/\a resolution
+       * radians (at the face centres).
+       *
+       * On initialisation, the accuracy of the table is estimated using the
+       * sharpest possible SH series for the given \a lmax (the SH
+       * delta function), and can be queried using max_error(). */
+      template <typename ValueType> class PrecomputedBasis
+      { NOMEMALIGN
+        public:
+          using value_type = ValueType;
+
+          PrecomputedBasis () : lmax (0), res (0), nSH (0), error (NaN) { }
+          PrecomputedBasis (int up_to_lmax, ValueType angular_spacing) {
+            init (up_to_lmax, angular_spacing);
+          }
+
+          bool operator! () const {
+            return table.empty();
+          }
+          operator bool () const {
+            return table.size();
+          }
+
+          //! initialise the table, such that table entries are no more than \a angular_spacing radians apart
+          void init (int up_to_lmax, ValueType angular_spacing) {
+            lmax = up_to_lmax;
+            res = std::max (int (std::ceil (2.0 / angular_spacing)), 1);
+            nSH = NforL (lmax);
+            table.resize (3 * (res+1) * (res+1) * nSH);
+
+            Eigen::Matrix<ValueType,Eigen::Dynamic,1> row (nSH);
+            Eigen::Matrix<ValueType,3,1> dir;
+            for (int axis = 0; axis < 3; ++axis) {
+              for (int j = 0; j <= res; ++j) {
+                for (int i = 0; i <= res; ++i) {
+                  dir[axis] = 1.0;
+                  dir[(axis+1)%3] = -1.0 + ValueType(2*i) / res;
+                  dir[(axis+2)%3] = -1.0 + ValueType(2*j) / res;
+                  delta (row, dir.normalized(), lmax);
+                  std::copy (row.data(), row.data() + nSH, table.begin() + offset (axis, i, j));
+                }
+              }
+            }
+
+            estimate_error();
+          }
+
+          //! the angular resolution of the table, as the number of cells along each cube face
+          int resolution () const { return res; }
+
+          //! the memory used by the table, in bytes
+          size_t bytes () const { return table.size() * sizeof (ValueType); }
+
+          //! the maximum error observed in the amplitude of an SH delta function, relative to its peak amplitude
+          ValueType max_error () const { return error; }
+
+          template <class VectorType, class UnitVectorType>
+            ValueType value (const VectorType& val, const UnitVectorType& unit_dir) const {
+              int axis = 0;
+              if (std::abs (unit_dir[1]) > std::abs (unit_dir[axis])) axis = 1;
+              if (std::abs (unit_dir[2]) > std::abs (unit_dir[axis])) axis = 2;
+              const ValueType scale = ValueType(0.5) * res / unit_dir[axis];
+              ValueType u = (unit_dir[(axis+1)%3] * scale) + ValueType(0.5) * res;
+              ValueType v = (unit_dir[(axis+2)%3] * scale) + ValueType(0.5) * res;
+              const int i = std::min (std::max (int (u), 0), res-1);
+              const int j = std::min (std::max (int (v), 0), res-1);
+              u -= i;
+              v -= j;
+
+              const ValueType* p00 = table.data() + offset (axis, i, j);
+              const ValueType* p10 = p00 + nSH;
+              const ValueType* p01 = p00 + (res+1)*nSH;
+              const ValueType* p11 = p01 + nSH;
+              const ValueType w00 = (1-u)*(1-v), w10 = u*(1-v), w01 = (1-u)*v, w11 = u*v;
+              ValueType amplitude = 0.0;
+              for (size_t n = 0; n < nSH; ++n)
+                amplitude += val[n] * (w00*p00[n] + w10*p10[n] + w01*p01[n] + w11*p11[n]);
+              return amplitude;
+            }
+
+          //! evaluate a batch of SH series, each along its own direction
+          /*! See Math::SH::values() for details. */
+          template <class VectorType, class MatrixType1, class MatrixType2>
+            void values (VectorType& amplitudes, const MatrixType1& coefs, const MatrixType2& unit_dirs) const {
+              assert (amplitudes.size() >= coefs.rows());
+              assert (unit_dirs.rows() == coefs.rows());
+              for (ssize_t n = 0; n < coefs.rows(); ++n)
+                amplitudes[n] = value (coefs.row (n), unit_dirs.row (n));
+            }
+
+        protected:
+          int lmax, res;
+          size_t nSH;
+          ValueType error;
+          vector<ValueType> table;
+
+          size_t offset (int axis, int i, int j) const {
+            return ((axis * (res+1) + j) * (res+1) + i) * nSH;
+          }
+
+          void estimate_error () {
+            // compare against direct evaluation for SH delta functions along a
+            // set of orientations, over a dense set of directions:
+            const auto fibonacci = [] (size_t n, size_t N, ValueType offset) {
+              const ValueType z = 1.0 - (2.0*n + 1.0) / N;
+              const ValueType phi = (n + offset) * Math::pi * (3.0 - std::sqrt (5.0));
+              const ValueType r = std::sqrt (1.0 - z*z);
+              return Eigen::Matrix<ValueType,3,1> (r * std::cos (phi), r * std::sin (phi), z);
+            };
+            error = 0.0;
+            for (size_t n = 0; n < 20; ++n) {
+              const auto peak = fibonacci (n, 20, 0.5);
+              Eigen::Matrix<ValueType,Eigen::Dynamic,1> sh;
+              delta (sh, peak, lmax);
+              const ValueType peak_amplitude = Math::SH::value (sh, peak, lmax);
+              for (size_t k = 0; k < 2000; ++k) {
+                const auto dir = fibonacci (k, 2000, 0.0);
+                error = std::max (error, std::abs (value (sh, dir) - Math::SH::value (sh, dir, lmax)) / peak_amplitude);
+              }
+            }
+          }
+      };
+
+
+
+
+
 
       //! estimate direction & amplitude of SH peak
       /*! find a peak of an SH series using Gauss-Newton optimisation, modified
@@ -45,6 +45,14 @@ namespace MR
             }
       };
 
+      // stochastic cost functions may provide a new_sample() method, to draw
+      //   a new sample of data at the start of each iteration; this returns
+      //   true if a new sample has been drawn
+      template <class Function>
+        inline auto new_sample (Function& func, int) -> decltype (func.new_sample()) { return func.new_sample(); }
+      template <class Function>
+        inline bool new_sample (Function&, long) { return false; }
+
     }
 
     //! Computes the minimum of a function using a gradient descent approach.
@@ -162,6 +170,14 @@ namespace MR
             assert (std::isfinite (normg));
 
 
+            // the line search must compare costs evaluated over the same sample:
+            //   if a new sample is drawn for this iteration, re-evaluate the
+            //   cost at the current position using it
+            if (normg != 0.0 && new_sample (func, 0)) {
+              f = evaluate_func (x, g, verbose);
+              compute_normg_and_step_unscaled ();
+            }
+
             while (normg != 0.0) {
               if (!update_func (x2, x, g, dt))
                 return false;
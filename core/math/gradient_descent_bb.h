@@ -24,6 +24,7 @@
 #include <limits>
 #include <fstream>
 #include "math/check_gradient.h"
+#include "math/gradient_descent.h"
 
 namespace MR
 {
@@ -180,6 +181,8 @@ namespace MR
             if ((normg == 0.0) or !update_func (x3, x2, g2, dt))
               return false;
 
+            // a single evaluation per iteration, so the sample can be drawn directly
+            new_sample (func, 0);
             f = evaluate_func (x3, g3, verbose);
             x2.swap(x3);
             x1.swap(x3);
@@ -0,0 +1,100 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __math_lanczos_h__
+#define __math_lanczos_h__
+
+#include <Eigen/Dense>
+#include <Eigen/Eigenvalues>
+
+#include "types.h"
+
+namespace MR
+{
+  namespace Math
+  {
+
+    /** @addtogroup linalg
+      @{ */
+
+    //! Partial eigendecomposition of a self-adjoint matrix using the Lanczos algorithm
+    /*! Runs \a k iterations of the Lanczos algorithm, with full
+     * reorthogonalisation, to produce \a k Ritz values & vectors. The
+     * extreme Ritz values converge fastest to the extreme eigenvalues of
+     * the matrix; residuals() provides the norm of the residual
+     * \f$ \| A x_i - \theta_i x_i \| \f$ for each Ritz pair, which bounds
+     * the distance from each Ritz value to the nearest eigenvalue, and
+     * can be used to assess convergence.
+     *
+     * Only the lower triangle of the matrix is referenced. */
+    template <class MatrixType>
+      class Lanczos { MEMALIGN (Lanczos<MatrixType>)
+        public:
+          using value_type = typename MatrixType::Scalar;
+          using VectorType = Eigen::Matrix<value_type, Eigen::Dynamic, 1>;
+
+          //! run \a k iterations on matrix \a A, starting from unit vector \a v0
+          /*! returns false on breakdown, i.e. if an invariant subspace was
+           * found before \a k iterations, in which case the results are
+           * not valid. */
+          bool compute (const MatrixType& A, const VectorType& v0, ssize_t k)
+          {
+            assert (k > 1 && k <= A.rows());
+            V.resize (A.rows(), k);
+            Eigen::VectorXd alpha (k), beta (k);
+            V.col(0) = v0;
+            for (ssize_t j = 0; j < k; ++j) {
+              VectorType w = A.template selfadjointView<Eigen::Lower>() * V.col(j);
+              alpha[j] = std::real (V.col(j).dot (w));
+              // full reorthogonalisation, applied twice for numerical stability:
+              w -= V.leftCols (j+1) * (V.leftCols (j+1).adjoint() * w);
+              w -= V.leftCols (j+1) * (V.leftCols (j+1).adjoint() * w);
+              beta[j] = w.norm();
+              if (j+1 < k) {
+                if (beta[j] <= 1.0e-6 * std::abs (alpha[j]))
+                  return false;
+                V.col(j+1) = w / value_type (beta[j]);
+              }
+            }
+            eig.computeFromTridiagonal (alpha, beta.head (k-1));
+            residual = (beta[k-1] * eig.eigenvectors().row (k-1).transpose()).cwiseAbs();
+            return true;
+          }
+
+          //! the Ritz values, sorted in increasing order
+          const Eigen::VectorXd& eigenvalues () const { return eig.eigenvalues(); }
+
+          //! the residual norms for each Ritz pair, in the same order as the Ritz values
+          const Eigen::VectorXd& residuals () const { return residual; }
+
+          //! the Ritz vectors corresponding to the \a num largest Ritz values
+          MatrixType eigenvectors (ssize_t num) const {
+            return V * eig.eigenvectors().rightCols (num).template cast<value_type>();
+          }
+
+        protected:
+          MatrixType V;
+          Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig;
+          Eigen::VectorXd residual;
+      };
+
+    /** @} */
+
+  }
+}
+
+#endif
+
@@ -22,6 +22,8 @@
 #include <sys/time.h>
 #endif
 
+#include <array>
+#include <limits>
 #include <mutex>
 
 #include "mrtrix.h"
@@ -54,10 +56,18 @@ namespace MR
         static std::mt19937::result_type get_seed () {
           static std::mutex mutex;
           std::lock_guard<std::mutex> lock (mutex);
-          static std::mt19937::result_type current_seed = get_seed_private();
+          static std::mt19937::result_type current_seed = initial_seed();
           return current_seed++;
         }
 
+        //! the first seed issued by get_seed()
+        /*! this is the value of the MRTRIX_RNG_SEED environment variable if
+         * set, or a value drawn from std::random_device otherwise. */
+        static std::mt19937::result_type initial_seed () {
+          static const std::mt19937::result_type seed = get_seed_private();
+          return seed;
+        }
+
       private:
         static std::mt19937::result_type get_seed_private () {
           //ENVVAR name: MRTRIX_RNG_SEED
@@ -87,6 +97,88 @@ namespace MR
     };
 
 
+    //! counter-based random number generator
+    /*! this implements the Philox4x32-10 generator (Salmon et al., "Parallel
+     * random numbers: as easy as 1, 2, 3", SC'11). Each block of 4 outputs is
+     * a bijective function of a 64-bit key and a 128-bit counter, half of which
+     * identifies the stream and the other half the position within it. Any
+     * number of independent streams can therefore be obtained directly from
+     * (key, stream) pairs, without any state to be initialised or stored,
+     * which makes it straightforward to give each item of a parallel
+     * computation its own reproducible stream. It satisfies the requirements
+     * of a UniformRandomBitGenerator, and can be used with the standard C++11
+     * distributions. The default constructor keys the generator using
+     * RNG::get_seed(). */
+    class Philox { NOMEMALIGN
+      public:
+        using result_type = uint32_t;
+        static constexpr result_type min () { return 0; }
+        static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+        Philox () { seed (RNG::get_seed()); }
+        Philox (const uint64_t key, const uint64_t stream = 0) { seed (key, stream); }
+
+        //! set the key and stream, and rewind to the start of that stream
+        void seed (const uint64_t key, const uint64_t stream = 0) {
+          k[0] = uint32_t (key); k[1] = uint32_t (key >> 32);
+          c[0] = c[1] = 0;
+          c[2] = uint32_t (stream); c[3] = uint32_t (stream >> 32);
+          next = 4;
+        }
+
+        result_type operator() () {
+          if (next == 4) {
+            generate();
+            next = 0;
+          }
+          return out[next++];
+        }
+
+        void discard (unsigned long long z) {
+          if (z <= 4 - next) {
+            next += z;
+            return;
+          }
+          z -= 4 - next;
+          const uint64_t blocks = uint64_t (z / 4) + uint64_t (c[0]);
+          c[0] = uint32_t (blocks);
+          c[1] += uint32_t (blocks >> 32);
+          next = 4;
+          if (z % 4) {
+            generate();
+            next = z % 4;
+          }
+        }
+
+        //! the block of 4 outputs for a given key and counter
+        static std::array<uint32_t,4> block (const std::array<uint32_t,2>& key, const std::array<uint32_t,4>& counter) {
+          std::array<uint32_t,4> x (counter);
+          std::array<uint32_t,2> rk (key);
+          for (size_t round = 0; round != 10; ++round) {
+            const uint64_t p0 = uint64_t (0xD2511F53U) * x[0];
+            const uint64_t p1 = uint64_t (0xCD9E8D57U) * x[2];
+            x = {{ uint32_t (p1 >> 32) ^ x[1] ^ rk[0], uint32_t (p1),
+                   uint32_t (p0 >> 32) ^ x[3] ^ rk[1], uint32_t (p0) }};
+            rk[0] += 0x9E3779B9U;
+            rk[1] += 0xBB67AE85U;
+          }
+          return x;
+        }
+
+      private:
+        std::array<uint32_t,2> k;
+        std::array<uint32_t,4> c, out;
+        size_t next;
+
+        void generate () {
+          out = block (k, c);
+          if (!++c[0])
+            ++c[1];
+        }
+    };
+
+
+
     template <typename ValueType>
       class RNG::Uniform { NOMEMALIGN
         public:
@@ -553,6 +553,15 @@ namespace MR
 
 
 
+        void TestBase::operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const
+        {
+          output.resize (shuffling_matrices.size());
+          for (size_t i = 0; i != shuffling_matrices.size(); ++i)
+            (*this) (shuffling_matrices[i], output[i]);
+        }
+
+
+
 
 
 
@@ -626,38 +635,102 @@ namespace MR
             VAR (XtX[ih].cols());
             VAR (one_over_dof);
 #endif
-            const size_t dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
-            const default_type one_over_dof = 1.0 / default_type(dof);
             sse = (Rm*Sy).colwise().squaredNorm();
 #ifdef GLM_TEST_DEBUG
-            VAR (dof);
-            VAR (one_over_dof);
             VAR (sse.size());
 #endif
             for (size_t ie = 0; ie != num_elements(); ++ie) {
               beta.noalias() = c[ih].matrix() * lambdas.col (ie);
-              const default_type F = ((beta.transpose() * XtX[ih] * beta) (0,0) / c[ih].rank()) /
-                                     (one_over_dof * sse[ie]);
-              if (!std::isfinite (F)) {
-                stats  (ie, ih) = zstats (ie, ih) = value_type(0);
-              } else if (c[ih].is_F()) {
-                stats  (ie, ih) = F;
+              compute_statistic (ih, beta, sse[ie], stats (ie, ih), zstats (ie, ih));
+            }
+
+          }
+        }
+
+
+
+        void TestFixedHomoscedastic::operator() (const vector<matrix_type>& shuffling_matrices,
+                                                vector<matrix_type>& output) const
+        {
+          const size_t num_shuffles = shuffling_matrices.size();
+          output.resize (num_shuffles);
+          for (auto& zstats : output)
+            zstats.resize (num_elements(), num_hypotheses());
+          if (!num_shuffles)
+            return;
+
+          matrix_type A, projected, beta;
+          for (size_t ih = 0; ih != c.size(); ++ih) {
+            const ssize_t beta_rows = c[ih].matrix().rows();
+            const matrix_type c_pinvM (c[ih].matrix() * pinvM);
+
+            // Limit the number of shuffles processed in a single pass such that
+            //   the stacked projection matrix remains of modest size:
+            const size_t rows_per_shuffle = beta_rows + num_inputs();
+            const size_t max_shuffles = std::max (size_t(1), size_t(2097152) / (rows_per_shuffle * num_inputs()));
+
+            for (size_t first_shuffle = 0; first_shuffle < num_shuffles; first_shuffle += max_shuffles) {
+              const size_t pass_shuffles = std::min (max_shuffles, num_shuffles - first_shuffle);
+              const ssize_t residual_offset = pass_shuffles * beta_rows;
+
+              // For each shuffle, S * Rz * y gives the shuffled data (as above);
+              //   both the effect of interest and the model residuals are then
+              //   linear in y, so the matrices mapping y to these can be stacked
+              //   for all shuffles in the batch:
+              A.resize (pass_shuffles * rows_per_shuffle, num_inputs());
+              for (size_t is = 0; is != pass_shuffles; ++is) {
+                const matrix_type& S (shuffling_matrices[first_shuffle + is]);
+                assert (size_t(S.rows()) == num_inputs());
+                const matrix_type SRz (S * partitions[ih].Rz);
+                A.block (is * beta_rows, 0, beta_rows, num_inputs()).noalias() = c_pinvM * SRz;
+                A.block (residual_offset + is * num_inputs(), 0, num_inputs(), num_inputs()).noalias() = Rm * SRz;
+              }
+
+              // Process elements in blocks, such that the projected data for
+              //   each block remain resident in cache while statistics are computed:
+              const size_t block_size = std::max (size_t(16), size_t(262144) / (A.rows() * sizeof(default_type)));
+              for (size_t block_start = 0; block_start < num_elements(); block_start += block_size) {
+                const size_t block_elements = std::min (block_size, num_elements() - block_start);
+                projected.noalias() = A * y.middleCols (block_start, block_elements);
+                for (size_t is = 0; is != pass_shuffles; ++is) {
+                  matrix_type& zstats (output[first_shuffle + is]);
+                  for (size_t ie = 0; ie != block_elements; ++ie) {
+                    beta = projected.block (is * beta_rows, ie, beta_rows, 1);
+                    const default_type sse = projected.block (residual_offset + is * num_inputs(), ie, num_inputs(), 1).squaredNorm();
+                    value_type stat;
+                    compute_statistic (ih, beta, sse, stat, zstats (block_start + ie, ih));
+                  }
+                }
+              }
+            }
+          }
+        }
+
+
+
+        void TestFixedHomoscedastic::compute_statistic (const size_t ih, const matrix_type& beta, const default_type sse,
+                                                        value_type& stat, value_type& zstat) const
+        {
+          const size_t dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
+          const default_type F = ((beta.transpose() * XtX[ih] * beta) (0,0) / c[ih].rank()) /
+                                 (one_over_dof[ih] * sse);
+          if (!std::isfinite (F)) {
+            stat = zstat = value_type(0);
+          } else if (c[ih].is_F()) {
+            stat = F;
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->F2z (F, c[ih].rank(), dof);
+            zstat = stat2z->F2z (F, c[ih].rank(), dof);
 #else
-                zstats (ie, ih) = Math::F2z (F, c[ih].rank(), dof);
+            zstat = Math::F2z (F, c[ih].rank(), dof);
 #endif
-              } else {
-                assert (beta.rows() == 1);
-                stats  (ie, ih) = std::sqrt (F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
+          } else {
+            assert (beta.rows() == 1);
+            stat = std::sqrt (F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->t2z (stats (ie, ih), dof);
+            zstat = stat2z->t2z (stat, dof);
 #else
-                zstats (ie, ih) = Math::t2z (stats (ie, ih), dof);
+            zstat = Math::t2z (stat, dof);
 #endif
-              }
-            }
-
           }
         }
 
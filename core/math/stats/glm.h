@@ -242,6 +242,15 @@ namespace MR
              */
             virtual void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const = 0;
 
+            /*! Compute Z-statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals
+             * @param output the matrices containing the output Z-statistics (one per shuffling matrix)
+             *
+             * By default, each shuffle is processed in turn; derived classes may
+             *   override this to process all shuffles in a single pass over the data.
+             */
+            virtual void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const;
+
 
             size_t num_inputs () const { return M.rows(); }
             size_t num_elements () const { return y.cols(); }
@@ -289,6 +298,17 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            /*! Compute the Z-statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals
+             * @param output the matrices containing the output Z-statistics (one per shuffling matrix)
+             *
+             * The matrices mapping the input data to the effects of interest and to the
+             *   model residuals are stacked across all shuffles, such that these can be
+             *   computed using a single matrix product per block of elements; the
+             *   measurement data are therefore only traversed once for the entire batch.
+             */
+            void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const override;
+
           protected:
             // New classes to store information relevant to Freedman-Lane implementation
             vector<Hypothesis::Partition> partitions;
@@ -297,6 +317,9 @@ namespace MR
             vector<matrix_type> XtX;
             vector<default_type> one_over_dof;
 
+            void compute_statistic (const size_t hypothesis, const matrix_type& beta, const default_type sse,
+                                    value_type& stat, value_type& zstat) const;
+
         };
         //! @}
 
@@ -335,6 +358,12 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            // Batched evaluation inherited from TestFixedHomoscedastic does not
+            //   apply to the G-statistic; shuffles are processed individually
+            void operator() (const vector<matrix_type>& shuffling_matrices, vector<matrix_type>& output) const override {
+              TestBase::operator() (shuffling_matrices, output);
+            }
+
           protected:
             // Variance group assignments
             const index_array_type& VG;
@@ -89,6 +89,26 @@ namespace MR
     }
 
 
+    bool queue_is_lock_free ()
+    {
+      //CONF option: ThreadQueueLockFree
+      //CONF default: 0 (false)
+      //CONF A boolean value to indicate whether the queues used to pass
+      //CONF items between threads in multi-threaded pipelines (e.g. in
+      //CONF tckgen, tckmap, tcksample) should use a lock-free ring buffer
+      //CONF rather than a mutex-protected buffer. This can reduce contention
+      //CONF when many threads exchange large numbers of small items. The
+      //CONF default can be changed at compile-time by defining the
+      //CONF MRTRIX_QUEUE_LOCKFREE macro.
+#ifdef MRTRIX_QUEUE_LOCKFREE
+      static const bool value = File::Config::get_bool ("ThreadQueueLockFree", true);
+#else
+      static const bool value = File::Config::get_bool ("ThreadQueueLockFree", false);
+#endif
+      return value;
+    }
+
+
 
 
 
@@ -18,6 +18,7 @@
 #define __mrtrix_thread_queue_h__
 
 #include <stack>
+#include <atomic>
 #include <condition_variable>
 
 #include "exception.h"
@@ -26,6 +27,7 @@
 
 #define MRTRIX_QUEUE_DEFAULT_CAPACITY 128
 #define MRTRIX_QUEUE_DEFAULT_BATCH_SIZE 128
+#define MRTRIX_QUEUE_SPIN_COUNT 64
 
 namespace MR
 {
@@ -64,6 +66,96 @@ namespace MR
         };
 
 
+
+
+
+      // bounded multi-producer multi-consumer lock-free ring buffer of
+      // pointers, following the design by Dmitry Vyukov: each cell carries a
+      // sequence number indicating whether it is ready to be written to or
+      // read from for the current lap around the buffer.
+      template <class T>
+        class __RingBuffer { NOMEMALIGN
+          public:
+            __RingBuffer (size_t min_capacity) :
+              mask (round_up (min_capacity) - 1),
+              cells (new Cell [mask+1]),
+              enqueue_pos (0),
+              dequeue_pos (0) {
+                for (size_t n = 0; n <= mask; ++n)
+                  cells[n].sequence.store (n, std::memory_order_relaxed);
+              }
+
+            FORCE_INLINE bool push (T* item) {
+              Cell* cell;
+              size_t pos = enqueue_pos.load (std::memory_order_relaxed);
+              while (true) {
+                cell = &cells[pos & mask];
+                const ssize_t diff = ssize_t (cell->sequence.load (std::memory_order_acquire)) - ssize_t (pos);
+                if (diff == 0) {
+                  if (enqueue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed))
+                    break;
+                }
+                else if (diff < 0)
+                  return false;
+                else
+                  pos = enqueue_pos.load (std::memory_order_relaxed);
+              }
+              cell->data = item;
+              cell->sequence.store (pos+1, std::memory_order_release);
+              return true;
+            }
+
+            FORCE_INLINE bool pop (T*& item) {
+              Cell* cell;
+              size_t pos = dequeue_pos.load (std::memory_order_relaxed);
+              while (true) {
+                cell = &cells[pos & mask];
+                const ssize_t diff = ssize_t (cell->sequence.load (std::memory_order_acquire)) - ssize_t (pos+1);
+                if (diff == 0) {
+                  if (dequeue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed))
+                    break;
+                }
+                else if (diff < 0)
+                  return false;
+                else
+                  pos = dequeue_pos.load (std::memory_order_relaxed);
+              }
+              item = cell->data;
+              cell->sequence.store (pos+mask+1, std::memory_order_release);
+              return true;
+            }
+
+            // these are only approximate while other threads are active:
+            FORCE_INLINE size_t size () const {
+              const size_t first = dequeue_pos.load();
+              return enqueue_pos.load() - first;
+            }
+            FORCE_INLINE bool empty () const { return !size(); }
+            FORCE_INLINE bool full () const { return size() > mask; }
+
+          private:
+            class Cell { NOMEMALIGN
+              public:
+                std::atomic<size_t> sequence;
+                T* data;
+            };
+
+            const size_t mask;
+            std::unique_ptr<Cell[]> cells;
+            // keep producer & consumer positions on separate cache lines:
+            char pad0[64];
+            std::atomic<size_t> enqueue_pos;
+            char pad1[64];
+            std::atomic<size_t> dequeue_pos;
+            char pad2[64];
+
+            static size_t round_up (size_t n) {
+              size_t p = 2;
+              while (p < n) p <<= 1;
+              return p;
+            }
+        };
+
     }
 
     //! \endcond
@@ -71,6 +163,15 @@ namespace MR
 
 
 
+    //! whether Thread::Queue should use its lock-free backend by default
+    /*! This is determined by the ThreadQueueLockFree entry in the MRtrix
+     * configuration file, or if not set, by whether MRtrix3 was compiled with
+     * the MRTRIX_QUEUE_LOCKFREE macro defined. */
+    bool queue_is_lock_free ();
+
+
+
+
     /** \addtogroup thread_classes
      * @{ */
 
@@ -340,14 +441,23 @@ namespace MR
           * queue already contains this number of items, the thread will block until
           * at least one item has been popped.  By default, the buffer size is
           * MRTRIX_QUEUE_DEFAULT_CAPACITY items.
+          * \param lock_free whether to use the lock-free ring buffer backend
+          * rather than the default mutex-protected buffer. In the former case,
+          * the capacity is rounded up to the next power of two. Threads only
+          * fall back to waiting on a condition variable if the queue remains
+          * full (or empty) after MRTRIX_QUEUE_SPIN_COUNT attempts.
           */
-         Queue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
+         Queue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY, bool lock_free = queue_is_lock_free()) :
            buffer (new T* [buffer_size]),
            front (buffer),
            back (buffer),
            capacity (buffer_size),
            writer_count (0),
            reader_count (0),
+           data_waiters (0),
+           space_waiters (0),
+           ring (lock_free ? new __RingBuffer<T> (buffer_size+1) : nullptr),
+           spare (lock_free ? new __RingBuffer<T> (2*buffer_size+2) : nullptr),
            name (description) {
              assert (capacity > 0);
            }
@@ -517,7 +627,8 @@ namespace MR
            std::lock_guard<std::mutex> lock (mutex);
            std::cerr << "Thread::Queue \"" + name + "\": "
              << writer_count << " writer" << (writer_count > 1 ? "s" : "") << ", "
-             << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size() << "\n";
+             << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size()
+             << ( ring ? " (lock-free)" : "" ) << "\n";
          }
 
 
@@ -528,7 +639,9 @@ namespace MR
          T** front;
          T** back;
          size_t capacity;
-         size_t writer_count, reader_count;
+         std::atomic<size_t> writer_count, reader_count;
+         std::atomic<size_t> data_waiters, space_waiters;
+         std::unique_ptr<__RingBuffer<T>> ring, spare;
          std::stack<T*,vector<T*> > item_stack;
          vector<std::unique_ptr<T>> items;
          std::string name;
@@ -567,6 +680,8 @@ namespace MR
            return (inc (back) == front);
          }
          FORCE_INLINE size_t size () const {
+           if (ring)
+             return ring->size();
            return ( (back < front ? back+capacity : back) - front);
          }
 
@@ -578,6 +693,8 @@ namespace MR
          }
 
          FORCE_INLINE bool push (T*& item) {
+           if (ring)
+             return push_lock_free (item);
            std::unique_lock<std::mutex> lock (mutex);
            more_space.wait (lock, [this]{ return !(full() && reader_count); });
            if (!reader_count) return false;
@@ -596,6 +713,8 @@ namespace MR
          }
 
          FORCE_INLINE bool pop (T*& item) {
+           if (ring)
+             return pop_lock_free (item);
            std::unique_lock<std::mutex> lock (mutex);
            if (item)
              item_stack.push (item);
@@ -610,9 +729,88 @@ namespace MR
          }
 
          FORCE_INLINE void recycle (T*& item) {
+           if (!item)
+             return;
+           if (spare && spare->push (item))
+             return;
            std::unique_lock<std::mutex> lock (mutex);
-           if (item)
-             item_stack.push (item);
+           item_stack.push (item);
+         }
+
+
+
+         // lock-free backend: items are exchanged through the ring buffer,
+         // and processed items are recycled through the spare ring buffer
+         // (falling back to the mutex-protected stack if that is full). The
+         // mutex & condition variables are only used to put threads to sleep
+         // when the queue remains full or empty, or to wake them up if any
+         // are known to be waiting.
+
+         FORCE_INLINE bool push_lock_free (T*& item) {
+           size_t attempts = 0;
+           while (true) {
+             if (!reader_count)
+               return false;
+             if (ring->push (item))
+               break;
+             if (++attempts < MRTRIX_QUEUE_SPIN_COUNT) {
+               std::this_thread::yield();
+               continue;
+             }
+             std::unique_lock<std::mutex> lock (mutex);
+             ++space_waiters;
+             more_space.wait (lock, [this]{ return !(ring->full() && reader_count); });
+             --space_waiters;
+           }
+
+           std::atomic_thread_fence (std::memory_order_seq_cst);
+           if (data_waiters) {
+             std::lock_guard<std::mutex> lock (mutex);
+             more_data.notify_one();
+           }
+
+           if (!spare->pop (item)) {
+             std::lock_guard<std::mutex> lock (mutex);
+             if (item_stack.empty()) {
+               item = new T;
+               items.push_back (std::unique_ptr<T> (item));
+             }
+             else {
+               item = item_stack.top();
+               item_stack.pop();
+             }
+           }
+           return true;
+         }
+
+         FORCE_INLINE bool pop_lock_free (T*& item) {
+           recycle (item);
+           item = nullptr;
+           size_t attempts = 0;
+           while (true) {
+             // any item pushed before the last writer unregistered must be
+             // visible once writer_count is seen to be zero:
+             const bool writers_active = writer_count;
+             if (ring->pop (item))
+               break;
+             if (!writers_active)
+               return false;
+             if (++attempts < MRTRIX_QUEUE_SPIN_COUNT) {
+               std::this_thread::yield();
+               continue;
+             }
+             std::unique_lock<std::mutex> lock (mutex);
+             ++data_waiters;
+             more_data.wait (lock, [this]{ return !(ring->empty() && writer_count); });
+             --data_waiters;
+           }
+
+           std::atomic_thread_fence (std::memory_order_seq_cst);
+           if (space_waiters) {
+             std::lock_guard<std::mutex> lock (mutex);
+             more_space.notify_one();
+           }
+           return true;
          }
 
          FORCE_INLINE T** inc (T** p) const {
@@ -863,6 +1061,33 @@ namespace MR
 
 
 
+     //! a Source functor that yields each of the indices 0 to \a number-1 in turn
+     /*! This can be used with Thread::run_queue() to distribute the
+      * processing of a fixed number of elements across threads:
+      * \code
+      * Thread::run_queue (Thread::IndexSource (num_elements), Thread::batch (size_t()), Thread::multi (sink));
+      * \endcode
+      * \sa Thread::run_queue() */
+     class IndexSource { NOMEMALIGN
+       public:
+         IndexSource (const size_t number) :
+             number (number),
+             counter (0) { }
+         bool operator() (size_t& index)
+         {
+           if ((index = counter) == number)
+             return false;
+           ++counter;
+           return true;
+         }
+       private:
+         const size_t number;
+         size_t counter;
+     };
+
+
+
+
 
 
      //! convenience function to set up and run a 2-stage multi-threaded pipeline.
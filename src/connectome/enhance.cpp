@@ -71,6 +71,15 @@ namespace MR {
 
 
 
+      bool NBS::integrate (in_column_type in, const value_type dh, const value_type e, const value_type h, out_column_type out) const
+      {
+        Stats::TFCE::ClusterSizeIntegrator integrator ([] (const value_type value, const value_type T) { return std::isfinite (value) && value >= T; });
+        integrator (*adjacency, in, dh, e, h, out);
+        return true;
+      }
+
+
+
       void NBS::initialise (const node_t num_nodes)
       {
         const Mat2Vec mat2vec (num_nodes);
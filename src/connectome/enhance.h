@@ -70,6 +70,8 @@ namespace MR {
 
           void operator() (in_column_type, const value_type, out_column_type) const override;
 
+          bool integrate (in_column_type, const value_type, const value_type, const value_type, out_column_type) const override;
+
         protected:
           std::shared_ptr< vector< vector<size_t> > > adjacency;
           value_type threshold;
@@ -65,14 +65,17 @@ namespace MR
         public:
           template <class Set>
           Model (Set& dwi, const DWI::Directions::FastLookupSet& dirs) :
-              ModelBase<Fixel> (dwi, dirs)
+              ModelBase<Fixel> (dwi, dirs),
+              out_of_core (false)
           {
             Track_fixel_contribution::set_scaling (dwi);
           }
           Model (const Model& that) = delete;
 
-          virtual ~Model ();
 
+          // Store streamline contributions in memory-mapped scratch files rather than RAM;
+          //   must be set before map_streamlines() is called
+          void set_out_of_core (const bool i) { out_of_core = i; }
 
           // Over-rides the function defined in ModelBase; need to build contributions member also
           void map_streamlines (const std::string&);
@@ -92,7 +95,8 @@ namespace MR
 
         protected:
           std::string tck_file_path;
-          vector<TrackContribution*> contributions;
+          TrackContributionStore contributions;
+          bool out_of_core;
 
           using Fixel_map<Fixel>::accessor;
           using Fixel_map<Fixel>::begin;
@@ -155,20 +159,6 @@ namespace MR
 
 
 
-      template <class Fixel>
-      Model<Fixel>::~Model ()
-      {
-        for (vector<TrackContribution*>::iterator i = contributions.begin(); i != contributions.end(); ++i) {
-          if (*i) {
-            delete *i;
-            *i = nullptr;
-          }
-        }
-      }
-
-
-
-
       template <class Fixel>
       void Model<Fixel>::map_streamlines (const std::string& path)
       {
@@ -179,7 +169,7 @@ namespace MR
         if (!count)
           throw Exception ("Cannot map streamlines: track file " + Path::basename(path) + " is empty");
 
-        contributions.assign (count, nullptr);
+        contributions.init (count, out_of_core);
 
         {
           Mapping::TrackLoader loader (file, count);
@@ -203,6 +193,7 @@ namespace MR
 
         tck_file_path = path;
 
+        INFO ("Streamline-fixel contributions occupy " + str (contributions.bytes() / (1024*1024)) + " MB");
         INFO ("Proportionality coefficient after streamline mapping is " + str (mu()));
       }
 
@@ -285,9 +276,9 @@ namespace MR
         VAR (sum_from_fixels);
         VAR (sum_from_fixels_weighted);
         double sum_from_tracks = 0.0;
-        for (vector<TrackContribution*>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
-          if (*i)
-            sum_from_tracks += (*i)->get_total_contribution();
+        for (track_t i = 0; i != contributions.size(); ++i) {
+          if (contributions[i])
+            sum_from_tracks += contributions[i]->get_total_contribution();
         }
         VAR (sum_from_tracks);
       }
@@ -380,7 +371,7 @@ namespace MR
             }
           }
 
-          master.contributions[in.get_index()] = new TrackContribution (masked_contributions, total_contribution, total_length);
+          master.contributions.set (in.get_index(), masked_contributions, total_contribution, total_length);
 
           TD_sum += total_contribution;
           for (vector<Track_fixel_contribution>::const_iterator i = masked_contributions.begin(); i != masked_contributions.end(); ++i) {
@@ -405,7 +396,7 @@ namespace MR
       {
         for (track_t track_index = in.first; track_index != in.second; ++track_index) {
           if (master.contributions[track_index]) {
-            TrackContribution& this_cont (*master.contributions[track_index]);
+            const TrackContribution& this_cont (*master.contributions[track_index]);
             vector<Track_fixel_contribution> new_cont;
             double total_contribution = 0.0;
             for (size_t i = 0; i != this_cont.dim(); ++i) {
@@ -415,9 +406,7 @@ namespace MR
                 total_contribution += this_cont[i].get_length() * master[new_index].get_weight();
               }
             }
-            TrackContribution* new_contribution = new TrackContribution (new_cont, total_contribution, this_cont.get_total_length());
-            delete master.contributions[track_index];
-            master.contributions[track_index] = new_contribution;
+            master.contributions.replace (track_index, new_cont, total_contribution);
           }
         }
         return true;
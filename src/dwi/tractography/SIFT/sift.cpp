@@ -43,7 +43,12 @@ const OptionGroup SIFTModelOption = OptionGroup ("Options affecting the SIFT mod
 
   + Option ("fd_thresh", "fibre density threshold; exclude an FOD lobe from filtering processing if its integral is less than this amount "
                          "(streamlines will still be mapped to it, but it will not contribute to the cost function or the filtering)")
-    + Argument ("value").type_float (0.0, 2.0 * Math::pi);
+    + Argument ("value").type_float (0.0, 2.0 * Math::pi)
+
+  + Option ("out_of_core", "store the contributions of streamlines to FOD lobes in memory-mapped scratch files "
+                           "(in the location specified by the TmpFileDir configuration file option) rather than in RAM; "
+                           "the operating system can then page this data out to disk when memory is short, at the expense of additional disk I/O. "
+                           "Note that this only applies to the streamline contributions; all other data remain in RAM");
 
 
 
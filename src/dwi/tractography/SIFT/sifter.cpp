@@ -171,8 +171,7 @@ namespace MR
 
               // Remove this streamline, and adjust all of the relevant quantities
               noncontributing_length_removed += contributions[to_remove]->get_total_length();
-              delete contributions[to_remove];
-              contributions[to_remove] = nullptr;
+              contributions.remove (to_remove);
               ++removed_this_iteration;
               --tracks_remaining;
 
@@ -232,8 +231,7 @@ namespace MR
                 }
                 TD_sum -= candidate_contribution.get_total_contribution();
                 contributing_length_removed += candidate_contribution.get_total_length();
-                delete contributions[candidate_index];
-                contributions[candidate_index] = nullptr;
+                contributions.remove (candidate_index);
                 ++removed_this_iteration;
                 --tracks_remaining;
 
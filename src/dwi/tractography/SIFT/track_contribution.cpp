@@ -16,6 +16,8 @@
 
 #include "dwi/tractography/SIFT/track_contribution.h"
 
+#include "file/utils.h"
+
 namespace MR
 {
   namespace DWI
@@ -31,6 +33,99 @@ namespace MR
         float Track_fixel_contribution::min_length_for_storage = 0.0;
 
 
+
+        // Number of contributions in each block of storage (64MB)
+        constexpr size_t contributions_per_block = 1 << 24;
+
+
+
+        TrackContributionStore::Block::Block (const size_t size, const bool use_scratch_file) :
+            data (nullptr),
+            size (size)
+        {
+          if (use_scratch_file) {
+            path = File::create_tempfile (size * sizeof (Track_fixel_contribution), "sift");
+            mmap.reset (new File::MMap (path, true, false));
+            data = reinterpret_cast<Track_fixel_contribution*> (mmap->address());
+          } else {
+            buffer.reset (new char [size * sizeof (Track_fixel_contribution)]);
+            data = reinterpret_cast<Track_fixel_contribution*> (buffer.get());
+          }
+        }
+
+        TrackContributionStore::Block::~Block()
+        {
+          if (mmap) {
+            mmap.reset();
+            File::remove (path);
+          }
+        }
+
+
+
+        void TrackContributionStore::init (const track_t num_tracks, const bool use_scratch_files)
+        {
+          tracks.assign (num_tracks, TrackContribution());
+          blocks.clear();
+          out_of_core = use_scratch_files;
+          block_remaining = 0;
+          block_next = nullptr;
+        }
+
+
+
+        void TrackContributionStore::set (const track_t index, const vector<Track_fixel_contribution>& data, const float total_contribution, const float total_length)
+        {
+          assert (index < tracks.size());
+          assert (tracks[index].count == TrackContribution::absent);
+          TrackContribution& track (tracks[index]);
+          track.data = allocate (data.size());
+          std::copy (data.begin(), data.end(), track.data);
+          track.total_contribution = total_contribution;
+          track.total_length = total_length;
+          track.count = data.size();
+        }
+
+
+
+        void TrackContributionStore::replace (const track_t index, const vector<Track_fixel_contribution>& data, const float total_contribution)
+        {
+          TrackContribution& track (tracks[index]);
+          assert (track.count != TrackContribution::absent);
+          assert (data.size() <= track.count);
+          std::copy (data.begin(), data.end(), track.data);
+          track.total_contribution = total_contribution;
+          track.count = data.size();
+        }
+
+
+
+        size_t TrackContributionStore::bytes() const
+        {
+          size_t result = tracks.size() * sizeof (TrackContribution);
+          for (const auto& block : blocks)
+            result += block->size * sizeof (Track_fixel_contribution);
+          return result - block_remaining * sizeof (Track_fixel_contribution);
+        }
+
+
+
+        Track_fixel_contribution* TrackContributionStore::allocate (const size_t count)
+        {
+          std::lock_guard<std::mutex> lock (mutex);
+          if (count > block_remaining) {
+            blocks.emplace_back (new Block (std::max (count, contributions_per_block), out_of_core));
+            block_next = blocks.back()->data;
+            block_remaining = blocks.back()->size;
+          }
+          Track_fixel_contribution* const result = block_next;
+          block_next += count;
+          block_remaining -= count;
+          return result;
+        }
+
+
+
       }
     }
   }
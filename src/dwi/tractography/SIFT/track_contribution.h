@@ -21,10 +21,12 @@
 #include <cstdint>
 
 #include "header.h"
-#include "min_mem_array.h"
+#include "file/mmap.h"
 
 #include "math/math.h"
 
+#include "dwi/tractography/SIFT/types.h"
+
 
 namespace MR
 {
@@ -128,28 +130,119 @@ class Track_fixel_contribution
 
 
 
-      class TrackContribution : public Min_mem_array<Track_fixel_contribution>
+      class TrackContributionStore;
+
+
+
+      //! The contributions of a single streamline to the fixels it traverses
+      /*! This is a lightweight view of data held within a
+       * TrackContributionStore, which owns the underlying storage. */
+      class TrackContribution
       { MEMALIGN(TrackContribution)
 
         public:
-        TrackContribution (const vector<Track_fixel_contribution>& in, const float c, const float l) :
-            Min_mem_array<Track_fixel_contribution> (in),
-            total_contribution (c),
-            total_length       (l) { }
-
         TrackContribution () :
-            Min_mem_array<Track_fixel_contribution> (),
+            data (nullptr),
+            count (absent),
             total_contribution (0.0),
             total_length       (0.0) { }
 
-        ~TrackContribution() { }
+        size_t dim() const { return count; }
+
+        const Track_fixel_contribution& operator[] (const size_t index) const { assert (index < count); return data[index]; }
 
         float get_total_contribution() const { return total_contribution; }
         float get_total_length      () const { return total_length; }
 
         private:
-          const float total_contribution, total_length;
+          Track_fixel_contribution* data;
+          uint32_t count;
+          float total_contribution, total_length;
+
+          static constexpr uint32_t absent = std::numeric_limits<uint32_t>::max();
+
+          friend class TrackContributionStore;
+      };
+
+
 
+
+      //! Storage for the fixel contributions of all streamlines
+      /*! Rather than allocating memory separately for each streamline, the
+       * contributions of all streamlines are packed contiguously into a small
+       * number of large blocks, with a fixed-size header per streamline
+       * recording the location & number of its contributions. Optionally,
+       * these blocks can be backed by memory-mapped scratch files rather than
+       * RAM, such that the operating system can page the data out to disk as
+       * required. Note that only the streamline contributions are held in
+       * these files: the fixel data & per-streamline headers remain in RAM,
+       * and pages of the scratch files count towards the resident memory of
+       * the process until the operating system evicts them. Without scratch
+       * files, the memory used is the same as before other than the reduced
+       * allocator overhead. */
+      class TrackContributionStore
+      { MEMALIGN(TrackContributionStore)
+
+        public:
+          TrackContributionStore () :
+              out_of_core (false),
+              block_remaining (0),
+              block_next (nullptr) { }
+          TrackContributionStore (const TrackContributionStore&) = delete;
+
+          // Discard any existing data, and prepare for storing the contributions
+          //   of the specified number of streamlines, none of which are yet present
+          void init (const track_t num_tracks, const bool use_scratch_files);
+
+          track_t size() const { return tracks.size(); }
+          void resize (const track_t num_tracks) { tracks.resize (num_tracks); }
+
+          // Returns nullptr if no contribution is present for this streamline
+          //   (either not yet mapped, or subsequently removed)
+          const TrackContribution* operator[] (const track_t index) const {
+            assert (index < tracks.size());
+            return tracks[index].count == TrackContribution::absent ? nullptr : &tracks[index];
+          }
+          const TrackContribution* back() const { return (*this)[tracks.size()-1]; }
+
+          // Store the contributions for a streamline; this can be called concurrently
+          //   from multiple threads, provided that each operates on different streamlines
+          void set (const track_t index, const vector<Track_fixel_contribution>& data, const float total_contribution, const float total_length);
+
+          // Replace the contributions of a streamline with a subset of its existing
+          //   contributions, re-using the existing storage
+          void replace (const track_t index, const vector<Track_fixel_contribution>& data, const float total_contribution);
+
+          // Flag a streamline as no longer being present; note that the associated
+          //   storage is not reclaimed
+          void remove (const track_t index) { tracks[index].count = TrackContribution::absent; }
+
+          // Total amount of memory (RAM or scratch file) used, in bytes
+          size_t bytes() const;
+
+        private:
+          class Block
+          { MEMALIGN(Block)
+            public:
+              Block (const size_t size, const bool use_scratch_file);
+              ~Block();
+              Track_fixel_contribution* data;
+              const size_t size;
+            private:
+              // raw storage, so that memory is only committed as it is written to
+              std::unique_ptr<char[]> buffer;
+              std::unique_ptr<File::MMap> mmap;
+              std::string path;
+          };
+
+          vector<TrackContribution> tracks;
+          vector<std::unique_ptr<Block>> blocks;
+          bool out_of_core;
+          std::mutex mutex;
+          size_t block_remaining;
+          Track_fixel_contribution* block_next;
+
+          Track_fixel_contribution* allocate (const size_t count);
       };
 
 
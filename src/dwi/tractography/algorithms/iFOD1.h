@@ -85,6 +85,7 @@ namespace MR
           properties.set (precomputed, "sh_precomputed");
           if (precomputed)
             precomputer.init (lmax);
+          init_sh_lookup (lookup, lmax);
 
         }
 
@@ -113,6 +114,7 @@ namespace MR
         size_t lmax, max_trials;
         float sin_max_angle_1o, fod_power;
         Math::SH::PrecomputedAL<float> precomputer;
+        Math::SH::PrecomputedBasis<float> lookup;
 
         private:
         mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -245,7 +247,9 @@ namespace MR
 
       float FOD (const Eigen::Vector3f& d) const
       {
-        return (S.precomputer ?
+        return (S.lookup ?
+            S.lookup.value (values, d) :
+            S.precomputer ?
             S.precomputer.value (values, d) :
             Math::SH::value (values, d, S.lmax)
         );
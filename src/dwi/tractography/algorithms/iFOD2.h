@@ -83,6 +83,7 @@ namespace MR
                   properties.set (precomputed, "sh_precomputed");
                   if (precomputed)
                     precomputer.init (lmax);
+                  init_sh_lookup (lookup, lmax);
 
                   // num_samples is number of samples excluding first point
                   --num_samples;
@@ -132,6 +133,7 @@ namespace MR
                 size_t lmax, num_samples, max_trials;
                 float sin_max_angle_ho, fod_power;
                 Math::SH::PrecomputedAL<float> precomputer;
+                Math::SH::PrecomputedBasis<float> lookup;
 
               private:
                 mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -161,6 +163,7 @@ namespace MR
               sample_idx (S.num_samples)
           {
             calibrate (*this);
+            init_batch();
           }
 
             iFOD2 (const iFOD2& that) :
@@ -179,6 +182,7 @@ namespace MR
               calib_tangents (S.num_samples),
               sample_idx (S.num_samples)
           {
+            init_batch();
           }
 
 
@@ -240,10 +244,25 @@ namespace MR
 
               Eigen::Vector3f next_pos, next_dir;
 
-              float max_val = 0.0;
+              // Gather the samples of all calibration paths, and evaluate the FOD
+              //   amplitudes for all of them in a single batch:
+              size_t num_paths = 0;
               for (size_t i = 0; i < calibrate_list.size(); ++i) {
                 get_path (calib_positions, calib_tangents, rotate_direction (dir, calibrate_list[i]));
-                float val = path_prob (calib_positions, calib_tangents);
+                if (S.is_act()) {
+                  const float act_prob = act_path_prob (calib_positions);
+                  if (std::isnan (act_prob))
+                    return EXIT_IMAGE;
+                  if (!act_prob)
+                    continue;
+                }
+                fetch_path (calib_positions, calib_tangents, num_paths++);
+              }
+              evaluate_batch (num_paths);
+
+              float max_val = 0.0;
+              for (size_t i = 0; i < num_paths; ++i) {
+                float val = path_prob (i);
                 if (std::isnan (val))
                   return EXIT_IMAGE;
                 else if (val > max_val)
@@ -351,23 +370,24 @@ namespace MR
             //   in the arc - more dense structural image sampling
             size_t sample_idx;
 
+            // Interpolated SH coefficients (one row per sample) & sample tangents for a
+            //   batch of paths, along with the resulting FOD amplitudes
+            Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> batch_coefs;
+            Eigen::Matrix<float, Eigen::Dynamic, 3> batch_tangents;
+            Eigen::VectorXf batch_amplitudes;
+
 
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& direction) const
             {
-              return (S.precomputer ?
+              return (S.lookup ?
+                  S.lookup.value (values, direction) :
+                  S.precomputer ?
                   S.precomputer.value (values, direction) :
                   Math::SH::value (values, direction, S.lmax)
                   );
             }
 
-            FORCE_INLINE float FOD (const Eigen::Vector3f& position, const Eigen::Vector3f& direction)
-            {
-              if (!get_data (source, position))
-                return NaN;
-              return FOD (direction);
-            }
-
 
 
 
@@ -384,16 +404,82 @@ namespace MR
 
               // Early exit for ACT when path is not sensible
               if (S.is_act()) {
-                if (!act().fetch_tissue_data (positions[S.num_samples - 1]))
-                  return (NaN);
-                if (act().tissues().get_csf() >= 0.5)
-                  return 0.0;
+                const float act_prob = act_path_prob (positions);
+                if (!(act_prob > 0.0))
+                  return act_prob;
+              }
+
+              fetch_path (positions, tangents, 0);
+              evaluate_batch (1);
+              return path_prob (0);
+            }
+
+
+
+            // Returns NaN if the end of the path lies outside the ACT image, 0.0 if it
+            //   enters CSF, and 1.0 otherwise
+            FORCE_INLINE float act_path_prob (const vector<Eigen::Vector3f>& positions)
+            {
+              if (!act().fetch_tissue_data (positions[S.num_samples - 1]))
+                return NaN;
+              if (act().tissues().get_csf() >= 0.5)
+                return 0.0;
+              return 1.0;
+            }
+
+
+
+            void init_batch ()
+            {
+              const size_t max_samples = std::max (calibrate_list.size(), size_t(1)) * S.num_samples;
+              batch_coefs.resize (max_samples, source.size(3));
+              batch_tangents.resize (max_samples, 3);
+              batch_amplitudes.resize (max_samples);
+            }
+
+
+
+            // Interpolate the SH coefficients at each sample of the path into the
+            //   rows of the batch corresponding to the path at index path_index.
+            //   Samples outside the image / mask yield NaN coefficients, and hence
+            //   NaN amplitudes.
+            void fetch_path (const vector<Eigen::Vector3f>& positions, const vector<Eigen::Vector3f>& tangents, size_t path_index)
+            {
+              const size_t offset = path_index * S.num_samples;
+              for (size_t i = 0; i < S.num_samples; ++i) {
+                if (source.scanner (positions[i]))
+                  source.cached_row (values, 3);
+                else
+                  values.setConstant (NaN);
+                batch_coefs.row (offset+i) = values.transpose();
+                batch_tangents.row (offset+i) = tangents[i].transpose();
               }
+            }
+
+
+
+            FORCE_INLINE void evaluate_batch (size_t num_paths)
+            {
+              const size_t num = num_paths * S.num_samples;
+              if (S.lookup)
+                S.lookup.values (batch_amplitudes, batch_coefs.topRows (num), batch_tangents.topRows (num));
+              else if (S.precomputer)
+                S.precomputer.values (batch_amplitudes, batch_coefs.topRows (num), batch_tangents.topRows (num));
+              else
+                Math::SH::values (batch_amplitudes, batch_coefs.topRows (num), batch_tangents.topRows (num), S.lmax);
+            }
+
 
+
+            // Compute the probability of the path at index path_index in the batch,
+            //   from the FOD amplitudes computed by evaluate_batch()
+            float path_prob (size_t path_index)
+            {
+              const size_t offset = path_index * S.num_samples;
               float log_prob = half_log_prob0;
               for (size_t i = 0; i < S.num_samples; ++i) {
 
-                float fod_amp = FOD (positions[i], tangents[i]);
+                float fod_amp = batch_amplitudes[offset+i];
                 if (std::isnan (fod_amp))
                   return NaN;
                 if (fod_amp < S.threshold)
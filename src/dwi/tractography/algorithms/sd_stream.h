@@ -62,6 +62,7 @@ class SDStream : public MethodBase { MEMALIGN(SDStream)
           properties.set (precomputed, "sh_precomputed");
           if (precomputed)
             precomputer = new Math::SH::PrecomputedAL<float> (lmax);
+          init_sh_lookup (lookup, lmax);
         }
 
         ~Shared () {
@@ -72,6 +73,7 @@ class SDStream : public MethodBase { MEMALIGN(SDStream)
         float dot_threshold;
         size_t lmax;
         Math::SH::PrecomputedAL<float>* precomputer;
+        Math::SH::PrecomputedBasis<float> lookup;
 
     };
 
@@ -156,7 +158,9 @@ class SDStream : public MethodBase { MEMALIGN(SDStream)
 
       float FOD (const Eigen::Vector3f& d) const
       {
-        return (S.precomputer ?
+        return (S.lookup ?
+            S.lookup.value (values, d) :
+            S.precomputer ?
             S.precomputer->value (values, d) :
             Math::SH::value (values, d, S.lmax)
         );
@@ -26,6 +26,8 @@
 #include "file/key_value.h"
 #include "file/ofstream.h"
 #include "dwi/tractography/file_base.h"
+#include "dwi/tractography/file_compressed.h"
+#include "dwi/tractography/file_mmap.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 
@@ -58,15 +60,38 @@ namespace MR
 
 
       //! A class to read streamlines data
+      /*! The track data are memory-mapped, and read a whole streamline at a
+       * time, from either a .tck file (see MappedStreamlines) or a compressed
+       * .tckz file (see Compressed::MappedBlocks). Streamlines are read
+       * sequentially, but reading can also be restricted to a contiguous
+       * range of streamlines (see set_range() & shard()), and any streamline
+       * can be loaded directly using get(). Multiple readers can therefore
+       * process different ranges of streamlines from the same file
+       * concurrently. */
       template <class ValueType = float>
       class Reader : public __ReaderBase__, public ReaderInterface<ValueType>
       { NOMEMALIGN
         public:
 
           //! open the \c file for reading and load header into \c properties
-          Reader (const std::string& file, Properties& properties)
+          Reader (const std::string& file, Properties& properties) :
+              position (0),
+              index_base (0),
+              index_end (std::numeric_limits<size_t>::max()),
+              finished (false),
+              next_decoded (0)
           {
-            open (file, "tracks", properties);
+            read_header (file, "tracks", properties);
+            if (compression.empty()) {
+              data.reset (new MappedStreamlines (file, data_file, data_offset, dtype));
+            }
+            else {
+              if (compression != "deflate")
+                throw Exception ("unsupported compression \"" + compression + "\" in tracks file \"" + file + "\"");
+              if (!(quantisation > 0.0))
+                throw Exception ("invalid quantisation step in compressed tracks file \"" + file + "\"");
+              blocks.reset (new Compressed::MappedBlocks (data_file, data_offset, quantisation));
+            }
             auto opt = App::get_options ("tck_weights_in");
             if (opt.size())
               weights = load_vector<ValueType> (opt[0][0]);
@@ -77,101 +102,204 @@ namespace MR
             bool operator() (Streamline<ValueType>& tck) {
               tck.clear();
 
-              if (!in.is_open())
+              if (!(data || blocks) || finished)
+                return false;
+              if (current_index >= index_end) {
+                finished = true;
                 return false;
+              }
 
-              do {
-                auto p = get_next_point();
-                if (std::isinf (p[0])) {
-                  in.close();
-                  check_excess_weights();
-                  return false;
-                }
-                if (in.eof()) {
-                  in.close();
-                  check_excess_weights();
-                  return false;
-                }
+              if (!(data ? load_next (tck) : decode_next (tck))) {
+                finished = true;
+                check_excess_weights();
+                return false;
+              }
 
-                if (std::isnan (p[0])) {
-                  tck.set_index (current_index++);
+              if (!set_weight (tck, current_index)) {
+                WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
+                      "ceasing reading of streamline data");
+                finished = true;
+                tck.clear();
+                return false;
+              }
+              tck.set_index (current_index++ - index_base);
+              return true;
+            }
 
-                  if (weights.size()) {
 
-                    if (tck.get_index() < size_t(weights.size())) {
-                      tck.weight = weights[tck.get_index()];
-                    } else {
-                      WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
-                            "ceasing reading of streamline data");
-                      in.close();
-                      tck.clear();
-                      return false;
-                    }
+          //! the number of complete streamlines in the file
+          /*! this requires the index of streamline offsets, which will be
+           * generated if not already available. */
+          size_t num_streamlines () const {
+            if (data) {
+              data->build_index();
+              return data->num_streamlines();
+            }
+            if (blocks) {
+              blocks->build_index();
+              return blocks->num_streamlines();
+            }
+            return 0;
+          }
+
+          //! position the reader so that the next streamline read is that at \a index
+          void seek (size_t index) {
+            if (index > num_streamlines())
+              throw Exception ("cannot seek to streamline " + str(index) + " in tracks file containing " + str(num_streamlines()) + " streamlines");
+            if (data) {
+              position = data->first_point (index);
+            }
+            else if (index < num_streamlines()) {
+              const size_t b = blocks->find_block (index);
+              blocks->decode (blocks->block (b), decoded);
+              position = blocks->block (b).end();
+              next_decoded = index - blocks->block_start (b);
+            }
+            else {
+              decoded.clear();
+              next_decoded = 0;
+              position = blocks->end();
+            }
+            current_index = index;
+            finished = false;
+          }
 
-                  } else {
-                    tck.weight = 1.0;
-                  }
+          //! restrict reading to the streamlines with indices in [\a first, \a last)
+          /*! Streamlines read are then indexed relative to \a first, so that
+           * per-streamline outputs generated for consecutive ranges can be
+           * concatenated. */
+          void set_range (size_t first, size_t last) {
+            if (first > last || last > num_streamlines())
+              throw Exception ("invalid range of streamlines [" + str(first) + "," + str(last) + ") requested "
+                               "from tracks file containing " + str(num_streamlines()) + " streamlines");
+            seek (first);
+            index_base = first;
+            index_end = last;
+          }
 
-                  return true;
-                }
+          //! the range of streamlines [first, last) in shard \a n of \a num_shards
+          /*! shards are contiguous and consecutive, and contain approximately
+           * equal amounts of data. */
+          std::pair<size_t,size_t> shard (size_t n, size_t num_shards) const {
+            if (n >= num_shards)
+              throw Exception ("invalid shard " + str(n) + " requested (of " + str(num_shards) + " shards)");
+            num_streamlines();
+            if (data)
+              return { data->shard_start (n, num_shards), data->shard_start (n+1, num_shards) };
+            return { blocks->shard_start (n, num_shards), blocks->shard_start (n+1, num_shards) };
+          }
 
-                tck.push_back (p);
-              } while (in.good());
+          //! load streamline \a index, irrespective of the current reading position
+          /*! This is thread-safe, and does not affect the sequential reading
+           * of streamlines. The index of \a tck is set to \a index. For
+           * compressed files, this requires decoding the entire block
+           * containing the streamline; use get_range() where possible. */
+          void get (size_t index, Streamline<ValueType>& tck) const {
+            if (index >= num_streamlines())
+              throw Exception ("cannot access streamline " + str(index) + " in tracks file containing " + str(num_streamlines()) + " streamlines");
+            if (data) {
+              data->get (index, tck);
+            }
+            else {
+              const size_t b = blocks->find_block (index);
+              vector<Streamline<ValueType>> tracks;
+              blocks->decode (blocks->block (b), tracks);
+              tck = std::move (tracks[index - blocks->block_start (b)]);
+              tck.set_index (index);
+            }
+            if (!set_weight (tck, index))
+              throw Exception ("Streamline weights file contains less entries (" + str(weights.size()) + ") than requested streamline index " + str(index));
+          }
 
-              in.close();
-              return false;
+          //! load the streamlines with indices in [\a first, \a last)
+          void get_range (size_t first, size_t last, vector<Streamline<ValueType>>& tracks) const {
+            if (first > last || last > num_streamlines())
+              throw Exception ("invalid range of streamlines [" + str(first) + "," + str(last) + ") requested "
+                               "from tracks file containing " + str(num_streamlines()) + " streamlines");
+            tracks.resize (last - first);
+            if (data) {
+              for (size_t n = first; n != last; ++n)
+                data->get (n, tracks[n-first]);
             }
+            else {
+              vector<Streamline<ValueType>> block_tracks;
+              for (size_t n = first; n != last; ) {
+                const size_t b = blocks->find_block (n);
+                const size_t block_start = blocks->block_start (b);
+                blocks->decode (blocks->block (b), block_tracks);
+                for (; n != last && n < block_start + block_tracks.size(); ++n) {
+                  tracks[n-first] = std::move (block_tracks[n-block_start]);
+                  tracks[n-first].set_index (n);
+                }
+              }
+            }
+            for (size_t n = first; n != last; ++n) {
+              if (!set_weight (tracks[n-first], n))
+                throw Exception ("Streamline weights file contains less entries (" + str(weights.size()) + ") than requested streamline index " + str(n));
+            }
+          }
 
+          void close () { data.reset(); blocks.reset(); }
 
 
         protected:
-          using __ReaderBase__::in;
           using __ReaderBase__::dtype;
           using __ReaderBase__::current_index;
-
+          using __ReaderBase__::data_file;
+          using __ReaderBase__::data_offset;
+          using __ReaderBase__::compression;
+          using __ReaderBase__::quantisation;
+
+          std::shared_ptr<MappedStreamlines> data;
+          std::shared_ptr<Compressed::MappedBlocks> blocks;
+          // the position of the next vertex (.tck) or block (.tckz) to read:
+          size_t position, index_base, index_end;
+          bool finished;
+          // streamlines decoded from the current block of a compressed file:
+          vector<Streamline<ValueType>> decoded;
+          size_t next_decoded;
           Eigen::Matrix<ValueType, Eigen::Dynamic, 1> weights;
 
-          //! takes care of byte ordering issues
-
-            Eigen::Matrix<ValueType,3,1> get_next_point ()
-            {
-              using namespace ByteOrder;
-              switch (dtype()) {
-                case DataType::Float32LE:
-                  {
-                    float p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2])) };
-                  }
-                case DataType::Float32BE:
-                  {
-                    float p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2])) };
-                  }
-                case DataType::Float64LE:
-                  {
-                    double p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2])) };
-                  }
-                case DataType::Float64BE:
-                  {
-                    double p[3];
-                    in.read ((char*) p, sizeof (p));
-                    return { ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2])) };
-                  }
-                default:
-                  assert (0);
-                  break;
-              }
-              return { NaN, NaN, NaN };
+          //! read the next streamline from a .tck file
+          bool load_next (Streamline<ValueType>& tck) {
+            const size_t end = data->find_delimiter (position);
+            if (end == data->num_points() || data->is_barrier (end))
+              return false;
+            data->load (position, end, tck);
+            position = end + 1;
+            return true;
+          }
+
+          //! read the next streamline from a compressed file, decoding the next block if needed
+          bool decode_next (Streamline<ValueType>& tck) {
+            while (next_decoded == decoded.size()) {
+              Compressed::Block block;
+              if (!blocks->read_header (position, block))
+                return false;
+              blocks->decode (block, decoded);
+              position = block.end();
+              next_decoded = 0;
             }
+            std::swap (tck, decoded[next_decoded++]);
+            return true;
+          }
+
+          //! set the weight of \a tck from the weights file, if provided
+          bool set_weight (Streamline<ValueType>& tck, size_t index) const {
+            if (!weights.size()) {
+              tck.weight = 1.0;
+              return true;
+            }
+            if (index >= size_t(weights.size()))
+              return false;
+            tck.weight = weights[index];
+            return true;
+          }
 
           //! Check that the weights file does not contain excess entries
           void check_excess_weights()
           {
-            if (!weights.size())
+            if (!weights.size() || index_base || index_end < std::numeric_limits<size_t>::max())
               return;
             if (size_t(weights.size()) > current_index) {
               WARN ("Streamline weights file contains more entries (" + str(weights.size()) + ") than .tck file (" + str(current_index) + ")");
@@ -212,15 +340,23 @@ namespace MR
           using __WriterBase__<ValueType>::verify_stream;
           using __WriterBase__<ValueType>::update_counts;
           using __WriterBase__<ValueType>::open_success;
+          using __WriterBase__<ValueType>::compression;
+          using __WriterBase__<ValueType>::quantisation;
 
           using vector_type = Eigen::Matrix<ValueType,3,1>;
 
           //! create a new track file with the specified properties
+          /*! files with the .tckz suffix are written in compressed form (see
+           * Compressed). */
           WriterUnbuffered (const std::string& file, const Properties& properties) :
               __WriterBase__<ValueType> (file) {
 
-            if (!Path::has_suffix (name, ".tck"))
-              throw Exception ("output track files must use the .tck suffix");
+            if (Path::has_suffix (name, ".tckz")) {
+              compression = "deflate";
+              quantisation = Compressed::quantisation();
+            }
+            else if (!Path::has_suffix (name, ".tck"))
+              throw Exception ("output track files must use the .tck or .tckz suffix");
 
             File::OFStream out;
             try {
@@ -236,9 +372,15 @@ namespace MR
             create (out, properties, "tracks");
             barrier_addr = out.tellp();
 
-            vector_type x;
-            format_point (barrier(), x);
-            out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            if (compression.size()) {
+              const char terminator[Compressed::block_header_size] = { };
+              out.write (terminator, sizeof (terminator));
+            }
+            else {
+              vector_type x;
+              format_point (barrier(), x);
+              out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+            }
             if (!out.good())
               throw Exception ("error writing tracks file \"" + name + "\": " + strerror (errno));
             open_success = true;
@@ -250,15 +392,22 @@ namespace MR
 
           //! append track to file
           bool operator() (const Streamline<ValueType>& tck) {
-            // allocate buffer on the stack for performance:
-            NON_POD_VLA (buffer, vector_type, tck.size()+2);
-            for (size_t n = 0; n < tck.size(); ++n) {
-              assert (tck[n].allFinite());
-              format_point (tck[n], buffer[n]);
+            if (compression.size()) {
+              vector<uint8_t> raw;
+              Compressed::encode (tck, quantisation, raw);
+              commit_block (raw, 1);
             }
-            format_point (delimiter(), buffer[tck.size()]);
+            else {
+              // allocate buffer on the stack for performance:
+              NON_POD_VLA (buffer, vector_type, tck.size()+2);
+              for (size_t n = 0; n < tck.size(); ++n) {
+                assert (tck[n].allFinite());
+                format_point (tck[n], buffer[n]);
+              }
+              format_point (delimiter(), buffer[tck.size()]);
 
-            commit (buffer, tck.size()+1);
+              commit (buffer, tck.size()+1);
+            }
 
             if (weights_name.size())
               write_weights (str(tck.weight) + "\n");
@@ -326,6 +475,34 @@ namespace MR
           }
 
 
+          //! compress and write a block of \c num_streamlines encoded streamlines to file
+          /*! The block is written in place of the terminating (empty) block
+           * header, with a new terminator appended after it. The number of
+           * streamlines in the block is written last, so that concurrent
+           * readers never encounter a partially written block. */
+          void commit_block (const vector<uint8_t>& raw, size_t num_streamlines) {
+            if (num_streamlines == 0 || !open_success)
+              return;
+
+            vector<uint8_t> block;
+            Compressed::deflate_block (raw, num_streamlines, block);
+            block.resize (block.size() + Compressed::block_header_size, 0);
+
+            const char* const data = reinterpret_cast<const char*> (block.data());
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            out.write (data + Compressed::block_header_size, block.size() - Compressed::block_header_size);
+            verify_stream (out);
+            const int64_t prev_barrier_addr = barrier_addr;
+            barrier_addr = int64_t (out.tellp()) - Compressed::block_header_size;
+            out.seekp (prev_barrier_addr + 4, out.beg);
+            out.write (data + 4, Compressed::block_header_size - 4);
+            out.seekp (prev_barrier_addr, out.beg);
+            out.write (data, 4);
+            verify_stream (out);
+            update_counts (out);
+          }
+
+
           //! copy construction explicitly disabled
           WriterUnbuffered (const WriterUnbuffered&) = delete;
       };
@@ -346,7 +523,9 @@ namespace MR
        * It also helps reduce file fragmentation when multiple processes write
        * to file concurrently. The size of the write-back buffer defaults to
        * 16MB, and can be set in the config file using the
-       * TrackWriterBufferSize field (in bytes).
+       * TrackWriterBufferSize field (in bytes). For compressed (.tckz) files,
+       * data are instead committed one block at a time, as determined by the
+       * TrackCompressionBlockSize field.
        * */
       template <typename ValueType = float>
         class Writer : public WriterUnbuffered<ValueType>
@@ -358,6 +537,9 @@ namespace MR
           using WriterUnbuffered<ValueType>::format_point;
           using WriterUnbuffered<ValueType>::weights_name;
           using WriterUnbuffered<ValueType>::write_weights;
+          using WriterUnbuffered<ValueType>::commit_block;
+          using WriterUnbuffered<ValueType>::compression;
+          using WriterUnbuffered<ValueType>::quantisation;
           using vector_type = typename WriterUnbuffered<ValueType>::vector_type;
 
           //! create new RAM-buffered track file with specified properties
@@ -374,8 +556,9 @@ namespace MR
           Writer (const std::string& file, const Properties& properties, size_t default_buffer_capacity = 16777216) :
             WriterUnbuffered<ValueType> (file, properties),
             buffer_capacity (File::Config::get_int ("TrackWriterBufferSize", default_buffer_capacity) / sizeof (vector_type)),
-            buffer (new vector_type [buffer_capacity]),
-            buffer_size (0) { }
+            buffer (compression.empty() ? new vector_type [buffer_capacity] : nullptr),
+            buffer_size (0),
+            block_count (0) { }
 
           Writer (const Writer& W) = delete;
 
@@ -386,25 +569,34 @@ namespace MR
 
           //! append track to file
           bool operator() (const Streamline<ValueType>& tck) {
-            if (buffer_size + tck.size() + 2 > buffer_capacity)
-              commit ();
-
-            if (tck.size()+1 >= buffer_capacity) {
-              buffer_capacity = tck.size()+1;
-              buffer.reset (new vector_type [buffer_capacity]);
+            if (compression.size()) {
+              Compressed::encode (tck, quantisation, block_raw);
+              ++block_count;
             }
+            else {
+              if (buffer_size + tck.size() + 2 > buffer_capacity)
+                commit ();
+
+              if (tck.size()+1 >= buffer_capacity) {
+                buffer_capacity = tck.size()+1;
+                buffer.reset (new vector_type [buffer_capacity]);
+              }
 
-            for (const auto& i : tck) {
-              assert (i.allFinite());
-              add_point (i);
+              for (const auto& i : tck) {
+                assert (i.allFinite());
+                add_point (i);
+              }
+              add_point (delimiter());
             }
-            add_point (delimiter());
 
             if (weights_name.size())
               weights_buffer += str (tck.weight) + ' ';
 
             ++count;
             ++total_count;
+
+            if (block_raw.size() >= Compressed::block_size())
+              commit();
             return true;
           }
 
@@ -414,6 +606,9 @@ namespace MR
           std::unique_ptr<vector_type[]> buffer;
           size_t buffer_size;
           std::string weights_buffer;
+          // encoded streamlines pending compression, for .tckz files:
+          vector<uint8_t> block_raw;
+          size_t block_count;
 
           //! add point to buffer and increment buffer_size accordingly
           void add_point (const vector_type& p) {
@@ -421,8 +616,15 @@ namespace MR
           }
 
           void commit () {
-            WriterUnbuffered<ValueType>::commit (buffer.get(), buffer_size);
-            buffer_size = 0;
+            if (compression.size()) {
+              commit_block (block_raw, block_count);
+              block_raw.clear();
+              block_count = 0;
+            }
+            else {
+              WriterUnbuffered<ValueType>::commit (buffer.get(), buffer_size);
+              buffer_size = 0;
+            }
 
             if (weights_name.size()) {
               write_weights (weights_buffer);
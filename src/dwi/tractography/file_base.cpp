@@ -23,13 +23,26 @@ namespace MR {
 
 
       void __ReaderBase__::open (const std::string& file, const std::string& type, Properties& properties)
+      {
+        read_header (file, type, properties);
+        in.open (data_file.c_str(), std::ios::in | std::ios::binary);
+        if (!in)
+          throw Exception ("error opening " + type  + " data file \"" + data_file + "\": " + strerror(errno));
+        in.seekg (data_offset);
+      }
+
+
+
+      void __ReaderBase__::read_header (const std::string& file, const std::string& type, Properties& properties)
       {
         properties.clear();
         dtype = DataType::Undefined;
+        compression.clear();
+        quantisation = NaN;
 
         const std::string firstline ("mrtrix " + type);
         File::KeyValue::Reader kv (file, firstline.c_str());
-        std::string data_file;
+        std::string file_spec;
 
         while (kv.next()) {
           const std::string key = lowercase (kv.key());
@@ -45,8 +58,10 @@ namespace MR {
             }
           }
           else if (key == "comment") properties.comments.push_back (kv.value());
-          else if (key == "file") data_file = kv.value();
+          else if (key == "file") file_spec = kv.value();
           else if (key == "datatype") dtype = DataType::parse (kv.value());
+          else if (key == "compression") compression = kv.value();
+          else if (key == "quantisation") quantisation = to<default_type> (kv.value());
           else add_line (properties[kv.key()], kv.value());
         }
 
@@ -57,10 +72,10 @@ namespace MR {
           throw Exception ("only supported datatype for tracks file are "
               "Float32LE, Float32BE, Float64LE & Float64BE (in " + type  + " file \"" + file + "\")");
 
-        if (data_file.empty())
+        if (file_spec.empty())
           throw Exception ("missing \"files\" specification for " + type  + " file \"" + file + "\"");
 
-        std::istringstream files_stream (data_file);
+        std::istringstream files_stream (file_spec);
         std::string fname;
         files_stream >> fname;
         int64_t offset = 0;
@@ -73,14 +88,10 @@ namespace MR {
         }
 
         if (fname != ".")
-          fname = Path::join (Path::dirname (file), fname);
+          data_file = Path::join (Path::dirname (file), fname);
         else
-          fname = file;
-
-        in.open (fname.c_str(), std::ios::in | std::ios::binary);
-        if (!in)
-          throw Exception ("error opening " + type  + " data file \"" + fname + "\": " + strerror(errno));
-        in.seekg (offset);
+          data_file = file;
+        data_offset = offset;
       }
 
     }
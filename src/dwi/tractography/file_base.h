@@ -41,7 +41,7 @@ namespace MR
       class __ReaderBase__
       { NOMEMALIGN
         public:
-            __ReaderBase__() : current_index (0) { }
+            __ReaderBase__() : current_index (0), data_offset (0), quantisation (NaN) { }
           ~__ReaderBase__ () {
             if (in.is_open())
               in.close();
@@ -55,6 +55,14 @@ namespace MR
           std::ifstream in;
           DataType dtype;
           uint64_t current_index;
+          std::string data_file;
+          int64_t data_offset;
+          //! the compression scheme and quantisation step, for compressed tracks files
+          std::string compression;
+          default_type quantisation;
+
+          //! parse the header into \c properties, and locate the data file & offset
+          void read_header (const std::string& file, const std::string& firstline, Properties& properties);
       };
 
 
@@ -70,7 +78,8 @@ namespace MR
               name (name),
               dtype (DataType::from<ValueType>()),
               count_offset (0),
-              open_success (false)
+              open_success (false),
+              quantisation (NaN)
           {
             dtype.set_byte_order_native();
             if (dtype != DataType::Float32LE && dtype != DataType::Float32BE &&
@@ -114,6 +123,10 @@ namespace MR
               for (const auto& it : properties.prior_rois)
                 out << "prior_roi: " << it.first << " " << it.second << "\n";
 
+              if (compression.size()) {
+                out << "compression: " << compression << "\n";
+                out << "quantisation: " << str(quantisation) << "\n";
+              }
               out << "datatype: " << dtype.specifier() << "\n";
               int64_t data_offset = int64_t(out.tellp()) + 65;
               data_offset += (4 - (data_offset % 4)) % 4;
@@ -138,6 +151,8 @@ namespace MR
             DataType dtype;
             int64_t count_offset;
             bool open_success;
+            std::string compression;
+            default_type quantisation;
 
 
             void verify_stream (const File::OFStream& out) {
@@ -0,0 +1,172 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/file_compressed.h"
+
+#include <algorithm>
+#include <limits>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "raw.h"
+#include "file/config.h"
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace Compressed {
+
+
+
+        //CONF option: TrackQuantisation
+        //CONF default: 0.01
+        //CONF The step (in mm) to which vertex positions are quantised when
+        //CONF writing compressed tracks (.tckz) files. Vertices are stored to
+        //CONF within half this distance of their original positions; smaller
+        //CONF values increase the size of the output file.
+        default_type quantisation ()
+        {
+          // parse at full precision, since the value is stored in the header:
+          const std::string value = File::Config::get ("TrackQuantisation", "0.01");
+          try {
+            const default_type step = to<default_type> (value);
+            if (step > 0.0)
+              return step;
+          }
+          catch (Exception&) { }
+          throw Exception ("invalid value \"" + value + "\" for config file option TrackQuantisation (must be positive)");
+        }
+
+
+
+        //CONF option: TrackCompressionBlockSize
+        //CONF default: 262144
+        //CONF The amount of encoded streamline data (in bytes) to collect
+        //CONF into each independently compressed block when writing
+        //CONF compressed tracks (.tckz) files. Smaller blocks allow faster
+        //CONF random access to individual streamlines, larger blocks
+        //CONF slightly improve compression.
+        size_t block_size ()
+        {
+          static const size_t value = std::min (std::max (File::Config::get_int ("TrackCompressionBlockSize", 262144), 4096), 268435456);
+          return value;
+        }
+
+
+
+        void deflate_block (const vector<uint8_t>& raw, size_t num_streamlines, vector<uint8_t>& block)
+        {
+          if (raw.size() > std::numeric_limits<uint32_t>::max())
+            throw Exception ("streamline data too large to be stored in a single compressed block");
+          uLongf compressed_size = compressBound (raw.size());
+          block.resize (block_header_size + compressed_size);
+          if (compress2 (block.data() + block_header_size, &compressed_size, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK)
+            throw Exception ("error compressing streamline data");
+          block.resize (block_header_size + compressed_size);
+          Raw::store_LE<uint32_t> (num_streamlines, block.data(), 0);
+          Raw::store_LE<uint32_t> (raw.size(), block.data(), 1);
+          Raw::store_LE<uint32_t> (compressed_size, block.data(), 2);
+        }
+
+
+
+
+        MappedBlocks::MappedBlocks (const std::string& data_file, int64_t offset, default_type quantisation) :
+            size (0),
+            quantisation (quantisation)
+        {
+          struct stat sbuf;
+          if (stat (data_file.c_str(), &sbuf))
+            throw Exception ("cannot stat tracks data file \"" + data_file + "\": " + strerror (errno));
+          size = sbuf.st_size > offset ? sbuf.st_size - offset : 0;
+          if (size)
+            mmap.reset (new File::MMap (File::Entry (data_file, offset), false, true, size));
+        }
+
+
+
+        bool MappedBlocks::read_header (size_t offset, Block& block) const
+        {
+          if (offset + block_header_size > size)
+            return false;
+          const uint8_t* p = mmap->address() + offset;
+          block.offset = offset;
+          block.num_streamlines = Raw::fetch_LE<uint32_t> (p, 0);
+          block.raw_size = Raw::fetch_LE<uint32_t> (p, 1);
+          block.compressed_size = Raw::fetch_LE<uint32_t> (p, 2);
+          return block.num_streamlines && block.end() <= size;
+        }
+
+
+
+        vector<uint8_t> MappedBlocks::inflate (const Block& block) const
+        {
+          // zlib cannot compress by more than a factor of 1032:
+          if (block.raw_size > 1032 * uint64_t (block.compressed_size))
+            throw Exception ("malformed block at offset " + str(block.offset) + " in compressed tracks file \"" + name() + "\"");
+          vector<uint8_t> raw (block.raw_size);
+          uLongf raw_size = raw.size();
+          if (uncompress (raw.data(), &raw_size, mmap->address() + block.offset + block_header_size, block.compressed_size) != Z_OK ||
+              raw_size != raw.size())
+            throw Exception ("error decompressing block at offset " + str(block.offset) + " in compressed tracks file \"" + name() + "\"");
+          return raw;
+        }
+
+
+
+        void MappedBlocks::generate_index ()
+        {
+          starts.push_back (0);
+          Block block;
+          for (size_t offset = 0; read_header (offset, block); offset = block.end()) {
+            blocks.push_back (block);
+            starts.push_back (starts.back() + block.num_streamlines);
+          }
+          DEBUG ("indexed " + str(blocks.size()) + " blocks (" + str(num_streamlines()) + " streamlines) in compressed tracks file \"" + name() + "\"");
+        }
+
+
+
+        size_t MappedBlocks::find_block (size_t index) const
+        {
+          assert (index < num_streamlines());
+          return std::upper_bound (starts.begin(), starts.end(), index) - starts.begin() - 1;
+        }
+
+
+
+        size_t MappedBlocks::shard_start (size_t n, size_t num_shards) const
+        {
+          assert (n <= num_shards);
+          if (n == num_shards || blocks.empty())
+            return n ? num_streamlines() : 0;
+          uint64_t total = 0;
+          for (const auto& b : blocks)
+            total += b.raw_size;
+          const uint64_t target = (total * n) / num_shards;
+          uint64_t cumulative = 0;
+          size_t b = 0;
+          for (; b != blocks.size() && cumulative + blocks[b].raw_size / 2 < target; ++b)
+            cumulative += blocks[b].raw_size;
+          return starts[b];
+        }
+
+
+
+      }
+    }
+  }
+}
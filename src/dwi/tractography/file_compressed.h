@@ -0,0 +1,210 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_file_compressed_h__
+#define __dwi_tractography_file_compressed_h__
+
+#include <mutex>
+
+#include "types.h"
+#include "exception.h"
+#include "mrtrix.h"
+#include "file/mmap.h"
+#include "dwi/tractography/streamline.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+      //! Functions & classes to handle compressed tracks (.tckz) files
+      /*! These files share the header of the .tck format, with additional
+       * "compression" and "quantisation" entries. Vertex positions are
+       * quantised to integer multiples of the quantisation step (in mm),
+       * and each streamline is stored as its number of vertices, followed
+       * by the differences between the quantised positions of consecutive
+       * vertices (the first relative to the origin), as zigzag-encoded
+       * variable-length integers.
+       *
+       * Streamlines are grouped into blocks, each deflated independently,
+       * such that blocks can be decoded in any order, and in parallel. Each
+       * block starts with a header of three little-endian 32-bit integers:
+       * the number of streamlines in the block, and the sizes of its raw
+       * and deflated contents. The data end with a block containing no
+       * streamlines. */
+      namespace Compressed
+      {
+
+        constexpr size_t block_header_size = 12;
+
+        //! the quantisation step to use when writing compressed tracks files
+        default_type quantisation ();
+
+        //! the raw size beyond which a block is committed when writing
+        size_t block_size ();
+
+
+
+        inline void put_varint (vector<uint8_t>& raw, uint64_t value)
+        {
+          while (value >= 0x80) {
+            raw.push_back (uint8_t (value) | 0x80);
+            value >>= 7;
+          }
+          raw.push_back (uint8_t (value));
+        }
+
+        inline uint64_t zigzag (int64_t value) { return (uint64_t (value) << 1) ^ uint64_t (value >> 63); }
+        inline int64_t unzigzag (uint64_t value) { return int64_t (value >> 1) ^ -int64_t (value & 1); }
+
+
+        //! append the encoded vertices of \a tck to \a raw
+        template <typename ValueType>
+          void encode (const Streamline<ValueType>& tck, const default_type quantisation, vector<uint8_t>& raw)
+          {
+            constexpr int64_t limit = int64_t(1) << 52;
+            put_varint (raw, tck.size());
+            int64_t previous[3] = { 0, 0, 0 };
+            for (const auto& p : tck) {
+              for (size_t axis = 0; axis != 3; ++axis) {
+                const default_type scaled = std::round (p[axis] / quantisation);
+                if (!(std::abs (scaled) < limit))
+                  throw Exception ("vertex position " + str(p[axis]) + " cannot be stored at quantisation step " + str(quantisation));
+                const int64_t q = int64_t (scaled);
+                put_varint (raw, zigzag (q - previous[axis]));
+                previous[axis] = q;
+              }
+            }
+          }
+
+
+        //! deflate the \a num_streamlines encoded in \a raw into a block (including its header)
+        void deflate_block (const vector<uint8_t>& raw, size_t num_streamlines, vector<uint8_t>& block);
+
+
+
+        //! the location & size of a block within the data
+        class Block { NOMEMALIGN
+          public:
+            size_t offset, num_streamlines, raw_size, compressed_size;
+            size_t end () const { return offset + block_header_size + compressed_size; }
+        };
+
+
+
+        //! memory-mapped access to the data of a compressed tracks file
+        /*! All const methods are thread-safe. */
+        class MappedBlocks
+        { NOMEMALIGN
+          public:
+            MappedBlocks (const std::string& data_file, int64_t offset, default_type quantisation);
+
+            //! read the header of the block at byte \a offset into \a block
+            /*! returns false if this is the final (empty) block, or if the
+             * block is incomplete (i.e. the file is still being written). */
+            bool read_header (size_t offset, Block& block) const;
+
+            //! decode the streamlines in \a block into \a tracks
+            template <typename ValueType>
+              void decode (const Block& block, vector<Streamline<ValueType>>& tracks) const
+              {
+                const vector<uint8_t> raw (inflate (block));
+                const uint8_t* p = raw.data();
+                const uint8_t* const end = p + raw.size();
+                // each streamline needs at least one byte for its vertex count,
+                // and each vertex at least one byte per axis:
+                if (block.num_streamlines > raw.size())
+                  throw Exception ("malformed data in compressed tracks file \"" + name() + "\"");
+                tracks.resize (block.num_streamlines);
+                for (auto& tck : tracks) {
+                  const uint64_t num_vertices = get_varint (p, end);
+                  if (num_vertices > uint64_t (end - p) / 3)
+                    throw Exception ("malformed data in compressed tracks file \"" + name() + "\"");
+                  tck.resize (num_vertices);
+                  int64_t q[3] = { 0, 0, 0 };
+                  for (auto& v : tck) {
+                    for (size_t axis = 0; axis != 3; ++axis) {
+                      q[axis] += unzigzag (get_varint (p, end));
+                      v[axis] = ValueType (q[axis] * quantisation);
+                    }
+                  }
+                  tck.weight = 1.0;
+                }
+                if (p != end)
+                  throw Exception ("unexpected data at end of block in compressed tracks file \"" + name() + "\"");
+              }
+
+
+            //! build the index of the blocks in the file
+            /*! This is only done once, even if invoked concurrently from
+             * multiple threads. */
+            void build_index () { std::call_once (index_flag, [this] { generate_index(); }); }
+
+            size_t num_blocks () const { return blocks.size(); }
+            const Block& block (size_t index) const { return blocks[index]; }
+            //! the index of the first streamline in block \a index
+            size_t block_start (size_t index) const { return starts[index]; }
+            //! the number of complete streamlines in the file
+            size_t num_streamlines () const { return starts.back(); }
+            //! the block containing streamline \a index
+            size_t find_block (size_t index) const;
+            //! the byte offset following the last complete block
+            size_t end () const { return blocks.size() ? blocks.back().end() : 0; }
+
+            //! the index of the first streamline in shard \a n of \a num_shards
+            /*! shards start on block boundaries, and contain approximately
+             * equal amounts of (raw) data. */
+            size_t shard_start (size_t n, size_t num_shards) const;
+
+            std::string name () const { return mmap ? mmap->name() : std::string(); }
+
+          protected:
+            std::unique_ptr<File::MMap> mmap;
+            size_t size;
+            const default_type quantisation;
+            vector<Block> blocks;
+            vector<size_t> starts;
+            std::once_flag index_flag;
+
+            void generate_index ();
+            vector<uint8_t> inflate (const Block& block) const;
+
+            uint64_t get_varint (const uint8_t*& p, const uint8_t* const end) const
+            {
+              uint64_t value = 0;
+              for (size_t shift = 0; shift < 64; shift += 7) {
+                if (p == end)
+                  break;
+                const uint8_t byte = *p++;
+                value |= uint64_t (byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                  return value;
+              }
+              throw Exception ("malformed data in compressed tracks file \"" + name() + "\"");
+            }
+        };
+
+      }
+
+    }
+  }
+}
+
+
+#endif
@@ -0,0 +1,199 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/file_mmap.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "file/config.h"
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+
+
+      namespace {
+        const char index_magic[] = "mrtrix tracks index\n";
+        constexpr size_t index_header_fields = 4;
+      }
+
+
+
+      MappedStreamlines::MappedStreamlines (const std::string& tck_file, const std::string& data_file, int64_t offset, DataType dtype) :
+          tck_file (tck_file),
+          dtype (dtype),
+          is_native (dtype.is_byte_order_native()),
+          point_size (3 * dtype.bytes()),
+          npoints (0)
+      {
+        struct stat sbuf;
+        if (stat (data_file.c_str(), &sbuf))
+          throw Exception ("cannot stat tracks data file \"" + data_file + "\": " + strerror (errno));
+        // only map whole vertices; any trailing partial vertex is still being written:
+        npoints = sbuf.st_size > offset ? (sbuf.st_size - offset) / point_size : 0;
+        if (npoints)
+          mmap.reset (new File::MMap (File::Entry (data_file, offset), false, true, npoints * point_size));
+
+        // the exponent is held in the most significant 32-bit word of the
+        // first coordinate; locate it and its mask in file byte order:
+        const bool is_double = dtype.bytes() == 8;
+        const uint32_t mask = is_double ? 0x7FF00000u : 0x7F800000u;
+        exponent_word = (is_double && dtype.is_little_endian()) ? 4 : 0;
+        exponent_mask = dtype.is_little_endian() ? ByteOrder::LE (mask) : ByteOrder::BE (mask);
+      }
+
+
+
+      //CONF option: TrackIndexSidecar
+      //CONF default: 0 (false)
+      //CONF Whether to save the index of streamline locations generated when
+      //CONF random access into a tracks file is required, as a sidecar file
+      //CONF alongside it (with the additional suffix .idx). The index will
+      //CONF then be reused by subsequent commands, provided the CRC-32
+      //CONF checksum of the streamline data still matches. If the sidecar
+      //CONF cannot be written, the index is simply regenerated as needed.
+      void MappedStreamlines::generate_index ()
+      {
+        if (load_index())
+          return;
+
+        offsets.push_back (0);
+        bool complete = false;
+        for (size_t n = 0; n < npoints; ) {
+          const size_t d = find_delimiter (n);
+          if (d == npoints)
+            break;
+          if (is_barrier (d)) {
+            complete = true;
+            break;
+          }
+          n = d + 1;
+          offsets.push_back (n);
+        }
+        DEBUG ("indexed " + str(num_streamlines()) + " streamlines in tracks file \"" + tck_file + "\"");
+
+        // only save the index once the file has been completely written:
+        if (complete && File::Config::get_bool ("TrackIndexSidecar", false))
+          save_index();
+      }
+
+
+
+
+      bool MappedStreamlines::load_index ()
+      {
+        if (!mmap)
+          return false;
+        const std::string path (index_path (tck_file));
+        std::ifstream in (path, std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        try {
+          std::string magic (sizeof (index_magic) - 1, '\0');
+          in.read (&magic[0], magic.size());
+          if (magic != index_magic)
+            throw 1;
+
+          uint64_t header[index_header_fields];
+          in.read (reinterpret_cast<char*> (header), sizeof (header));
+          if (!in || header[0] != point_size || header[1] != npoints || header[3] >= npoints)
+            throw 1;
+
+          offsets.resize (header[3] + 1);
+          in.read (reinterpret_cast<char*> (offsets.data()), offsets.size() * sizeof (uint64_t));
+          if (!in || offsets.front() != 0 || offsets.back() >= npoints || !is_barrier (offsets.back()))
+            throw 1;
+          for (size_t n = 1; n < offsets.size(); ++n) {
+            if (offsets[n] <= offsets[n-1])
+              throw 1;
+          }
+
+          // the index is only valid for the data it was generated from:
+          if (header[2] != checksum())
+            throw 1;
+        }
+        catch (...) {
+          DEBUG ("ignoring invalid or out of date tracks index file \"" + path + "\"");
+          offsets.clear();
+          return false;
+        }
+
+        DEBUG ("loaded index of " + str(num_streamlines()) + " streamlines from file \"" + path + "\"");
+        return true;
+      }
+
+
+
+
+      uint32_t MappedStreamlines::checksum () const
+      {
+        uLong crc = crc32 (0L, Z_NULL, 0);
+        const uint8_t* data = mmap->address();
+        // (zlib's crc32() takes a 32-bit length)
+        for (size_t remaining = npoints * point_size; remaining; ) {
+          const size_t n = std::min (remaining, size_t (1) << 30);
+          crc = crc32 (crc, data, n);
+          data += n;
+          remaining -= n;
+        }
+        return crc;
+      }
+
+
+
+
+      void MappedStreamlines::save_index () const
+      {
+        const std::string path (index_path (tck_file));
+        std::random_device random_device;
+        const std::string temp_path (path + "-" + str(random_device()));
+
+        const uint64_t header[index_header_fields] = { point_size, npoints, checksum(), num_streamlines() };
+
+        {
+          std::ofstream out (temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+          if (out) {
+            out.write (index_magic, sizeof (index_magic) - 1);
+            out.write (reinterpret_cast<const char*> (header), sizeof (header));
+            out.write (reinterpret_cast<const char*> (offsets.data()), offsets.size() * sizeof (uint64_t));
+          }
+          if (!out) {
+            DEBUG ("unable to write tracks index file \"" + path + "\"; index will not be saved");
+            out.close();
+            std::remove (temp_path.c_str());
+            return;
+          }
+        }
+
+        // rename into place, so that concurrent processes never see a partial index:
+        if (std::rename (temp_path.c_str(), path.c_str())) {
+          DEBUG ("unable to save tracks index file \"" + path + "\": " + strerror (errno));
+          std::remove (temp_path.c_str());
+        }
+        else
+          INFO ("tracks index saved to file \"" + path + "\"");
+      }
+
+
+
+    }
+  }
+}
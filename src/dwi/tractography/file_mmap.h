@@ -0,0 +1,188 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_file_mmap_h__
+#define __dwi_tractography_file_mmap_h__
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "types.h"
+#include "datatype.h"
+#include "raw.h"
+#include "file/mmap.h"
+#include "dwi/tractography/streamline.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      //! memory-mapped access to the vertex data of a tracks file
+      /*! The streamline delimiters are located by scanning the mapped data in
+       * bulk, rather than parsing the file one vertex at a time. An index of
+       * the offset of each streamline can also be built (or loaded from a
+       * sidecar file, if available), allowing any streamline to be read
+       * directly.
+       *
+       * Once the index has been built, all const methods are thread-safe, so
+       * that a single instance can be shared between threads reading
+       * different ranges of streamlines. */
+      class MappedStreamlines
+      { NOMEMALIGN
+        public:
+          //! map the data in \a data_file from byte \a offset onwards
+          /*! \a tck_file is the header file, and is used to locate the
+           * sidecar index file. */
+          MappedStreamlines (const std::string& tck_file, const std::string& data_file, int64_t offset, DataType dtype);
+
+          //! the number of complete vertices present in the mapped data
+          size_t num_points () const { return npoints; }
+
+          //! the position of the first delimiter or barrier at or after vertex \a from
+          /*! returns num_points() if none is found (i.e. the file is
+           * incomplete). */
+          size_t find_delimiter (size_t from) const
+          {
+            // test blocks of vertices without branching, so that the test
+            // can be vectorised by the compiler:
+            constexpr size_t block = 16;
+            size_t n = from;
+            for (; n + block <= npoints; n += block) {
+              uint32_t found = 0;
+              for (size_t i = 0; i != block; ++i)
+                found |= is_non_finite (n+i);
+              if (found)
+                break;
+            }
+            for (; n < npoints; ++n)
+              if (is_non_finite (n))
+                return n;
+            return npoints;
+          }
+
+          //! whether the vertex at position \a n marks the end of the data
+          bool is_barrier (size_t n) const { return std::isinf (value (n, 0)); }
+
+          //! copy the vertices in positions [\a first, \a last) into \a tck
+          template <typename ValueType>
+            void load (size_t first, size_t last, Streamline<ValueType>& tck) const
+            {
+              assert (first <= last && last <= npoints);
+              tck.resize (last - first);
+              if (!tck.size())
+                return;
+              if (is_native && point_size == sizeof (typename Streamline<ValueType>::point_type)) {
+                memcpy (tck[0].data(), address (first), tck.size() * point_size);
+              }
+              else {
+                for (size_t n = 0; n != tck.size(); ++n)
+                  tck[n] = { ValueType (value (first+n, 0)), ValueType (value (first+n, 1)), ValueType (value (first+n, 2)) };
+              }
+            }
+
+
+          //! build the index of streamline offsets
+          /*! the index is loaded from the sidecar file if present and valid;
+           * otherwise, it is generated by scanning the data, and saved as a
+           * sidecar file if possible and enabled. This is only done once,
+           * even if invoked concurrently from multiple threads. */
+          void build_index () { std::call_once (index_flag, [this] { generate_index(); }); }
+          bool has_index () const { return offsets.size(); }
+
+          //! the number of complete streamlines in the index
+          size_t num_streamlines () const { assert (has_index()); return offsets.size() - 1; }
+          //! the position of the first vertex of streamline \a index
+          size_t first_point (size_t index) const { assert (index < offsets.size()); return offsets[index]; }
+
+          //! the index of the first streamline in shard \a n of \a num_shards
+          /*! shards are contiguous, and contain approximately equal numbers
+           * of vertices. */
+          size_t shard_start (size_t n, size_t num_shards) const
+          {
+            assert (has_index() && n <= num_shards);
+            const uint64_t target = (offsets.back() * n) / num_shards;
+            return std::lower_bound (offsets.begin(), offsets.end(), target) - offsets.begin();
+          }
+
+          //! load streamline \a index into \a tck
+          template <typename ValueType>
+            void get (size_t index, Streamline<ValueType>& tck) const
+            {
+              assert (index < num_streamlines());
+              load (offsets[index], offsets[index+1]-1, tck);
+              tck.set_index (index);
+            }
+
+          //! the path to the sidecar index file for the tracks file \a tck_file
+          static std::string index_path (const std::string& tck_file) { return tck_file + ".idx"; }
+
+        protected:
+          const std::string tck_file;
+          DataType dtype;
+          bool is_native;
+          size_t point_size, npoints;
+          std::unique_ptr<File::MMap> mmap;
+          vector<uint64_t> offsets;
+          std::once_flag index_flag;
+
+          // the 32-bit word of each vertex holding the exponent of its first
+          // coordinate, and the mask selecting its exponent bits (in file
+          // byte order):
+          size_t exponent_word;
+          uint32_t exponent_mask;
+
+          const uint8_t* address (size_t n) const { return mmap->address() + n * point_size; }
+
+          uint32_t is_non_finite (size_t n) const
+          {
+            uint32_t word;
+            memcpy (&word, address (n) + exponent_word, sizeof (word));
+            return (word & exponent_mask) == exponent_mask;
+          }
+
+          default_type value (size_t n, size_t axis) const
+          {
+            const uint8_t* p = address (n);
+            switch (dtype()) {
+              case DataType::Float32LE: return Raw::fetch_LE<float> (p, axis);
+              case DataType::Float32BE: return Raw::fetch_BE<float> (p, axis);
+              case DataType::Float64LE: return Raw::fetch_LE<double> (p, axis);
+              case DataType::Float64BE: return Raw::fetch_BE<double> (p, axis);
+              default: assert (0); return NaN;
+            }
+          }
+
+          void generate_index ();
+          bool load_index ();
+          void save_index () const;
+          //! CRC-32 checksum of the mapped data, used to validate the sidecar index
+          uint32_t checksum () const;
+      };
+
+
+
+    }
+  }
+}
+
+
+#endif
@@ -24,6 +24,7 @@
 #include "algo/loop.h"
 #include "thread_queue.h"
 
+#include "dwi/tractography/streamline.h"
 #include "dwi/tractography/mapping/twi_stats.h"
 #include "dwi/tractography/mapping/voxel.h"
 #include "dwi/tractography/mapping/gaussian/voxel.h"
@@ -66,6 +67,13 @@ namespace MR {
             // std::terminate() with no further ado).
             virtual void finalise() { }
 
+            // Create an empty writer of the same type, into which a subset
+            //   of streamlines can be accumulated independently
+            virtual MapWriterBase* make_shard () const = 0;
+            // Combine the contents of a shard back into this writer;
+            //   must be performed before finalise()
+            virtual void merge (MapWriterBase&) = 0;
+
 
 
             virtual bool operator() (const SetVoxel&)    { return false; }
@@ -150,6 +158,12 @@ namespace MR {
 
           MapWriter (const MapWriter&) = delete;
 
+          MapWriterBase* make_shard () const override {
+            return new MapWriter<value_type> (H, output_image_name, voxel_statistic, type);
+          }
+
+          void merge (MapWriterBase&) override;
+
           void finalise () override {
 
             auto loop = Loop (buffer, 0, 3);
@@ -292,6 +306,80 @@ namespace MR {
 
 
 
+        template <typename value_type>
+          void MapWriter<value_type>::merge (MapWriterBase& other)
+          {
+            auto& that = dynamic_cast<MapWriter<value_type>&> (other);
+            assert (type == that.type && voxel_statistic == that.voxel_statistic);
+
+            if (type == GREYSCALE || type == DIXEL) {
+              for (auto l = Loop (buffer) (buffer, that.buffer); l; ++l) {
+                switch (voxel_statistic) {
+                  case V_SUM: case V_MEAN: add (1.0, that.buffer.value()); break;
+                  case V_MIN: buffer.value() = std::min (value_type (buffer.value()), value_type (that.buffer.value())); break;
+                  case V_MAX: buffer.value() = std::max (value_type (buffer.value()), value_type (that.buffer.value())); break;
+                  default:
+                    throw Exception ("Unknown / unhandled voxel statistic in MapWriter::merge()");
+                }
+              }
+            }
+            else if (type == DEC) {
+              for (auto l = Loop (buffer, 0, 3) (buffer, that.buffer); l; ++l) {
+                const auto current_value = get_dec();
+                const auto other_value = that.get_dec();
+                switch (voxel_statistic) {
+                  case V_SUM: case V_MEAN: set_dec (current_value + other_value); break;
+                  case V_MIN:
+                    if (other_value.squaredNorm() < current_value.squaredNorm())
+                      set_dec (other_value);
+                    break;
+                  case V_MAX:
+                    if (other_value.squaredNorm() > current_value.squaredNorm())
+                      set_dec (other_value);
+                    break;
+                  default:
+                    throw Exception ("Unknown / unhandled voxel statistic in MapWriter::merge()");
+                }
+              }
+            }
+            else if (type == TOD) {
+              VoxelTOD::vector_type current_value, other_value;
+              for (auto l = Loop (buffer, 0, 3) (buffer, that.buffer); l; ++l) {
+                if (counts)
+                  assign_pos_of (buffer, 0, 3).to (*counts, *that.counts);
+                get_tod (current_value);
+                that.get_tod (other_value);
+                switch (voxel_statistic) {
+                  case V_SUM: case V_MEAN: set_tod (current_value + other_value); break;
+                  // For TOD, counts buffer holds the min/max factors
+                  case V_MIN:
+                    if (that.counts->value() < counts->value()) {
+                      counts->value() = that.counts->value();
+                      set_tod (other_value);
+                    }
+                    break;
+                  case V_MAX:
+                    if (that.counts->value() > counts->value()) {
+                      counts->value() = that.counts->value();
+                      set_tod (other_value);
+                    }
+                    break;
+                  default:
+                    throw Exception ("Unknown / unhandled voxel statistic in MapWriter::merge()");
+                }
+              }
+            }
+
+            // Streamline weights are summed for all types & statistics where
+            //   the counts buffer is not used to store min/max factors
+            if (counts && !(type == TOD && (voxel_statistic == V_MIN || voxel_statistic == V_MAX))) {
+              for (auto l = Loop (*counts) (*counts, *that.counts); l; ++l)
+                counts->value() += that.counts->value();
+            }
+          }
+
+
+
         template <typename value_type>
           template <class Cont>
           void MapWriter<value_type>::receive_greyscale (const Cont& in)
@@ -503,6 +591,72 @@ namespace MR {
 
 
 
+        //! Map streamlines & accumulate the results in a separate buffer per thread
+        /*! This is intended to be used as the (multi-threaded) sink of
+         * Thread::run_queue(), in place of separate mapper & writer stages.
+         * Every copy of this functor made by Thread::multi() maps streamlines
+         * using its own copy of the mapper, and writes into its own shard as
+         * obtained from MapWriterBase::make_shard(); the original instance
+         * writes directly into the writer provided. This avoids funnelling
+         * all mapped voxels through a single writer thread, at the expense of
+         * one additional image buffer per thread. Once processing has
+         * completed, merge() must be called to combine all shards into the
+         * writer, prior to calling MapWriterBase::finalise(). */
+        template <class MapperType, class SetType>
+          class ShardedMapWriter
+        { MEMALIGN(ShardedMapWriter<MapperType,SetType>)
+
+          public:
+            ShardedMapWriter (const MapperType& mapper, MapWriterBase& writer) :
+                mapper (mapper),
+                writer (writer),
+                target (&writer),
+                shared (new Shared) { }
+
+            ShardedMapWriter (const ShardedMapWriter& that) :
+                mapper (that.mapper),
+                writer (that.writer),
+                shared (that.shared)
+            {
+              std::unique_ptr<MapWriterBase> shard (writer.make_shard());
+              target = shard.get();
+              std::lock_guard<std::mutex> lock (shared->mutex);
+              shared->shards.push_back (std::move (shard));
+            }
+
+            bool operator() (Streamline<>& in) {
+              if (mapper (in, mapped))
+                return (*target) (mapped);
+              return true;
+            }
+
+            void merge () {
+              std::lock_guard<std::mutex> lock (shared->mutex);
+              for (auto& shard : shared->shards) {
+                writer.merge (*shard);
+                shard.reset();
+              }
+              shared->shards.clear();
+            }
+
+          private:
+            class Shared { NOMEMALIGN
+              public:
+                std::mutex mutex;
+                vector<std::unique_ptr<MapWriterBase>> shards;
+            };
+
+            MapperType mapper;
+            MapWriterBase& writer;
+            MapWriterBase* target;
+            std::shared_ptr<Shared> shared;
+            SetType mapped;
+        };
+
+
+
+
+
       }
     }
   }
@@ -0,0 +1,70 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/range.h"
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+      using namespace App;
+
+      const Option TrackRangeOption
+      = Option ("tck_range", "only process a contiguous range of the input streamlines, "
+                             "specified either as first:last (indices counting from zero, inclusive), "
+                             "or as n/N to process the nth of N shards of the input (counting from zero), "
+                             "each containing approximately the same number of vertices. "
+                             "This allows the processing of a large tractogram to be split across multiple jobs: "
+                             "outputs computed by summation over streamlines can then be summed across jobs, "
+                             "and per-streamline outputs concatenated in order of their ranges.")
+          + Argument ("spec").type_text();
+
+
+
+      std::pair<size_t,size_t> parse_range (const std::string& spec, size_t num_streamlines,
+                                            std::function<std::pair<size_t,size_t> (size_t, size_t)> shard)
+      {
+        try {
+          auto pos = spec.find ('/');
+          if (pos != std::string::npos) {
+            const size_t n = to<size_t> (spec.substr (0, pos));
+            const size_t num_shards = to<size_t> (spec.substr (pos+1));
+            if (!num_shards || n >= num_shards)
+              throw Exception ("shard index must be less than the number of shards");
+            return shard (n, num_shards);
+          }
+          pos = spec.find (':');
+          if (pos == std::string::npos)
+            throw Exception ("expected either first:last or n/N");
+          const size_t first = to<size_t> (spec.substr (0, pos));
+          const size_t last = to<size_t> (spec.substr (pos+1));
+          if (first > last)
+            throw Exception ("first index exceeds last index");
+          if (last >= num_streamlines)
+            throw Exception ("last index exceeds number of streamlines in file (" + str(num_streamlines) + ")");
+          return { first, last+1 };
+        }
+        catch (Exception& e) {
+          throw Exception (e, "invalid streamline range \"" + spec + "\"");
+        }
+      }
+
+    }
+  }
+}
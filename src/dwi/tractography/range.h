@@ -0,0 +1,64 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_range_h__
+#define __dwi_tractography_range_h__
+
+#include <functional>
+
+#include "app.h"
+#include "cmdline_option.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+
+namespace MR
+{
+  namespace DWI
+  {
+
+    namespace Tractography
+    {
+
+      extern const App::Option TrackRangeOption;
+
+      //! parse a range of streamlines specified as "first:last" or "n/N"
+      /*! \a shard is invoked to obtain the range corresponding to shard n of
+       * N; the range returned is [first, last). */
+      std::pair<size_t,size_t> parse_range (const std::string& spec, size_t num_streamlines,
+                                            std::function<std::pair<size_t,size_t> (size_t, size_t)> shard);
+
+
+      //! restrict \a reader to the range of streamlines requested using the -tck_range option, if any
+      /*! The "count" entry in \a properties is updated to the number of
+       * streamlines in the range. */
+      template <typename ValueType>
+        void set_range_from_option (Reader<ValueType>& reader, Properties& properties)
+        {
+          auto opt = App::get_options ("tck_range");
+          if (!opt.size())
+            return;
+          const auto range = parse_range (opt[0][0], reader.num_streamlines(),
+              [&] (size_t n, size_t num_shards) { return reader.shard (n, num_shards); });
+          reader.set_range (range.first, range.second);
+          properties["count"] = str(range.second - range.first);
+          INFO ("processing streamlines " + str(range.first) + " to " + str(range.second) + " (exclusive)");
+        }
+
+    }
+  }
+}
+
+#endif
@@ -23,7 +23,7 @@ namespace MR
     namespace Tractography
     {
 
-      thread_local Math::RNG rng;
+      thread_local Math::Philox rng;
 
     }
   }
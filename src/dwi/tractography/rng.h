@@ -27,7 +27,17 @@ namespace MR
     {
 
       //! thread-local, but globally accessible RNG to vastly simplify multi-threading
-      extern thread_local Math::RNG rng;
+      /*! this is a counter-based generator, so that it can be re-keyed cheaply
+       * for each seed when generating streamlines deterministically */
+      extern thread_local Math::Philox rng;
+
+      //! key the RNG of this thread for reproducible tracking of the seed with a given index
+      /*! generating the seed and tracking from it use distinct streams, so that
+       * each can be reproduced independently of the other, in any thread. */
+      inline void set_rng_stream (const uint32_t rng_seed, const uint64_t seed_index, const bool tracking)
+      {
+        rng.seed ((uint64_t (tracking) << 32) | rng_seed, seed_index);
+      }
 
     }
   }
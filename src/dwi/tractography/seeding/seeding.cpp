@@ -104,7 +104,16 @@ namespace MR
         + Argument ("dir").type_sequence_float()
 
       + Option ("output_seeds", "output the seed location of all successful streamlines to a file")
-        + Argument ("path").type_file_out();
+        + Argument ("path").type_file_out()
+
+      + Option ("seed_start", "start from the seed with this index, skipping all previous seeds "
+                              "(only valid with the -reproducible option). Along with the -seeds option "
+                              "(and -select 0), this allows one reproducible run to be split into jobs "
+                              "covering consecutive ranges of seeds, with the same MRTRIX_RNG_SEED value; "
+                              "concatenating their outputs in order then yields the output of the full run. "
+                              "With seeding mechanisms that provide a fixed number of seeds, the -seeds "
+                              "option then sets the number of seeds in the range.")
+        + Argument ("index").type_integer (0);
 
 
 
@@ -189,6 +198,9 @@ namespace MR
 
         opt = get_options ("output_seeds");
         if (opt.size()) properties["seed_output"] = std::string (opt[0][0]);
+
+        opt = get_options ("seed_start");
+        if (opt.size()) properties["seed_start"] = str<uint64_t> (opt[0][0]);
       }
 
 
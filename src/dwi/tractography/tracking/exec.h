@@ -20,12 +20,14 @@
 
 #include "thread.h"
 #include "thread_queue.h"
+#include "ordered_thread_queue.h"
 #include "dwi/directions/set.h"
 #include "dwi/tractography/streamline.h"
 #include "dwi/tractography/rng.h"
 #include "dwi/tractography/roi.h"
 #include "dwi/tractography/tracking/generated_track.h"
 #include "dwi/tractography/tracking/method.h"
+#include "dwi/tractography/tracking/seed_generator.h"
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/write_kernel.h"
 
@@ -36,8 +38,6 @@
 #include "dwi/tractography/seeding/dynamic.h"
 
 
-#define MAX_NUM_SEED_ATTEMPTS 100000
-
 #define TRACKING_BATCH_SIZE 10
 
 
@@ -66,7 +66,16 @@ namespace MR
                 typename Method::Shared shared (diff_path, properties);
                 WriteKernel writer (shared, destination, properties);
                 Exec<Method> tracker (shared);
-                Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE), writer);
+                if (shared.reproducible) {
+                  SeedGenerator seeds (shared);
+                  Thread::run_ordered_queue (seeds,
+                                             Thread::batch (TrackSeed(), TRACKING_BATCH_SIZE),
+                                             Thread::multi (tracker),
+                                             Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE),
+                                             writer);
+                } else {
+                  Thread::run_queue (Thread::multi (tracker), Thread::batch (GeneratedTrack(), TRACKING_BATCH_SIZE), writer);
+                }
 
               } else {
 
@@ -126,10 +135,40 @@ namespace MR
             bool operator() (GeneratedTrack& item) {
               if (!seed_track (item))
                 return false;
+              track (item);
+              return true;
+            }
+
+
+            // Reproducible tracking: the seed is provided, and the RNG is keyed by its index
+            bool operator() (const TrackSeed& seed, GeneratedTrack& item) {
+              set_rng_stream (S.rng_seed, seed.index, true);
+              tck_init (item);
+              method.pos = seed.pos;
+              method.dir = seed.dir;
+              if (!(method.check_seed() && method.init())) {
+                track_excluded = true;
+                item.set_status (GeneratedTrack::status_t::SEED_REJECTED);
+              }
+              track (item);
+              return true;
+            }
+
+
+          private:
+
+            const typename Method::Shared& S;
+            Method method;
+            bool track_excluded;
+            IncludeROIVisitation include_visitation;
+
+
+            void track (GeneratedTrack& item)
+            {
               if (track_excluded) {
                 item.set_status (GeneratedTrack::status_t::SEED_REJECTED);
                 S.add_rejection (INVALID_SEED);
-                return true;
+                return;
               }
               gen_track (item);
               if (track_rejected (item)) {
@@ -141,18 +180,9 @@ namespace MR
               } else {
                 item.set_status (GeneratedTrack::status_t::ACCEPTED);
               }
-              return true;
             }
 
 
-          private:
-
-            const typename Method::Shared& S;
-            Method method;
-            bool track_excluded;
-            IncludeROIVisitation include_visitation;
-
-
             term_t iterate ()
             {
               const term_t method_term = (S.rk4 ? next_rk4() : method.next());
@@ -185,11 +215,18 @@ namespace MR
 
 
 
-            bool seed_track (GeneratedTrack& tck)
+            void tck_init (GeneratedTrack& tck)
             {
               tck.clear();
               track_excluded = false;
               include_visitation.reset();
+            }
+
+
+
+            bool seed_track (GeneratedTrack& tck)
+            {
+              tck_init (tck);
               method.dir = { NaN, NaN, NaN };
 
               if (S.properties.seeds.is_finite()) {
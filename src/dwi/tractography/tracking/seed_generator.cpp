@@ -0,0 +1,88 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#include "dwi/tractography/tracking/seed_generator.h"
+
+#include "dwi/tractography/rng.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        SeedGenerator::SeedGenerator (const SharedBase& shared) :
+            S (shared),
+            index (0),
+            end (0)
+        {
+          assert (S.reproducible);
+          const auto p = S.properties.find ("seed_start");
+          if (p != S.properties.end())
+            index = to<uint64_t> (p->second);
+          end = index + S.max_num_seeds;
+
+          // Seeding mechanisms with a fixed number of seeds can only be skipped by generating them;
+          //   otherwise, each seed is independent of those preceding it
+          if (S.properties.seeds.is_finite()) {
+            Eigen::Vector3f pos, dir;
+            for (uint64_t i = 0; i != index; ++i) {
+              set_rng_stream (S.rng_seed, i, false);
+              if (!get_seed (pos, dir))
+                throw Exception ("Seed index provided by -seed_start option exceeds the number of seeds available");
+            }
+          }
+        }
+
+
+
+        bool SeedGenerator::operator() (TrackSeed& seed)
+        {
+          if (S.max_num_seeds && index == end)
+            return false;
+          set_rng_stream (S.rng_seed, index, false);
+          seed.index = index++;
+          return get_seed (seed.pos, seed.dir);
+        }
+
+
+
+        bool SeedGenerator::get_seed (Eigen::Vector3f& pos, Eigen::Vector3f& dir) const
+        {
+          dir = { NaN, NaN, NaN };
+          if (S.properties.seeds.is_finite())
+            return S.properties.seeds.get_seed (pos, dir);
+          for (size_t num_attempts = 0; num_attempts != MAX_NUM_SEED_ATTEMPTS; ++num_attempts) {
+            if (S.properties.seeds.get_seed (pos, dir))
+              return true;
+          }
+          FAIL ("Failed to find suitable seed point after " + str (MAX_NUM_SEED_ATTEMPTS) + " attempts - aborting");
+          return false;
+        }
+
+
+
+      }
+    }
+  }
+}
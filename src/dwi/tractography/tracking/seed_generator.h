@@ -0,0 +1,81 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#ifndef __dwi_tractography_tracking_seed_generator_h__
+#define __dwi_tractography_tracking_seed_generator_h__
+
+
+#include "types.h"
+
+#include "dwi/tractography/tracking/shared.h"
+
+
+#define MAX_NUM_SEED_ATTEMPTS 100000
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        //! a seed point & direction, along with its index in the sequence of seeds
+        class TrackSeed
+        { MEMALIGN(TrackSeed)
+          public:
+            TrackSeed () : index (0), pos ({ NaN, NaN, NaN }), dir ({ NaN, NaN, NaN }) { }
+            uint64_t index;
+            Eigen::Vector3f pos, dir;
+        };
+
+
+
+        //! generate the sequence of seeds for reproducible tracking
+        /*! Each seed is drawn using its own stream of the tractography RNG (see
+         * set_rng_stream()), so that it depends only on the RNG seed and its
+         * index in the sequence. Seeding mechanisms that provide a fixed number
+         * of seeds hold their position in the sequence as internal state, so
+         * this must run as a single-threaded source; tracking from the seeds can
+         * then proceed in parallel, with the output restored to seed order using
+         * Thread::run_ordered_queue(). */
+        class SeedGenerator
+        { MEMALIGN(SeedGenerator)
+          public:
+            SeedGenerator (const SharedBase& shared);
+
+            bool operator() (TrackSeed&);
+
+          private:
+            const SharedBase& S;
+            uint64_t index, end;
+
+            bool get_seed (Eigen::Vector3f& pos, Eigen::Vector3f& dir) const;
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
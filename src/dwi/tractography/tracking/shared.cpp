@@ -16,6 +16,8 @@
 
 #include "dwi/tractography/tracking/shared.h"
 
+#include "math/rng.h"
+
 
 namespace MR
 {
@@ -50,6 +52,8 @@ namespace MR
             rk4 (false),
             stop_on_all_include (false),
             implicit_max_num_seeds (properties.find ("max_num_seeds") == properties.end()),
+            reproducible (false),
+            rng_seed (0),
             downsampler (1)
 #ifdef DEBUG_TERMINATIONS
           , debug_header (Header::open (properties.find ("act") == properties.end() ? diff_path : properties["act"])),
@@ -64,6 +68,12 @@ namespace MR
           properties.set (rk4, "rk4");
           properties.set (stop_on_all_include, "stop_on_all_include");
 
+          if (properties.find ("reproducible") != properties.end()) {
+            properties.set (reproducible, "reproducible");
+            rng_seed = Math::RNG::initial_seed();
+            properties.set (rng_seed, "rng_seed");
+          }
+
           properties["source"] = source_header.name();
 
           max_num_seeds = Defaults::seed_to_select_ratio * max_num_tracks;
@@ -289,6 +299,23 @@ namespace MR
 
 
 
+        void SharedBase::init_sh_lookup (Math::SH::PrecomputedBasis<float>& lookup, const size_t lmax) const
+        {
+          const auto it = properties.find ("sh_lookup");
+          if (it == properties.end())
+            return;
+          const float angle = to<float> (it->second);
+          lookup.init (lmax, angle * Math::pi / 180.0);
+          INFO ("SH basis lookup table uses " + str(lookup.resolution()) + "x" + str(lookup.resolution())
+                + " cells per cube face (" + str(lookup.bytes() / 1048576.0, 3) + " MB), "
+                + "with maximum amplitude error " + str(100.0 * lookup.max_error(), 3) + "% of peak amplitude");
+          if (lookup.max_error() > 0.01)
+            WARN ("SH basis lookup table angular spacing of " + str(angle) + " degrees results in amplitude errors of up to "
+                  + str(100.0 * lookup.max_error(), 3) + "% for lmax=" + str(lmax) + "; consider using a finer spacing");
+        }
+
+
+
 #ifdef DEBUG_TERMINATIONS
         void SharedBase::add_termination (const term_t i, const Eigen::Vector3f& p) const
         {
@@ -22,6 +22,7 @@
 #include "header.h"
 #include "image.h"
 #include "memory.h"
+#include "math/SH.h"
 #include "transform.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/roi.h"
@@ -68,7 +69,8 @@ namespace MR
             float max_angle_1o, max_angle_ho, cos_max_angle_1o, cos_max_angle_ho;
             float step_size, min_radius, threshold, init_threshold;
             size_t max_seed_attempts;
-            bool unidirectional, rk4, stop_on_all_include, implicit_max_num_seeds;
+            bool unidirectional, rk4, stop_on_all_include, implicit_max_num_seeds, reproducible;
+            uint32_t rng_seed;
             DWI::Tractography::Resampling::Downsampler downsampler;
 
             // Additional members for ACT
@@ -84,6 +86,7 @@ namespace MR
             void set_num_points();
             void set_num_points (const float angle_minradius_preds, const float max_step_postds);
             void set_cutoff (float cutoff);
+            void init_sh_lookup (Math::SH::PrecomputedBasis<float>& lookup, const size_t lmax) const;
 
             // This gets overloaded for iFOD2, as each sample is output rather than just each step, and there are
             //   multiple samples per step
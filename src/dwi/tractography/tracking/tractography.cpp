@@ -88,6 +88,15 @@ namespace MR
             "do NOT pre-compute legendre polynomial values. Warning: "
             "this will slow down the algorithm by a factor of approximately 4.")
 
+      + Option ("sh_lookup",
+            "evaluate FOD amplitudes using a lookup table of the full spherical harmonic "
+            "basis, with the specified maximal angular spacing (in degrees) between table "
+            "entries (only used for iFOD1 / iFOD2 / SD_Stream). This avoids most of the "
+            "trigonometric computations otherwise involved, at the expense of some memory "
+            "(a few MB for lmax=8 at the suggested spacing of 1 degree) and a minor loss of "
+            "accuracy, which is reported when running with -info.")
+          + Argument ("angle").type_float (0.5, 10.0)
+
       + Option ("rk4", "use 4th-order Runge-Kutta integration "
                        "(slower, but eliminates curvature overshoot in 1st-order deterministic methods)")
 
@@ -95,7 +104,15 @@ namespace MR
 
       + Option ("downsample", "downsample the generated streamlines to reduce output file size "
                               "(default is (samples-1) for iFOD2, no downsampling for all other algorithms)")
-          + Argument ("factor").type_integer (1);
+          + Argument ("factor").type_integer (1)
+
+      + Option ("reproducible", "generate exactly the same streamlines irrespective of the number of threads. "
+                                "Each seed is drawn from, and tracked using, its own random number stream, "
+                                "determined by the index of the seed and by the random number generator seed "
+                                "(stored in the output file as the \"rng_seed\" property, and set using the "
+                                "MRTRIX_RNG_SEED environment variable); streamlines are then written in the "
+                                "order of their seeds. Tracking remains fully multi-threaded, but seed points "
+                                "are generated in a single thread. Not compatible with dynamic seeding.");
 
 
       /**
@@ -135,6 +152,9 @@ namespace MR
         opt = get_options ("noprecomputed");
         if (opt.size()) properties["sh_precomputed"] = "0";
 
+        opt = get_options ("sh_lookup");
+        if (opt.size()) properties["sh_lookup"] = str<default_type> (opt[0][0]);
+
         opt = get_options ("rk4");
         if (opt.size()) properties["rk4"] = "1";
 
@@ -151,6 +171,9 @@ namespace MR
         opt = get_options ("downsample");
         if (opt.size()) properties["downsample_factor"] = str<unsigned int> (opt[0][0]);
 
+        opt = get_options ("reproducible");
+        if (opt.size()) properties["reproducible"] = "1";
+
         opt = get_options ("grad");
         if (opt.size()) properties["DW_scheme"] = std::string (opt[0][0]);
 
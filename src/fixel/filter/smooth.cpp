@@ -104,24 +104,6 @@ namespace MR
           throw Exception ("Size of fixel data file \"" + input.name() + "\" (" + str(input.size(0)) +
                            ") does not match fixel connectivity matrix (" + str(matrix.size()) + ")");
 
-        class Source
-        { NOMEMALIGN
-          public:
-            Source (const size_t N) :
-                number (N),
-                counter (0) { }
-            bool operator() (size_t& fixel)
-            {
-              if ((fixel = counter) == number)
-                return false;
-              ++counter;
-              return true;
-            }
-          private:
-            const size_t number;
-            size_t counter;
-        };
-
         class Worker
         { MEMALIGN(Worker)
           public:
@@ -174,7 +156,7 @@ namespace MR
             Image<bool> mask;
         };
 
-        Thread::run_queue (Source (input.size (0)),
+        Thread::run_queue (Thread::IndexSource (input.size (0)),
                            Thread::batch (size_t()),
                            Thread::multi (Worker (*this, input, output)));
 
@@ -451,6 +451,81 @@ namespace MR
 
 
 
+      CSR::CSR (const Reader& reader, const connectivity_value_type C) :
+          offsets (reader.size(), 0),
+          counts (reader.size(), 0),
+          fixel_data (nullptr),
+          value_data (nullptr),
+          mask (reader.size(), true),
+          norm_multipliers (reader.size(), connectivity_value_type(0))
+      {
+        Image<index_image_type> index (reader.index_image);
+        Image<bool> mask_image (reader.mask_image);
+        if (mask_image.valid()) {
+          for (size_t fixel = 0; fixel != size(); ++fixel) {
+            mask_image.index (0) = fixel;
+            mask[fixel] = mask_image.value();
+          }
+        }
+        for (size_t fixel = 0; fixel != size(); ++fixel) {
+          if (!mask[fixel])
+            continue;
+          index.index (0) = fixel;
+          index.index (3) = 0; counts[fixel] = index.value();
+          index.index (3) = 1; offsets[fixel] = index.value();
+        }
+
+        try {
+          // Direct IO will only result in the data being loaded into RAM if
+          //   these images cannot be accessed directly via memory-mapping
+          fixel_image = Image<fixel_index_type>::open (Path::join (reader.directory, "fixels.mif")).with_direct_io();
+          value_image = Image<connectivity_value_type>::open (Path::join (reader.directory, "values.mif")).with_direct_io();
+        } catch (Exception& e) {
+          throw Exception (e, "Unable to load path \"" + reader.directory + "\" as fixel-fixel connectivity data");
+        }
+        fixel_data = fixel_image.address();
+        value_data = value_image.address();
+
+        if (C != connectivity_value_type(1)) {
+          exponentiated_values.resize (value_image.size (0));
+          for (size_t i = 0; i != exponentiated_values.size(); ++i)
+            exponentiated_values[i] = std::pow (value_data[i], C);
+          value_data = exponentiated_values.data();
+          // Mapping of the original values is no longer required
+          value_image = Image<connectivity_value_type>();
+        }
+
+        // Sums are computed in the same precision as in Reader::operator[] (C == 1)
+        //   and Stats::CFE prior to the pre-computation of exponentiated values (C != 1)
+        for (size_t fixel = 0; fixel != size(); ++fixel) {
+          if (!mask[fixel])
+            continue;
+          const fixel_index_type* f = fixels (fixel);
+          const connectivity_value_type* v = values (fixel);
+          if (C == connectivity_value_type(1)) {
+            connectivity_value_type sum (0);
+            for (index_image_type i = 0; i != counts[fixel]; ++i) {
+              if (mask[f[i]])
+                sum += v[i];
+            }
+            norm_multipliers[fixel] = sum ? (connectivity_value_type(1) / sum) : connectivity_value_type(0);
+          } else {
+            default_type sum (0.0);
+            for (index_image_type i = 0; i != counts[fixel]; ++i) {
+              if (mask[f[i]])
+                sum += v[i];
+            }
+            norm_multipliers[fixel] = connectivity_value_type(sum) ? (connectivity_value_type(1) / connectivity_value_type(sum)) : connectivity_value_type(0);
+          }
+        }
+      }
+
+
+
+
+
+
+
 
     }
   }
@@ -22,6 +22,7 @@
 #include "types.h"
 #include "file/ofstream.h"
 #include "fixel/index_remapper.h"
+#include "misc/bitset.h"
 
 namespace MR
 {
@@ -226,6 +227,50 @@ namespace MR
           Image<connectivity_value_type> value_image;
           Image<bool> mask_image;
 
+          friend class CSR;
+      };
+
+
+
+      // Direct access to the fixel-fixel connectivity matrix in compressed
+      //   sparse row form, for use in performance-critical code
+      // Fixel indices and connectivity values are read directly from the
+      //   memory-mapped files wherever possible; multiple processes using the
+      //   same matrix therefore share a single copy within the page cache.
+      //   Connectivity values are only duplicated in memory if they need to be
+      //   raised to some power C.
+      // The multiplicative factor required for normalisation of each fixel's
+      //   connectivity is pre-computed; this is zero for fixels outside of the mask.
+      class CSR
+      { MEMALIGN(CSR)
+
+        public:
+          CSR (const Reader& reader, const connectivity_value_type C = connectivity_value_type(1));
+          // Copying would invalidate the pointer to any exponentiated values
+          CSR (const CSR&) = delete;
+
+          size_t size() const { return offsets.size(); }
+
+          // Fixel-fixel connections for a particular fixel; note that
+          //   connections to fixels outside of the mask are not omitted
+          //   from these arrays, and must be excluded using included()
+          index_image_type size (const size_t fixel) const { return counts[fixel]; }
+          const fixel_index_type* fixels (const size_t fixel) const { return fixel_data + offsets[fixel]; }
+          const connectivity_value_type* values (const size_t fixel) const { return value_data + offsets[fixel]; }
+
+          bool included (const size_t fixel) const { return mask[fixel]; }
+          connectivity_value_type norm_multiplier (const size_t fixel) const { return norm_multipliers[fixel]; }
+
+        protected:
+          vector<index_image_type> offsets, counts;
+          // Images are retained in order to keep the memory mappings alive
+          Image<fixel_index_type> fixel_image;
+          Image<connectivity_value_type> value_image;
+          vector<connectivity_value_type> exponentiated_values;
+          const fixel_index_type* fixel_data;
+          const connectivity_value_type* value_data;
+          BitSet mask;
+          vector<connectivity_value_type> norm_multipliers;
 
       };
 
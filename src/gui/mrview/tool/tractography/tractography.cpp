@@ -359,7 +359,7 @@ namespace MR
         void Tractography::tractogram_open_slot ()
         {
 
-          vector<std::string> list = Dialog::File::get_files (this, "Select tractograms to open", "Tractograms (*.tck)", &current_folder);
+          vector<std::string> list = Dialog::File::get_files (this, "Select tractograms to open", "Tractograms (*.tck *.tckz)", &current_folder);
           add_tractogram(list);
         }
 
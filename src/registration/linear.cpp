@@ -192,8 +192,6 @@ namespace MR
         "or to change the cost function optimiser during registration (without the need to repeatedly resize the images). (Default: 1 == no repetition)")
         + Argument ("num or comma separated list").type_sequence_int ()
 
-      // TODO linstage.loop_density
-
       // TODO linstage.robust: Start each stage repetition with the estimated parameters from the previous stage.
       // choose parameter consensus criterion: maximum overlap, min cost
 
@@ -263,8 +261,14 @@ namespace MR
                                   "Default: l2")
         + Argument ("type").type_choice (linear_robust_estimator_choices)
 
-      // + Option ("rigid_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic) (Default: 1.0)")
-      //   + Argument ("num").type_sequence_float () // TODO
+      + Option ("rigid_loop_density", "the fraction of midway image voxels sampled at each gradient descent iteration, "
+                                     "from 1.0 (all voxels) down towards 0.0 (maximally stochastic). A new sample is drawn for each "
+                                     "iteration by dividing each row of the midway image grid into blocks of 1/density voxels and drawing "
+                                     "one voxel at random from each; voxels outside the masks are then discarded, so the sample is not "
+                                     "stratified with respect to the masks. This can be specified either as a single number for all "
+                                     "multi-resolution levels, or a single value for each level. The convergence check is relaxed in "
+                                     "proportion to the expected sampling noise. (Default: 1.0)")
+        + Argument ("num").type_sequence_float ()
 
       // + Option ("rigid_repetitions", " ")
       //   + Argument ("num").type_sequence_int () // TODO
@@ -331,8 +335,14 @@ namespace MR
                                   "Default: l2")
         + Argument ("type").type_choice (linear_robust_estimator_choices)
 
-      // + Option ("affine_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic) (Default: 1.0)")
-      //   + Argument ("num").type_sequence_float () // TODO
+      + Option ("affine_loop_density", "the fraction of midway image voxels sampled at each gradient descent iteration, "
+                                     "from 1.0 (all voxels) down towards 0.0 (maximally stochastic). A new sample is drawn for each "
+                                     "iteration by dividing each row of the midway image grid into blocks of 1/density voxels and drawing "
+                                     "one voxel at random from each; voxels outside the masks are then discarded, so the sample is not "
+                                     "stratified with respect to the masks. This can be specified either as a single number for all "
+                                     "multi-resolution levels, or a single value for each level. The convergence check is relaxed in "
+                                     "proportion to the expected sampling noise. (Default: 1.0)")
+        + Argument ("num").type_sequence_float ()
 
       // + Option ("affine_repetitions", " ")
       //   + Argument ("num").type_sequence_int () // TODO
@@ -212,8 +212,8 @@ namespace MR
 
         void set_loop_density (const vector<default_type>& loop_density_){
           for (size_t d = 0; d < loop_density_.size(); ++d)
-            if (loop_density_[d] < 0.0 or loop_density_[d] > 1.0 )
-              throw Exception ("loop density must be between 0.0 and 1.0");
+            if (loop_density_[d] <= 0.0 or loop_density_[d] > 1.0 )
+              throw Exception ("loop density must be greater than 0.0 and at most 1.0");
           if (loop_density_.size() == stages.size()) {
             for (size_t i = 0; i < stages.size (); ++i)
               stages[i].loop_density = loop_density_[i];
@@ -221,7 +221,7 @@ namespace MR
             for (size_t i = 0; i < stages.size (); ++i)
               stages[i].loop_density = loop_density_[0];
           } else
-            throw Exception ("the lmax must be defined for all stages (1 or " + str(stages.size())+")");
+            throw Exception ("the loop density must be defined for all stages (1 or " + str(stages.size())+")");
         }
 
         void set_diagnostics_image_prefix (const std::basic_string<char>& diagnostics_image_prefix) {
@@ -431,7 +431,20 @@ namespace MR
               Header midway_resized (midway_resize_filter);
 
               ParamType parameters (transform, im1_smoothed, im2_smoothed, midway_resized, im1_mask, im2_mask);
-              parameters.loop_density = stage.loop_density;
+              // ensure a minimum number of sampled voxels, so that the density adapts to coarse resolution levels
+              default_type loop_density = stage.loop_density;
+              if (loop_density < 1.0) {
+                //CONF option: RegStochasticMinVoxels
+                //CONF default: 20000
+                //CONF Linear registration: minimum number of midway image voxels sampled per gradient descent
+                //CONF iteration when using stochastic gradient descent (-rigid_loop_density, -affine_loop_density).
+                //CONF The sampling density of each stage is increased as required.
+                const default_type min_voxels = std::max (default_type (1.0), default_type (File::Config::get_float ("RegStochasticMinVoxels", 20000)));
+                loop_density = std::min (1.0, std::max (loop_density, min_voxels / voxel_count (midway_resized, 0, 3)));
+                if (loop_density < 1.0)
+                  INFO ("sampling " + str(loop_density, 3) + " of midway image voxels per iteration");
+              }
+              parameters.loop_density = loop_density;
               if (contrasts.size())
                 parameters.set_mc_settings (stage_contrasts);
 
@@ -499,6 +512,11 @@ namespace MR
               //CONF Linear registration: minimum number of iterations until convergence check is activated.
               size_t min_iter (MR::File::Config::get_float ("RegGdConvergenceMinIter", 10));
               transform.get_gradient_descent_updator()->set_convergence_check (slope_threshold, alpha, beta, buffer_len, min_iter);
+              //CONF option: RegStochasticRefine
+              //CONF default: 0 (false)
+              //CONF Linear registration: when using stochastic gradient descent, continue each
+              //CONF registration stage at full sampling density once the stochastic estimate has converged.
+              const bool stochastic_refine = File::Config::get_bool ("RegStochasticRefine", false);
 
               Metric::Evaluate<MetricType, ParamType> evaluate (metric, parameters);
               if (do_reorientation && stage.fod_lmax > 0)
@@ -506,24 +524,37 @@ namespace MR
 
               INFO ("registration stage running...");
               for (auto stage_iter = 1U; stage_iter <= stage.stage_iterations; ++stage_iter) {
-                if (stage.gd_max_iter > 0 and stage.optimisers[stage_iter - 1] == OptimiserAlgoType::bbgd) {
-                  Math::GradientDescentBB<Metric::Evaluate<MetricType, ParamType>, typename TransformType::UpdateType>
-                  optim (evaluate, *transform.get_gradient_descent_updator());
-                  optim.be_verbose (analyse_descent);
-                  optim.precondition (optimiser_weights);
-                  optim.run (stage.gd_max_iter, grad_tolerance, analyse_descent ? std::cout.rdbuf() : log_stream);
-                  parameters.optimiser_update (optim, evaluate.overlap());
-                  INFO ("    iteration: "+str(stage_iter)+"/"+str(stage.stage_iterations)+" GD iterations: "+
-                  str(optim.function_evaluations())+" cost: "+str(optim.value())+" overlap: "+str(evaluate.overlap()));
-                } else if (stage.gd_max_iter > 0) {
-                  Math::GradientDescent<Metric::Evaluate<MetricType, ParamType>, typename TransformType::UpdateType>
+                if (loop_density < 1.0) {
+                  // the sampling noise in the parameter trajectories scales with 1/sqrt(sample size)
+                  evaluate.set_loop_density (loop_density);
+                  transform.get_gradient_descent_updator()->set_convergence_check (slope_threshold / std::sqrt (loop_density), alpha, beta, buffer_len, min_iter);
+                }
+                while (true) {
+                  if (stage.gd_max_iter > 0 and stage.optimisers[stage_iter - 1] == OptimiserAlgoType::bbgd) {
+                    Math::GradientDescentBB<Metric::Evaluate<MetricType, ParamType>, typename TransformType::UpdateType>
                     optim (evaluate, *transform.get_gradient_descent_updator());
-                  optim.be_verbose (analyse_descent);
-                  optim.precondition (optimiser_weights);
-                  optim.run (stage.gd_max_iter, grad_tolerance, analyse_descent ? std::cout.rdbuf() : log_stream);
-                  parameters.optimiser_update (optim, evaluate.overlap());
-                  INFO ("    iteration: "+str(stage_iter)+"/"+str(stage.stage_iterations)+" GD iterations: "+
-                  str(optim.function_evaluations())+" cost: "+str(optim.value())+" overlap: "+str(evaluate.overlap()));
+                    optim.be_verbose (analyse_descent);
+                    optim.precondition (optimiser_weights);
+                    optim.run (stage.gd_max_iter, grad_tolerance, analyse_descent ? std::cout.rdbuf() : log_stream);
+                    parameters.optimiser_update (optim, evaluate.overlap());
+                    INFO ("    iteration: "+str(stage_iter)+"/"+str(stage.stage_iterations)+" GD iterations: "+
+                    str(optim.function_evaluations())+" cost: "+str(optim.value())+" overlap: "+str(evaluate.overlap()));
+                  } else if (stage.gd_max_iter > 0) {
+                    Math::GradientDescent<Metric::Evaluate<MetricType, ParamType>, typename TransformType::UpdateType>
+                      optim (evaluate, *transform.get_gradient_descent_updator());
+                    optim.be_verbose (analyse_descent);
+                    optim.precondition (optimiser_weights);
+                    optim.run (stage.gd_max_iter, grad_tolerance, analyse_descent ? std::cout.rdbuf() : log_stream);
+                    parameters.optimiser_update (optim, evaluate.overlap());
+                    INFO ("    iteration: "+str(stage_iter)+"/"+str(stage.stage_iterations)+" GD iterations: "+
+                    str(optim.function_evaluations())+" cost: "+str(optim.value())+" overlap: "+str(evaluate.overlap()));
+                  }
+
+                  if (evaluate.loop_density() == 1.0 || !stochastic_refine)
+                    break;
+                  INFO ("    refining stochastic estimate at full sampling density");
+                  evaluate.set_loop_density (1.0);
+                  transform.get_gradient_descent_updator()->set_convergence_check (slope_threshold, alpha, beta, buffer_len, min_iter);
                 }
 
                 if (log_stream) {
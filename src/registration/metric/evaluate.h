@@ -22,6 +22,7 @@
 #include "algo/loop.h"
 #include "registration/transform/reorient.h"
 #include "image.h"
+#include "math/rng.h"
 
 namespace MR
 {
@@ -72,7 +73,9 @@ namespace MR
             Evaluate (const MetricType& metric_, ParamType& parameters, typename metric_requires_initialisation<U>::yes = 0) :
               metric (metric_),
               params (parameters),
-              iteration (1) {
+              iteration (1),
+              sample (0),
+              sample_seed (Math::RNG::get_seed()) {
                 // update number of volumes
                 metric.init (parameters.im1_image, parameters.im2_image);
                 metric.set_weights(params.get_weights());
@@ -82,7 +85,9 @@ namespace MR
             Evaluate (const MetricType& metric_, ParamType& parameters, typename metric_requires_initialisation<U>::no = 0) :
               metric (metric_),
               params (parameters),
-              iteration (1) { metric.set_weights(params.get_weights()); }
+              iteration (1),
+              sample (0),
+              sample_seed (Math::RNG::get_seed()) { metric.set_weights(params.get_weights()); }
 
             //  metric_requires_precompute<U>::yes: operator() loops over processed_image instead of midway_image
             template <class U = MetricType>
@@ -199,13 +204,12 @@ namespace MR
               // estimate (params.transformation, metric, params, overall_cost_function, gradient, x, &overlap_count);
               if (params.loop_density < 1.0) {
                 DEBUG ("stochastic gradient descent, density: " + str(params.loop_density));
-                Math::RNG rng;
-                gradient.setZero();
-                auto loop = ThreadedLoop (params.midway_image, 0, 3, 2);
                 overlap_count = 0;
-                StochasticThreadKernel <MetricType, ParamType> functor (loop.inner_axes, params.loop_density, metric, params, overall_cost_function, gradient, rng, &overlap_count);
+                ThreadKernel <MetricType, ParamType> kernel (metric, params, overall_cost_function, gradient, &overlap_count);
                 {
                   LogLevelLatch log_level (0);
+                  auto loop = ThreadedLoop (params.midway_image, 0, 3);
+                  StochasticThreadKernel<MetricType, ParamType> functor (kernel, loop.inner_axes[0], params.loop_density, sample_seed + uint32_t (sample));
                   loop.run_outer (functor);
                 }
               } else {
@@ -222,7 +226,9 @@ namespace MR
                   }
                 } else {
                   LogLevelLatch log_level (0);
-                  ThreadedLoop (params.midway_image, 0, 3).run (kernel);
+                  auto loop = ThreadedLoop (params.midway_image, 0, 3);
+                  RowThreadKernel<MetricType, ParamType> row_kernel (kernel, loop.inner_axes[0]);
+                  loop.run_outer (row_kernel);
                 }
               }
 
@@ -251,11 +257,32 @@ namespace MR
               directions = dir;
             }
 
+            //! fraction of the midway image voxels sampled per evaluation, see StochasticThreadKernel
+            void set_loop_density (const default_type density) {
+              params.loop_density = density;
+            }
+
+            default_type loop_density () const {
+              return params.loop_density;
+            }
+
+            //! draw a new sample of voxels for subsequent evaluations
+            /*! This is invoked by the optimiser at the start of each
+             * iteration, such that all evaluations within an iteration use
+             * the same sample. Returns false if all voxels are evaluated. */
+            bool new_sample () {
+              if (params.loop_density >= 1.0)
+                return false;
+              ++sample;
+              return true;
+            }
+
           protected:
             MetricType metric;
             ParamType params;
             vector<size_t> extent;
-            size_t iteration;
+            size_t iteration, sample;
+            const uint32_t sample_seed;
             Eigen::MatrixXd directions;
             ssize_t overlap_count;
 
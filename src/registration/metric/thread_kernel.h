@@ -169,6 +169,94 @@ namespace MR
           }
 
 
+          //! evaluate the metric over the row of voxels along \a axis through \a iter
+          /*! the midway, image 1 and image 2 positions of the whole row are
+           * computed up front as 3xN matrix products, and both images are
+           * sampled directly in voxel space, rather than transforming each
+           * point in turn. The per-voxel mask tests and metric evaluation are
+           * as for operator(). */
+          template <class U = MetricType>
+          void row (const Iterator& iter, const size_t axis,
+              typename is_neighbourhood_metric<U>::no = 0,
+              typename use_processed_image<U>::no = 0,
+              typename cost_is_vector<U>::no = 0,
+              typename is_asymmetric<U>::no = 0) {
+
+            const ssize_t n = iter.size (axis);
+            Eigen::Vector3d voxel_pos ((default_type)iter.index(0), (default_type)iter.index(1), (default_type)iter.index(2));
+            voxel_pos[axis] = 0.0;
+
+            midway_points.noalias() = voxel2scanner.linear().col (axis) * Eigen::RowVectorXd::LinSpaced (n, 0.0, default_type(n-1));
+            midway_points.colwise() += voxel2scanner * voxel_pos;
+
+            const auto half = params.transformation.get_transform_half();
+            const auto half_inverse = params.transformation.get_transform_half_inverse();
+            im1_points.noalias() = half.linear() * midway_points;
+            im1_points.colwise() += half.translation();
+            im2_points.noalias() = half_inverse.linear() * midway_points;
+            im2_points.colwise() += half_inverse.translation();
+
+            im1_voxels.noalias() = params.im1_image_interp->scanner2voxel.linear() * im1_points;
+            im1_voxels.colwise() += params.im1_image_interp->scanner2voxel.translation();
+            im2_voxels.noalias() = params.im2_image_interp->scanner2voxel.linear() * im2_points;
+            im2_voxels.colwise() += params.im2_image_interp->scanner2voxel.translation();
+
+            for (ssize_t i = 0; i < n; ++i) {
+              const Eigen::Vector3d im2_point (im2_points.col(i));
+              if (params.im2_mask_interp) {
+                params.im2_mask_interp->scanner (im2_point);
+                if (params.im2_mask_interp->value() < 0.5)
+                  continue;
+              }
+              if (params.robust_estimate_use_score && params.robust_estimate_score2_interp) {
+                params.robust_estimate_score2_interp->scanner (im2_point);
+                if (!(params.robust_estimate_score2_interp->value() >= 0.5))
+                  continue;
+              }
+
+              const Eigen::Vector3d im1_point (im1_points.col(i));
+              if (params.im1_mask_interp) {
+                params.im1_mask_interp->scanner (im1_point);
+                if (params.im1_mask_interp->value() < 0.5)
+                  continue;
+              }
+              if (params.robust_estimate_use_score && params.robust_estimate_score1_interp) {
+                params.robust_estimate_score1_interp->scanner (im1_point);
+                if (!(params.robust_estimate_score1_interp->value() >= 0.5))
+                  continue;
+              }
+
+              params.im1_image_interp->voxel (im1_voxels.col(i));
+              if (!(*params.im1_image_interp))
+                continue;
+
+              params.im2_image_interp->voxel (im2_voxels.col(i));
+              if (!(*params.im2_image_interp))
+                continue;
+
+              ++cnt;
+              cost_function(0) += metric (params, im1_point, im2_point, Eigen::Vector3d (midway_points.col(i)), gradient);
+            }
+          }
+
+          template <class U = MetricType>
+          void row (const Iterator& iter, const size_t axis,
+              typename is_neighbourhood_metric<U>::no = 0,
+              typename use_processed_image<U>::no = 0,
+              typename cost_is_vector<U>::no = 0,
+              typename is_asymmetric<U>::yes = 0) {
+            row_voxelwise (iter, axis);
+          }
+
+          template <class U = MetricType>
+          void row (const Iterator& iter, const size_t axis,
+              typename is_neighbourhood_metric<U>::no = 0,
+              typename use_processed_image<U>::no = 0,
+              typename cost_is_vector<U>::yes = 0,
+              typename is_asymmetric<U>::no = 0) {
+            row_voxelwise (iter, axis);
+          }
+
           template <class U = MetricType>
           void operator() (const Iterator& iter,
               typename is_neighbourhood_metric<U>::no = 0,
@@ -317,6 +405,12 @@ namespace MR
             MetricType metric;
             ParamType params;
 
+            void row_voxelwise (const Iterator& iter, const size_t axis) {
+              Iterator pos (iter);
+              for (pos.index(axis) = 0; pos.index(axis) < pos.size(axis); ++pos.index(axis))
+                (*this) (pos);
+            }
+
             Eigen::VectorXd cost_function;
             ssize_t cnt;
             Eigen::VectorXd gradient;
@@ -324,64 +418,73 @@ namespace MR
             Eigen::VectorXd& overall_gradient;
             ssize_t* overall_cnt;
             transform_type voxel2scanner;
+            Eigen::Matrix3Xd midway_points, im1_points, im2_points, im1_voxels, im2_voxels;
             // MR::Transform transform;
       };
 
+      //! process the image one row at a time via ThreadKernel::row(), for use with ThreadedLoop::run_outer()
       template <class MetricType, class ParamType>
-      struct StochasticThreadKernel { MEMALIGN(StochasticThreadKernel)
+      class RowThreadKernel { MEMALIGN(RowThreadKernel)
+        public:
+          RowThreadKernel (const ThreadKernel<MetricType, ParamType>& kernel, const size_t axis) :
+            kernel (kernel),
+            axis (axis) { }
+
+          void operator() (const Iterator& iter) {
+            kernel.row (iter, axis);
+          }
+
+        protected:
+          ThreadKernel<MetricType, ParamType> kernel;
+          const size_t axis;
+      };
+
+      //! evaluate the metric over a random subset of each row of voxels
+      /*! each row of the midway image grid along \a axis is divided into
+       * blocks of 1/density voxels, and one voxel is drawn uniformly from each.
+       * Voxels outside the masks are rejected by the kernel as usual, so the
+       * number of voxels sampled within the masks is not fixed. The voxels
+       * drawn depend only on \a seed and the position of the row, not on how
+       * rows are distributed across threads. Note however that the metric is
+       * accumulated in an order that depends on the threads, so that repeated
+       * registrations only give identical results when run single-threaded. */
+      template <class MetricType, class ParamType>
+      class StochasticThreadKernel { MEMALIGN(StochasticThreadKernel)
         public:
           StochasticThreadKernel (
-              const vector<size_t>& inner_axes,
+              const ThreadKernel<MetricType, ParamType>& kernel,
+              const size_t axis,
               const default_type density,
-              const MetricType& metric,
-              const ParamType& parameters,
-              Eigen::VectorXd& overall_cost_function,
-              Eigen::VectorXd& overall_grad,
-              Math::RNG& rng_engine,
-              ssize_t* overlap_count = nullptr) :
-            inner_axes (inner_axes),
-            density (density),
-            metric (metric),
-            params (parameters),
-            cost_function (overall_cost_function.size()),
-            gradient (overall_grad.size()),
-            overall_cost_function (overall_cost_function),
-            overall_gradient (overall_grad),
-            rng (rng_engine),
-            overlap_count (overlap_count)  {
-              gradient.setZero();
-              cost_function.setZero();
-              assert(inner_axes.size() >= 2);
-              assert(overall_cost_function.size() == 1);
+              const uint32_t seed) :
+            kernel (kernel),
+            axis (axis),
+            stride (1.0 / density),
+            seed (seed) {
+              assert (density > 0.0 && density <= 1.0);
             }
 
-          ~StochasticThreadKernel () {
-            overall_cost_function += cost_function;
-            overall_gradient += gradient;
-          }
-
           void operator() (const Iterator& iter) {
-            auto engine = std::default_random_engine{static_cast<std::default_random_engine::result_type>(rng.get_seed())};
-            auto kern = ThreadKernel<MetricType, ParamType> (metric, params, cost_function, gradient, overlap_count);
-            Iterator iterator (iter);
-            assign_pos_of(iter).to(iterator);
-            auto inner_loop = Random_loop<Iterator, std::default_random_engine>(iterator, engine, inner_axes[1], (float) iterator.size(inner_axes[1]) * density);
-            for (auto j = inner_loop; j; ++j)
-              for (auto k = Loop (inner_axes[0]) (iterator); k; ++k) {
-                kern (iterator);
-              }
+            Iterator pos (iter);
+            uint32_t row_seed = seed;
+            for (size_t n = 0; n < 3; ++n)
+              if (n != axis)
+                row_seed = 2654435761U * row_seed + uint32_t (pos.index(n));
+            std::minstd_rand engine (row_seed);
+            std::uniform_real_distribution<default_type> uniform;
+
+            const ssize_t size = pos.size (axis);
+            for (default_type start = 0.0; start < size; start += stride) {
+              pos.index(axis) = ssize_t (start + stride * uniform (engine));
+              if (pos.index(axis) < size)
+                kernel (pos);
+            }
           }
+
         protected:
-          vector<size_t> inner_axes;
-          default_type density;
-          MetricType metric;
-          ParamType params;
-          Eigen::VectorXd cost_function;
-          Eigen::VectorXd gradient;
-          Eigen::VectorXd& overall_cost_function;
-          Eigen::VectorXd& overall_gradient;
-          Math::RNG rng;
-          ssize_t* overlap_count;
+          ThreadKernel<MetricType, ParamType> kernel;
+          const size_t axis;
+          const default_type stride;
+          const uint32_t seed;
       };
     }
   }
@@ -20,6 +20,9 @@
 #include "image.h"
 #include "types.h"
 
+#include "file/config.h"
+#include "filter/recursive_smooth.h"
+#include "filter/smooth.h"
 #include "filter/warp.h"
 #include "filter/resize.h"
 #include "registration/transform/reorient.h"
@@ -208,10 +211,7 @@ namespace MR
               while (!converged) {
                 if (iteration > 1) {
                   DEBUG ("smoothing update fields");
-                  Filter::Smooth smooth_filter (*im1_update);
-                  smooth_filter.set_stdev (update_smoothing_mm);
-                  smooth_filter (*im1_update);
-                  smooth_filter (*im2_update);
+                  smooth_fields (*im1_update, *im2_update, update_smoothing_mm, false);
                 }
 
                 Image<default_type> im1_deform_field = Image<default_type>::scratch (field_header);
@@ -223,11 +223,7 @@ namespace MR
                   Warp::update_displacement_scaling_and_squaring (*im2_to_mid, *im2_update, *im2_to_mid_new, grad_step_altered);
 
                   DEBUG ("smoothing displacement field");
-                  Filter::Smooth smooth_filter (*im1_to_mid_new);
-                  smooth_filter.set_stdev (disp_smoothing_mm);
-                  smooth_filter.set_zero_boundary (true);
-                  smooth_filter (*im1_to_mid_new);
-                  smooth_filter (*im2_to_mid_new);
+                  smooth_fields (*im1_to_mid_new, *im2_to_mid_new, disp_smoothing_mm, true);
 
                   Registration::Warp::compose_linear_displacement (im1_to_mid_linear, *im1_to_mid_new, im1_deform_field);
                   Registration::Warp::compose_linear_displacement (im2_to_mid_linear, *im2_to_mid_new, im2_deform_field);
@@ -535,6 +531,29 @@ namespace MR
             return temp;
           }
 
+          void smooth_fields (Image<default_type>& im1_field, Image<default_type>& im2_field, default_type stdev, bool zero_boundary) {
+            //CONF option: RegNonlinearRecursiveSmoothing
+            //CONF default: 0 (false)
+            //CONF Nonlinear registration: smooth the update and displacement fields using
+            //CONF a recursive approximation to the Gaussian kernel, whose cost does not depend
+            //CONF on the kernel width. The results differ slightly from the default, since
+            //CONF the default kernel is truncated at 2 standard deviations.
+            const bool recursive = File::Config::get_bool ("RegNonlinearRecursiveSmoothing", false);
+            if (recursive)
+              smooth_fields_with<Filter::RecursiveSmooth> (im1_field, im2_field, stdev, zero_boundary);
+            else
+              smooth_fields_with<Filter::Smooth> (im1_field, im2_field, stdev, zero_boundary);
+          }
+
+          template <class FilterType>
+          void smooth_fields_with (Image<default_type>& im1_field, Image<default_type>& im2_field, default_type stdev, bool zero_boundary) {
+            FilterType smooth_filter (im1_field);
+            smooth_filter.set_stdev (stdev);
+            smooth_filter.set_zero_boundary (zero_boundary);
+            smooth_filter (im1_field);
+            smooth_filter (im2_field);
+          }
+
           bool has_negative_jacobians (Image<default_type>& field) {
             Adapter::Jacobian<Image<default_type> > jacobian (field);
             for (auto i = Loop (0,3) (jacobian); i; ++i) {
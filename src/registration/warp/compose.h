@@ -67,68 +67,92 @@ namespace MR
             MR::Transform image_transform;
         };
 
+        //! compose two displacement fields, one row of voxels at a time
+        /*! The neighbourhood of the second field is retained between
+         * neighbouring voxels (see Interp::Linear::cached_row()), so the second
+         * field must not be the output. */
         class ComposeDispKernel { MEMALIGN(ComposeDispKernel)
           public:
-            ComposeDispKernel (Image<default_type>& disp_input1, Image<default_type>& disp_input2, default_type step) :
-                               disp1_transform (disp_input1), disp2_interp (disp_input2), step (step) {}
-
-
-            void operator() (Image<default_type>& disp_input1, Image<default_type>& disp_output) {
-              Eigen::Vector3d voxel ((default_type)disp_input1.index(0), (default_type)disp_input1.index(1), (default_type)disp_input1.index(2));
-              Eigen::Vector3d voxel_position = disp1_transform.voxel2scanner * voxel;
-              Eigen::Vector3d original_position = voxel_position + Eigen::Vector3d(disp_input1.row(3));
-              disp2_interp.scanner (original_position);
-              if (!disp2_interp) {
-                disp_output.row(3) = disp_input1.row(3);
-              } else {
-                Eigen::Vector3d displacement (Eigen::Vector3d(disp2_interp.row(3)).array() * step);
-                Eigen::Vector3d new_position = displacement + original_position;
-                disp_output.row(3) = new_position - voxel_position;
+            ComposeDispKernel (Image<default_type>& disp_input1, Image<default_type>& disp_input2, Image<default_type>& disp_output, default_type step, size_t axis) :
+                               disp_input1 (disp_input1), disp_output (disp_output), disp1_transform (disp_input1),
+                               disp2_interp (disp_input2), step (step), axis (axis) {}
+
+
+            void operator() (const Iterator& pos) {
+              assign_pos_of (pos, 0, 3).to (disp_input1, disp_output);
+              Eigen::Vector3d voxel ((default_type)pos.index(0), (default_type)pos.index(1), (default_type)pos.index(2));
+              voxel[axis] = 0.0;
+              const Eigen::Vector3d start = disp1_transform.voxel2scanner * voxel;
+              const Eigen::Vector3d voxel_step = disp1_transform.voxel2scanner.linear().col (axis);
+
+              for (ssize_t n = 0; n < disp_output.size (axis); ++n) {
+                disp_input1.index(axis) = disp_output.index(axis) = n;
+                const Eigen::Vector3d displacement1 (disp_input1.row(3));
+                const Eigen::Vector3d original_position = start + default_type(n) * voxel_step + displacement1;
+                if (!disp2_interp.scanner (original_position)) {
+                  disp_output.row(3) = displacement1;
+                } else {
+                  disp2_interp.cached_row (displacement2, 3);
+                  disp_output.row(3) = displacement1 + displacement2 * step;
+                }
               }
             }
 
           protected:
+            Image<default_type> disp_input1, disp_output;
             MR::Transform disp1_transform;
             Interp::Linear<Image<default_type> > disp2_interp;
             default_type step;
+            const size_t axis;
+            Eigen::Vector3d displacement2;
         };
 
 
-        template <class DeformationField1Type, class DeformationField2Type>
-        class ComposeHalfwayKernel { MEMALIGN(ComposeHalfwayKernel<DeformationField1Type,DeformationField2Type>)
+        //! compose linear1<->deform1<->[midway space]<->deform2<->linear2, one row of voxels at a time
+        template <class DeformationField1Type, class DeformationField2Type, class OutputDeformationFieldType>
+        class ComposeHalfwayKernel { MEMALIGN(ComposeHalfwayKernel<DeformationField1Type,DeformationField2Type,OutputDeformationFieldType>)
           public:
             ComposeHalfwayKernel (const transform_type& linear1, DeformationField1Type& deform1,
-                                  DeformationField2Type& deform2, const transform_type& linear2) :
-                                    linear1 (linear1), deform1_interp (deform1), deform2_interp (deform2), linear2 (linear2) {
+                                  DeformationField2Type& deform2, const transform_type& linear2,
+                                  OutputDeformationFieldType& deform, size_t axis) :
+                                    linear1 (linear1), deform1_interp (deform1), deform2_interp (deform2), linear2 (linear2),
+                                    deform (deform), axis (axis) {
               out_of_bounds.setOnes();
               out_of_bounds *= NaN;
             }
 
 
-            void operator() (Image<default_type>& deform) {
-              Eigen::Vector3d voxel ((default_type)deform.index(0), (default_type)deform.index(1), (default_type)deform.index(2));
-              Eigen::Vector3d position = linear1 * voxel;
-              deform1_interp.scanner (position);
-              if (!deform1_interp) {
+            void operator() (const Iterator& pos) {
+              assign_pos_of (pos, 0, 3).to (deform);
+              Eigen::Vector3d voxel ((default_type)pos.index(0), (default_type)pos.index(1), (default_type)pos.index(2));
+              voxel[axis] = 0.0;
+              const Eigen::Vector3d start = linear1 * voxel;
+              const Eigen::Vector3d voxel_step = linear1.linear().col (axis);
+
+              for (deform.index(axis) = 0; deform.index(axis) < deform.size(axis); ++deform.index(axis)) {
+                const Eigen::Vector3d position = start + default_type(deform.index(axis)) * voxel_step;
+                if (!deform1_interp.scanner (position)) {
                   deform.row(3) = out_of_bounds;
-                } else {
-                  Eigen::Vector3d position2 = deform1_interp.row(3);
-                  deform2_interp.scanner (position2);
-                  if (!deform2_interp) {
-                    deform.row(3) = out_of_bounds;
-                  } else {
-                    Eigen::Vector3d position3 = deform2_interp.row(3);
-                    deform.row(3) = linear2 * position3;
-                  }
-               }
+                  continue;
+                }
+                deform1_interp.cached_row (position2, 3);
+                if (!deform2_interp.scanner (position2)) {
+                  deform.row(3) = out_of_bounds;
+                  continue;
+                }
+                deform2_interp.cached_row (position3, 3);
+                deform.row(3) = linear2 * position3;
+              }
             }
 
           protected:
             const transform_type linear1;
-            Interp::Linear<DeformationField2Type> deform1_interp;
+            Interp::Linear<DeformationField1Type> deform1_interp;
             Interp::Linear<DeformationField2Type> deform2_interp;
             const transform_type linear2;
-            Eigen::Vector3d out_of_bounds;
+            OutputDeformationFieldType deform;
+            const size_t axis;
+            Eigen::Vector3d out_of_bounds, position2, position3;
         };
 
 
@@ -148,11 +172,12 @@ namespace MR
         ThreadedLoop (deform_in, 0, 3).run (ComposeLinearDeformKernel (transform), deform_in, deform_out);
       }
 
-      // Compose two displacement fields and output a displacement field. The input and output can be the same image.
+      // Compose two displacement fields and output a displacement field. The input and output can be the same image, but the update cannot.
       FORCE_INLINE  void update_displacement (Image<default_type>& input, Image<default_type>& update, Image<default_type>& output, default_type step = 1.0)
       {
         check_dimensions (input, output, 0, 3);
-        ThreadedLoop (input, 0, 3).run (ComposeDispKernel (input, update, step), input, output);
+        auto loop = ThreadedLoop (input, 0, 3);
+        loop.run_outer (ComposeDispKernel (input, update, output, step, loop.inner_axes[0]));
       }
 
       // Compose two displacement fields and output a displacement field using scaling and squaring.  The input and output can be the same image.
@@ -224,8 +249,9 @@ namespace MR
                                                   OutputDeformationFieldType& deform_out)
       {
         MR::Transform deform_header_transform (deform_out);
-        ComposeHalfwayKernel<DeformationField1Type, DeformationField2Type> compose_kernel (linear1 * deform_header_transform.voxel2scanner, deform1, deform2, linear2);
-        ThreadedLoop (deform_out, 0, 3).run (compose_kernel, deform_out);
+        auto loop = ThreadedLoop (deform_out, 0, 3);
+        loop.run_outer (ComposeHalfwayKernel<DeformationField1Type, DeformationField2Type, OutputDeformationFieldType>
+            (linear1 * deform_header_transform.voxel2scanner, deform1, deform2, linear2, deform_out, loop.inner_axes[0]));
       }
 
       // Compose linear1<->deform1<->[midway space]<->deform2<->linear2.
@@ -235,8 +261,9 @@ namespace MR
                                                   OutputDeformationFieldType& deform_out)
       {
         MR::Transform deform_header_transform (deform_out);
-        ComposeHalfwayKernel<DeformationField1Type, DeformationField2Type> compose_kernel (linear1 * deform_header_transform.voxel2scanner, deform1, deform2, linear2);
-        ThreadedLoop (message, deform_out, 0, 3).run (compose_kernel, deform_out);
+        auto loop = ThreadedLoop (message, deform_out, 0, 3);
+        loop.run_outer (ComposeHalfwayKernel<DeformationField1Type, DeformationField2Type, OutputDeformationFieldType>
+            (linear1 * deform_header_transform.voxel2scanner, deform1, deform2, linear2, deform_out, loop.inner_axes[0]));
       }
 
       template <class WarpType>
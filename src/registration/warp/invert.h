@@ -32,93 +32,98 @@ namespace MR
 
       namespace {
 
-
-      class DisplacementThreadKernel { MEMALIGN(DisplacementThreadKernel)
-
-        public:
-          DisplacementThreadKernel (Image<default_type> & displacement,
-                        Image<default_type> & displacement_inverse,
-                        const size_t max_iter,
-                        const default_type error_tol) :
-                          displacement (displacement),
-                          transform (displacement_inverse),
-                          max_iter (max_iter),
-                          error_tolerance (error_tol) {}
-
-          void operator() (Image<default_type>& displacement_inverse)
-          {
-            Eigen::Vector3d voxel ((default_type)displacement_inverse.index(0), (default_type)displacement_inverse.index(1), (default_type)displacement_inverse.index(2));
-            Eigen::Vector3d truth = transform.voxel2scanner * voxel;
-            Eigen::Vector3d current = truth + Eigen::Vector3d(displacement_inverse.row(3));
-
-            size_t iter = 0;
-            default_type error = std::numeric_limits<default_type>::max();
-            while (iter < max_iter && error > error_tolerance) {
-              error = update (current, truth);
-              ++iter;
-            }
-            displacement_inverse.row(3) = current - truth;
-          }
-
-        private:
-
-          default_type update (Eigen::Vector3d& current, const Eigen::Vector3d& truth)
-          {
-            displacement.scanner (current);
-            Eigen::Vector3d discrepancy = truth - (current + Eigen::Vector3d (displacement.row(3)));
-            current += discrepancy;
-            return discrepancy.dot (discrepancy);
-          }
-
-          Interp::Linear<Image<default_type> > displacement;
-          MR::Transform transform;
-          const size_t max_iter;
-          default_type error_tolerance;
-      };
-
-
-        class DeformationThreadKernel { MEMALIGN(DeformationThreadKernel)
+        //! estimate the inverse of a warp field, one row of voxels at a time
+        /*! Each voxel of the inverse is found by fixed-point iteration, and
+         * stops as soon as its own update falls below the tolerance. The
+         * neighbourhood of the input field is retained between iterations and
+         * between neighbouring voxels of the row (see Interp::Linear::cached_row()).
+         * Unless the inverse field is supplied initialised, each voxel starts
+         * from the converged displacement of its predecessor along the row,
+         * which is typically much closer to the solution than the identity.
+         *
+         * If \a is_displacement is set, both the input and inverse fields are
+         * displacement fields; otherwise they are deformation fields. */
+        class InvertRowKernel { MEMALIGN(InvertRowKernel)
 
           public:
-            DeformationThreadKernel (Image<default_type> & deform,
-                          Image<default_type> & inv_deform,
-                          const size_t max_iter,
-                          const default_type error_tol) :
-                            deform (deform),
-                            transform (inv_deform),
-                            max_iter (max_iter),
-                            error_tolerance (error_tol) {}
-
-            void operator() (Image<default_type>& inv_deform)
+            InvertRowKernel (Image<default_type>& field,
+                             Image<default_type>& inverse,
+                             const bool is_displacement,
+                             const bool is_initialised,
+                             const size_t axis,
+                             const size_t max_iter,
+                             const default_type error_tol) :
+                               field (field),
+                               inverse (inverse),
+                               transform (inverse),
+                               is_displacement (is_displacement),
+                               is_initialised (is_initialised),
+                               axis (axis),
+                               max_iter (max_iter),
+                               error_tolerance (error_tol) {}
+
+            void operator() (const Iterator& pos)
             {
-              Eigen::Vector3d voxel ((default_type)inv_deform.index(0), (default_type)inv_deform.index(1), (default_type)inv_deform.index(2));
-              Eigen::Vector3d truth = transform.voxel2scanner * voxel;
-              Eigen::Vector3d current = inv_deform.row(3);
-
-              size_t iter = 0;
-              default_type error = std::numeric_limits<default_type>::max();
-              while (iter < max_iter && error > error_tolerance) {
-                error = update (current, truth);
-                ++iter;
+              assign_pos_of (pos, 0, 3).to (inverse);
+              Eigen::Vector3d voxel ((default_type)pos.index(0), (default_type)pos.index(1), (default_type)pos.index(2));
+              voxel[axis] = 0.0;
+              const Eigen::Vector3d start = transform.voxel2scanner * voxel;
+              const Eigen::Vector3d step = transform.voxel2scanner.linear().col (axis);
+
+              Eigen::Vector3d offset (0.0, 0.0, 0.0);
+              for (inverse.index(axis) = 0; inverse.index(axis) < inverse.size(axis); ++inverse.index(axis)) {
+                const Eigen::Vector3d truth = start + default_type(inverse.index(axis)) * step;
+                Eigen::Vector3d current;
+                if (is_initialised) {
+                  current = inverse.row(3);
+                  if (is_displacement)
+                    current += truth;
+                } else {
+                  current = truth + offset;
+                }
+
+                size_t iter = 0;
+                default_type error = std::numeric_limits<default_type>::max();
+                while (iter < max_iter && error > error_tolerance) {
+                  error = update (current, truth);
+                  ++iter;
+                }
+
+                if (current.allFinite())
+                  offset = current - truth;
+                inverse.row(3) = is_displacement ? Eigen::Vector3d (current - truth) : current;
               }
-              inv_deform.row(3) = current;
             }
 
           private:
 
             default_type update (Eigen::Vector3d& current, const Eigen::Vector3d& truth)
             {
-              deform.scanner (current);
-              Eigen::Vector3d discrepancy = truth - Eigen::Vector3d (deform.row(3));
+              field.scanner (current);
+              field.cached_row (value, 3);
+              Eigen::Vector3d discrepancy = truth - (is_displacement ? Eigen::Vector3d (current + value) : value);
               current += discrepancy;
               return discrepancy.dot (discrepancy);
             }
 
-            Interp::Linear<Image<default_type> > deform;
+            Interp::Linear<Image<default_type> > field;
+            Image<default_type> inverse;
             MR::Transform transform;
+            const bool is_displacement, is_initialised;
+            const size_t axis;
             const size_t max_iter;
             default_type error_tolerance;
+            Eigen::Vector3d value;
         };
+
+
+        inline void invert (const std::string& message, Image<default_type>& field, Image<default_type>& inverse,
+                            const bool is_displacement, const bool is_initialised,
+                            const size_t max_iter, const default_type error_tolerance)
+        {
+          auto loop = ThreadedLoop (message, inverse, 0, 3);
+          loop.run_outer (InvertRowKernel (field, inverse, is_displacement, is_initialised, loop.inner_axes[0], max_iter, error_tolerance));
+        }
       }
 
 
@@ -126,22 +131,18 @@ namespace MR
         @{ */
 
           /*! Estimate the inverse of a deformation field
-           * Note that the output inv_warp can be passed as either a zero field or an initial estimate
+           * Note that the output inv_warp can be passed as an initial estimate, in which case \a is_initialised should be set
            */
           FORCE_INLINE void invert_deformation (Image<default_type>& deform_field, Image<default_type>& inv_deform_field, bool is_initialised = false, size_t max_iter = 50, default_type error_tolerance = 0.0001)
           {
             check_dimensions (deform_field, inv_deform_field);
             error_tolerance *= (deform_field.spacing(0) + deform_field.spacing(1) + deform_field.spacing(2)) / 3;
 
-            if (!is_initialised)
-              displacement2deformation (inv_deform_field, inv_deform_field);
-
-            ThreadedLoop ("inverting warp field...", inv_deform_field, 0, 3)
-              .run (DeformationThreadKernel (deform_field, inv_deform_field, max_iter, error_tolerance), inv_deform_field);
+            invert ("inverting warp field...", deform_field, inv_deform_field, false, is_initialised, max_iter, error_tolerance);
           }
 
           /*! Estimate the inverse of a displacement field, output the inverse as a deformation field
-           * Note that the output inv_warp can be passed as either a zero field or an initial estimate (as a deformation field)
+           * Note that the output inv_warp can be passed as an initial estimate (as a deformation field), in which case \a is_initialised should be set
            */
           FORCE_INLINE void invert_displacement_deformation (Image<default_type>& disp, Image<default_type>& inv_deform, bool is_initialised = false, size_t max_iter = 50, default_type error_tolerance = 0.0001)
           {
@@ -153,15 +154,16 @@ namespace MR
 
 
           /*! Estimate the inverse of a displacement field
-           * Note that the output inv_warp can be passed as either a zero field or an initial estimate
+           * Note that the output inv_warp is used as the initial estimate, and can be passed as either a zero field or a
+           * previous estimate. If \a is_initialised is cleared, its contents are ignored, and each voxel instead starts from
+           * the inverse found for its predecessor along the row.
            */
-          FORCE_INLINE void invert_displacement (Image<default_type>& disp_field, Image<default_type>& inv_disp_field, size_t max_iter = 50, default_type error_tolerance = 0.0001)
+          FORCE_INLINE void invert_displacement (Image<default_type>& disp_field, Image<default_type>& inv_disp_field, size_t max_iter = 50, default_type error_tolerance = 0.0001, bool is_initialised = true)
           {
             check_dimensions (disp_field, inv_disp_field);
             error_tolerance *= (disp_field.spacing(0) + disp_field.spacing(1) + disp_field.spacing(2)) / 3;
 
-            ThreadedLoop ("inverting displacement field...", inv_disp_field, 0, 3)
-              .run (DisplacementThreadKernel (disp_field, inv_disp_field, max_iter, error_tolerance), inv_disp_field);
+            invert ("inverting displacement field...", disp_field, inv_disp_field, true, is_initialised, max_iter, error_tolerance);
           }
 
 
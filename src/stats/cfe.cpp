@@ -16,6 +16,11 @@
 
 #include "stats/cfe.h"
 
+#include <thread>
+
+#include "app.h"
+#include "thread_queue.h"
+
 namespace MR
 {
   namespace Stats
@@ -29,7 +34,7 @@ namespace MR
               const value_type H,
               const value_type C,
               const bool norm) :
-        matrix (connectivity_matrix),
+        matrix (connectivity_matrix, Fixel::Matrix::connectivity_value_type (C)),
         dh (dh),
         E (E),
         H (H),
@@ -40,45 +45,77 @@ namespace MR
 
     void CFE::operator() (in_column_type stats, out_column_type enhanced_stats) const
     {
+      assert (size_t(stats.size()) == matrix.size());
       enhanced_stats.setZero();
-      vector<default_type> connected_stats;
-      for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
-        if (stats[fixel] < dh)
-          continue;
-        auto connections = matrix[fixel];
-        // Need to re-normalise based on the value of the power C
-        if (C != 1.0) {
-          default_type sum = 0.0;
-          for (auto& c : connections) {
-            c.exponentiate (C);
-            sum += c.value();
-          }
-          connections.normalise (Fixel::Matrix::connectivity_value_type (sum));
-        }
-        // Rather than allocating data for the stats and then looping over dh,
-        //   divide statistic by dh to determine the number of cluster sizes that should
-        //   be incremented, and dynamically increment all cluster sizes for that
-        //   particular connected fixel
-        vector<Fixel::Matrix::connectivity_value_type> extents (std::floor (stats[fixel]/dh), Fixel::Matrix::connectivity_value_type(0));
-        for (const auto& connection : connections) {
-          const default_type connection_stat = stats[connection.index()];
-          if (connection_stat > dh) {
-            const size_t cluster_count = std::min (extents.size(), size_t(std::floor (connection_stat / dh)));
-            for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
-              extents[cluster_index] += connection.value();
+      const value_type max_stat = stats.maxCoeff();
+      if (!(max_stat >= dh))
+        return;
+
+      // Pre-calculate h^H
+      vector<value_type> h_pow_H (std::floor (max_stat / dh));
+      for (size_t ih = 0; ih != h_pow_H.size(); ++ih)
+        h_pow_H[ih] = std::pow (dh*(ih+1), H);
+
+      class Worker
+      { MEMALIGN(Worker)
+        public:
+          Worker (const CFE& master, in_column_type stats, out_column_type enhanced_stats, const vector<value_type>& h_pow_H) :
+              master (master),
+              stats (stats),
+              enhanced_stats (enhanced_stats),
+              h_pow_H (h_pow_H),
+              extents (h_pow_H.size()) { }
+
+          bool operator() (const size_t fixel)
+          {
+            const Fixel::Matrix::CSR& matrix (master.matrix);
+            if (stats[fixel] < master.dh || !matrix.included (fixel))
+              return true;
+            // Rather than allocating data for the stats and then looping over dh,
+            //   divide statistic by dh to determine the number of cluster sizes that should
+            //   be incremented, and dynamically increment all cluster sizes for that
+            //   particular connected fixel
+            // Extents are accumulated in the same order & precision as when
+            //   connectivity was read using Fixel::Matrix::Reader, such that results
+            //   are unaffected by the storage format
+            const size_t num_clusters = std::floor (stats[fixel] / master.dh);
+            std::fill (extents.begin(), extents.begin() + num_clusters, Fixel::Matrix::connectivity_value_type(0));
+            const Fixel::Matrix::fixel_index_type* fixels = matrix.fixels (fixel);
+            const Fixel::Matrix::connectivity_value_type* values = matrix.values (fixel);
+            for (Fixel::Matrix::index_image_type i = 0; i != matrix.size (fixel); ++i) {
+              const default_type connection_stat = stats[fixels[i]];
+              if (connection_stat > master.dh && matrix.included (fixels[i])) {
+                const size_t cluster_count = std::min (num_clusters, size_t(std::floor (connection_stat / master.dh)));
+                for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
+                  extents[cluster_index] += values[i];
+              }
+            }
+            value_type sum = 0.0;
+            for (size_t cluster_index = 0; cluster_index != num_clusters; ++cluster_index)
+              sum += std::pow (extents[cluster_index], master.E) * h_pow_H[cluster_index];
+            enhanced_stats[fixel] = master.normalise ? sum * matrix.norm_multiplier (fixel) : sum;
+            return true;
           }
-        }
-        // Pre-calculate h^H
-        if (h_pow_H.size() < extents.size()) {
-          const size_t old_size = h_pow_H.size();
-          h_pow_H.resize (extents.size());
-          for (size_t ih = old_size; ih != h_pow_H.size(); ++ih)
-            h_pow_H[ih] = std::pow (dh*(ih+1), H);
-        }
-        for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
-          enhanced_stats[fixel] += std::pow (extents[cluster_index], E) * h_pow_H[cluster_index];
-        if (normalise)
-          enhanced_stats[fixel] *= connections.norm_multiplier;
+
+        private:
+          const CFE& master;
+          in_column_type stats;
+          out_column_type enhanced_stats;
+          const vector<value_type>& h_pow_H;
+          vector<Fixel::Matrix::connectivity_value_type> extents;
+      };
+
+      Worker worker (*this, stats, enhanced_stats, h_pow_H);
+      // During permutation testing, enhancement is invoked concurrently
+      //   from multiple threads, in which case each invocation processes
+      //   all fixels serially
+      if (std::this_thread::get_id() == App::main_thread_ID) {
+        Thread::run_queue (Thread::IndexSource (matrix.size()),
+                           Thread::batch (size_t()),
+                           Thread::multi (worker));
+      } else {
+        for (size_t fixel = 0; fixel != matrix.size(); ++fixel)
+          worker (fixel);
       }
     }
 
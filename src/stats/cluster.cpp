@@ -37,6 +37,16 @@ namespace MR
 
 
 
+      bool ClusterSize::integrate (in_column_type input, const value_type dh, const value_type e, const value_type h, out_column_type output) const
+      {
+        // Filter::Connector compares statistics against a single-precision threshold
+        Stats::TFCE::ClusterSizeIntegrator integrator ([] (const value_type value, const value_type T) { return value > float(T); });
+        integrator (connector.adjacency, input, dh, e, h, output);
+        return true;
+      }
+
+
+
     }
   }
 }
@@ -55,6 +55,8 @@ namespace MR
           }
 
           void operator() (in_column_type, const value_type, out_column_type) const override;
+
+          bool integrate (in_column_type, const value_type, const value_type, const value_type, out_column_type) const override;
       };
       //! @}
 
@@ -16,6 +16,8 @@
 
 #include "stats/permtest.h"
 
+#include "file/config.h"
+
 namespace MR
 {
   namespace Stats
@@ -25,6 +27,37 @@ namespace MR
 
 
 
+      size_t batch_size ()
+      {
+        //CONF option: PermutationBatchSize
+        //CONF default: 8
+        //CONF The number of shuffles to be evaluated within a single call to
+        //CONF the General Linear Model during permutation testing. Larger
+        //CONF batches permit the measurement data to be processed more
+        //CONF efficiently, at the expense of additional memory usage per
+        //CONF thread; a value of 1 evaluates each shuffle individually.
+        static const size_t value = std::max (1, File::Config::get_int ("PermutationBatchSize", 8));
+        return value;
+      }
+
+
+
+      bool ShuffleBatcher::operator() (ShuffleBatch& output)
+      {
+        output.index.clear();
+        output.data.resize (size);
+        size_t count = 0;
+        while (count != size && shuffler (shuffle)) {
+          output.index.push_back (shuffle.index);
+          std::swap (output.data[count++], shuffle.data);
+        }
+        output.data.resize (count);
+        return count;
+      }
+
+
+
+
       PreProcessor::PreProcessor (const std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator,
                                   const std::shared_ptr<EnhancerBase> enhancer,
                                   const default_type skew,
@@ -37,7 +70,6 @@ namespace MR
           global_enhanced_count (global_enhanced_count),
           enhanced_sum (matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
           enhanced_count (count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
-          stats (global_enhanced_sum.rows(), global_enhanced_sum.cols()),
           enhanced_stats (global_enhanced_sum.rows(), global_enhanced_sum.cols()),
           mutex (new std::mutex())
       {
@@ -56,17 +88,19 @@ namespace MR
 
 
 
-      bool PreProcessor::operator() (const Math::Stats::Shuffle& shuffle)
+      bool PreProcessor::operator() (const ShuffleBatch& batch)
       {
-        if (!shuffle.data.rows())
+        if (batch.data.empty())
           return false;
-        (*stats_calculator) (shuffle.data, stats);
-        (*enhancer) (stats, enhanced_stats);
-        for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
-          for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
-            if (enhanced_stats(ie, ih) > 0.0) {
-              enhanced_sum(ie, ih) += std::pow (enhanced_stats(ie, ih), skew);
-              enhanced_count(ie, ih)++;
+        (*stats_calculator) (batch.data, stats);
+        for (const auto& shuffle_stats : stats) {
+          (*enhancer) (shuffle_stats, enhanced_stats);
+          for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
+            for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
+              if (enhanced_stats(ie, ih) > 0.0) {
+                enhanced_sum(ie, ih) += std::pow (enhanced_stats(ie, ih), skew);
+                enhanced_count(ie, ih)++;
+              }
             }
           }
         }
@@ -90,7 +124,6 @@ namespace MR
           enhancer (enhancer),
           empirical_enhanced_statistics (empirical_enhanced_statistics),
           default_enhanced_statistics (default_enhanced_statistics),
-          statistics (stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
           enhanced_statistics (stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
           null_dist (perm_dist),
           global_null_dist_contributions (perm_dist_contributions),
@@ -113,33 +146,36 @@ namespace MR
 
 
 
-      bool Processor::operator() (const Math::Stats::Shuffle& shuffle)
+      bool Processor::operator() (const ShuffleBatch& batch)
       {
-        (*stats_calculator) (shuffle.data, statistics);
-        if (enhancer)
-          (*enhancer) (statistics, enhanced_statistics);
-        else
-          enhanced_statistics = statistics;
-
-        if (empirical_enhanced_statistics.size())
-          enhanced_statistics.array() /= empirical_enhanced_statistics.array();
-
-        if (null_dist.cols() == 1) { // strong fwe control
-          ssize_t max_element, max_hypothesis;
-          null_dist(shuffle.index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
-          null_dist_contribution_counter(max_element, max_hypothesis)++;
-        } else { // weak fwe control
-          ssize_t max_index;
-          for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-            null_dist(shuffle.index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
-            null_dist_contribution_counter(max_index, ih)++;
+        (*stats_calculator) (batch.data, statistics);
+        for (size_t b = 0; b != batch.index.size(); ++b) {
+          const size_t index = batch.index[b];
+          if (enhancer)
+            (*enhancer) (statistics[b], enhanced_statistics);
+          else
+            enhanced_statistics = statistics[b];
+
+          if (empirical_enhanced_statistics.size())
+            enhanced_statistics.array() /= empirical_enhanced_statistics.array();
+
+          if (null_dist.cols() == 1) { // strong fwe control
+            ssize_t max_element, max_hypothesis;
+            null_dist(index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
+            null_dist_contribution_counter(max_element, max_hypothesis)++;
+          } else { // weak fwe control
+            ssize_t max_index;
+            for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+              null_dist(index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
+              null_dist_contribution_counter(max_index, ih)++;
+            }
           }
-        }
 
-        for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-          for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
-            if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
-              uncorrected_pvalue_counter(ie, ih)++;
+          for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+            for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
+              if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
+                uncorrected_pvalue_counter(ie, ih)++;
+            }
           }
         }
 
@@ -162,8 +198,9 @@ namespace MR
         count_matrix_type global_enhanced_count (count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses()));
         {
           Math::Stats::Shuffler shuffler (stats_calculator->num_inputs(), true, "Pre-computing empirical statistic for non-stationarity correction");
+          ShuffleBatcher batcher (shuffler);
           PreProcessor preprocessor (stats_calculator, enhancer, skew, empirical_statistic, global_enhanced_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (preprocessor));
+          Thread::run_queue (batcher, ShuffleBatch(), Thread::multi (preprocessor));
         }
         for (size_t contrast = 0; contrast != stats_calculator->num_hypotheses(); ++contrast) {
           for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
@@ -231,7 +268,8 @@ namespace MR
                                null_dist,
                                null_dist_contributions,
                                global_uncorrected_pvalue_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (processor));
+          ShuffleBatcher batcher (shuffler);
+          Thread::run_queue (batcher, ShuffleBatch(), Thread::multi (processor));
         }
         uncorrected_pvalues = global_uncorrected_pvalue_count.cast<default_type>() / default_type(shuffler.size());
       }
@@ -53,6 +53,42 @@ namespace MR
 
 
 
+      //! the number of shuffles to evaluate within a single call to the GLM
+      size_t batch_size ();
+
+
+
+      /*! A set of shuffles to be processed together */
+      class ShuffleBatch { NOMEMALIGN
+        public:
+          vector<size_t> index;
+          vector<matrix_type> data;
+      };
+
+
+
+      /*! A class to draw shuffles from a Shuffler and group them into batches
+       *
+       * Evaluating multiple shuffles within a single call to the GLM permits
+       *   the statistical test to traverse the measurement data once for the
+       *   entire batch, rather than once per shuffle.
+       */
+      class ShuffleBatcher { NOMEMALIGN
+        public:
+          ShuffleBatcher (Math::Stats::Shuffler& shuffler) :
+              shuffler (shuffler),
+              size (batch_size()) { }
+
+          bool operator() (ShuffleBatch& output);
+
+        protected:
+          Math::Stats::Shuffler& shuffler;
+          const size_t size;
+          Math::Stats::Shuffle shuffle;
+      };
+
+
+
       /*! A class to pre-compute the empirical enhanced statistic image for non-stationarity correction */
       class PreProcessor { MEMALIGN (PreProcessor)
         public:
@@ -64,7 +100,7 @@ namespace MR
 
           ~PreProcessor();
 
-          bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const ShuffleBatch&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
@@ -74,7 +110,7 @@ namespace MR
           count_matrix_type& global_enhanced_count;
           matrix_type enhanced_sum;
           count_matrix_type enhanced_count;
-          matrix_type stats;
+          vector<matrix_type> stats;
           matrix_type enhanced_stats;
           std::shared_ptr<std::mutex> mutex;
       };
@@ -95,14 +131,14 @@ namespace MR
 
           ~Processor();
 
-          bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const ShuffleBatch&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
           std::shared_ptr<EnhancerBase> enhancer;
           const matrix_type& empirical_enhanced_statistics;
           const matrix_type& default_enhanced_statistics;
-          matrix_type statistics;
+          vector<matrix_type> statistics;
           matrix_type enhanced_statistics;
           matrix_type& null_dist;
           count_matrix_type& global_null_dist_contributions;
@@ -43,8 +43,99 @@ namespace MR
 
 
 
+      void ClusterSizeIntegrator::initialise (matrix_type::ConstColXpr in, const value_type dH, const value_type E, const value_type H)
+      {
+        // thresholds are generated exactly as for the explicit integration
+        //   performed in Wrapper::operator()
+        thresholds.clear();
+        const value_type max_input_value = in.maxCoeff();
+        for (value_type h = dH; (h-dH) < max_input_value; h += dH)
+          thresholds.push_back (h);
+
+        // cumulative sum of height terms, such that the sum over any range
+        //   of thresholds can be obtained by subtraction
+        cumulative.assign (1, 0.0);
+        for (const auto h : thresholds)
+          cumulative.push_back (cumulative.back() + std::pow (h, H));
+
+        // elements that do not belong to any cluster at a given threshold
+        //   contribute pow (0, E), which is non-zero only if E == 0
+        exponent = E;
+        zero_term = std::pow (value_type(0), E);
+
+        const size_t num_elements = in.size();
+        order.clear();
+        if (thresholds.size()) {
+          for (size_t index = 0; index != num_elements; ++index) {
+            if (exceeds (in[index], thresholds.front()))
+              order.push_back (index);
+          }
+          std::sort (order.begin(), order.end(), [&] (const uint32_t a, const uint32_t b) { return in[a] > in[b]; });
+        }
+
+        parent.assign (num_elements, num_elements);
+        size.assign (num_elements, 0);
+        since.assign (num_elements, 0);
+        accumulated.assign (num_elements, 0.0);
+        offset.assign (num_elements, 0.0);
+      }
+
+
+
+      uint32_t ClusterSizeIntegrator::find (const uint32_t index)
+      {
+        const uint32_t p = parent[index];
+        if (p == index)
+          return index;
+        const uint32_t root = find (p);
+        // path compression: offsets become relative to the root
+        if (p != root) {
+          offset[index] += offset[p];
+          parent[index] = root;
+        }
+        return root;
+      }
+
+
+
+      // add the contribution of the cluster at root to all thresholds
+      //   from index end up to (but excluding) since[root]
+      void ClusterSizeIntegrator::flush (const uint32_t root, const size_t end)
+      {
+        accumulated[root] += (std::pow (value_type(size[root]), exponent) - zero_term) * (cumulative[since[root]] - cumulative[end]);
+        since[root] = end;
+      }
+
+
+
+      void ClusterSizeIntegrator::merge (uint32_t a, uint32_t b, const size_t end)
+      {
+        if (a == b)
+          return;
+        flush (a, end);
+        flush (b, end);
+        if (size[a] < size[b])
+          std::swap (a, b);
+        parent[b] = a;
+        offset[b] = accumulated[b] - accumulated[a];
+        size[a] += size[b];
+      }
+
+
+
+      value_type ClusterSizeIntegrator::total (const uint32_t index)
+      {
+        const uint32_t root = find (index);
+        flush (root, 0);
+        return accumulated[root] + (index == root ? 0.0 : offset[index]);
+      }
+
+
+
       void Wrapper::operator() (in_column_type in, out_column_type out) const
       {
+        if (enhancer->integrate (in, dH, E, H, out))
+          return;
         out.setZero();
         const value_type max_input_value = in.maxCoeff();
         for (value_type h = dH; (h-dH) < max_input_value; h += dH) {
@@ -49,12 +49,60 @@ namespace MR
           // Alternative functor that also takes the threshold value;
           //   makes TFCE integration cleaner
           virtual void operator() (in_column_type /*input_statistics*/, const value_type /*threshold*/, out_column_type /*enhanced_statistics*/) const = 0;
+          // Optionally evaluate the full TFCE integral in a single pass,
+          //   rather than invoking the functor above once per threshold;
+          //   returns false if not supported by the derived class
+          virtual bool integrate (in_column_type /*input_statistics*/,
+                                  const value_type /*dh*/, const value_type /*e*/, const value_type /*h*/,
+                                  out_column_type /*enhanced_statistics*/) const { return false; }
           friend class Wrapper;
       };
 
 
 
 
+      // Exact TFCE integration for enhancers where the enhanced value of each
+      //   element is the size of the cluster of supra-threshold elements to
+      //   which it belongs.
+      //
+      // Rather than identifying clusters anew at each threshold, elements are
+      //   added in order of decreasing statistic as the threshold is swept
+      //   downwards, with clusters merged using a union-find structure. Since
+      //   the size of a cluster can only change when elements are added to it,
+      //   its contribution is accumulated analytically over the range of
+      //   thresholds for which its size remains constant, and propagated to
+      //   its members via the offsets stored along the union-find tree.
+      class ClusterSizeIntegrator
+      { MEMALIGN (ClusterSizeIntegrator)
+        public:
+          // The functor provided determines whether an element with the
+          //   given statistic is supra-threshold, and must be consistent
+          //   with the cluster definition used by the enhancer
+          using test_type = bool (*) (const value_type /*statistic*/, const value_type /*threshold*/);
+          ClusterSizeIntegrator (test_type test) : exceeds (test) { }
+
+          template <class AdjacencyType>
+          void operator() (const AdjacencyType& adjacency,
+                           matrix_type::ConstColXpr in,
+                           const value_type dH, const value_type E, const value_type H,
+                           matrix_type::ColXpr out);
+
+        private:
+          const test_type exceeds;
+          vector<value_type> thresholds, cumulative, accumulated, offset;
+          vector<uint32_t> order, parent, size, since;
+          value_type zero_term, exponent;
+
+          void initialise (matrix_type::ConstColXpr, const value_type, const value_type, const value_type);
+          uint32_t find (const uint32_t);
+          void flush (const uint32_t, const size_t);
+          void merge (uint32_t, uint32_t, const size_t);
+          value_type total (const uint32_t);
+      };
+
+
+
+
       class Wrapper : public Stats::EnhancerBase
       { MEMALIGN (Wrapper)
         public:
@@ -79,6 +127,36 @@ namespace MR
 
 
 
+
+
+
+      template <class AdjacencyType>
+      void ClusterSizeIntegrator::operator() (const AdjacencyType& adjacency,
+                                              matrix_type::ConstColXpr in,
+                                              const value_type dH, const value_type E, const value_type H,
+                                              matrix_type::ColXpr out)
+      {
+        initialise (in, dH, E, H);
+        const uint32_t not_included = parent.size();
+        size_t next = 0;
+        for (size_t k = thresholds.size(); k-- > 0; ) {
+          while (next != order.size() && exceeds (in[order[next]], thresholds[k])) {
+            const uint32_t index = order[next++];
+            parent[index] = index;
+            size[index] = 1;
+            since[index] = k+1;
+            for (const auto neighbour : adjacency[index]) {
+              if (parent[neighbour] != not_included)
+                merge (find (index), find (neighbour), k+1);
+            }
+          }
+        }
+        for (size_t index = 0; index != parent.size(); ++index)
+          out[index] = zero_term * cumulative.back() + (parent[index] == not_included ? 0.0 : total (index));
+      }
+
+
+
     }
   }
 }
@@ -0,0 +1,130 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "thread_queue.h"
+#include "timer.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "benchmark throughput of the mutex-based and lock-free Thread::Queue backends";
+
+  DESCRIPTION
+  + "This measures the number of items per second that can be passed through "
+    "a Thread::Queue for the 1->N, N->1 and N->N topologies, where N is the "
+    "number of threads (as set using the -nthreads option).";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("items", "the total number of items to send through each queue (default: 1000000)")
+  +   Argument ("num").type_integer (1)
+
+  + Option ("capacity", "the capacity of each queue (default: " + str(MRTRIX_QUEUE_DEFAULT_CAPACITY) + ")")
+  +   Argument ("num").type_integer (1);
+}
+
+
+
+using MyQueue = Thread::Queue<size_t>;
+
+
+class Sender { NOMEMALIGN
+  public:
+    Sender (MyQueue& queue, size_t num_items) : writer (queue), num_items (num_items) { }
+
+    void execute () {
+      MyQueue::Writer::Item item (writer);
+      for (size_t n = 0; n < num_items; ++n) {
+        *item = n+1;
+        if (!item.write())
+          break;
+      }
+    }
+
+  private:
+    MyQueue::Writer writer;
+    const size_t num_items;
+};
+
+
+class Receiver { NOMEMALIGN
+  public:
+    Receiver (MyQueue& queue, std::atomic<size_t>& total) : reader (queue), total (total) { }
+
+    void execute () {
+      MyQueue::Reader::Item item (reader);
+      size_t sum = 0;
+      while (item.read())
+        sum += *item;
+      total += sum;
+    }
+
+  private:
+    MyQueue::Reader reader;
+    std::atomic<size_t>& total;
+};
+
+
+
+default_type benchmark (size_t num_senders, size_t num_receivers, size_t num_items, size_t capacity, bool lock_free)
+{
+  const size_t items_per_sender = num_items / num_senders;
+  std::atomic<size_t> total (0);
+  Timer timer;
+  {
+    MyQueue queue ("benchmark", capacity, lock_free);
+    Sender sender (queue, items_per_sender);
+    Receiver receiver (queue, total);
+    auto senders = Thread::run (Thread::multi (sender, num_senders), "senders");
+    auto receivers = Thread::run (Thread::multi (receiver, num_receivers), "receivers");
+    senders.wait();
+    receivers.wait();
+  }
+  const default_type elapsed = timer.elapsed();
+
+  if (total != num_senders * items_per_sender * (items_per_sender+1) / 2)
+    throw Exception (std::string ("items lost or corrupted in ") + ( lock_free ? "lock-free" : "mutex-based" ) + " queue");
+
+  return num_senders * items_per_sender / elapsed;
+}
+
+
+
+void run ()
+{
+  const size_t num_items = get_option_value ("items", 1000000);
+  const size_t capacity = get_option_value ("capacity", MRTRIX_QUEUE_DEFAULT_CAPACITY);
+  const size_t N = std::max (Thread::number_of_threads(), size_t(1));
+
+  const vector<std::pair<size_t,size_t>> topologies = { { 1, N }, { N, 1 }, { N, N } };
+  for (const auto& topology : topologies) {
+    const default_type mutex_rate = benchmark (topology.first, topology.second, num_items, capacity, false);
+    const default_type lock_free_rate = benchmark (topology.first, topology.second, num_items, capacity, true);
+    std::cout << topology.first << "->" << topology.second << ": "
+      << "mutex-based: " << str(mutex_rate, 4) << " items/s; "
+      << "lock-free: " << str(lock_free_rate, 4) << " items/s; "
+      << "speedup: " << str(lock_free_rate / mutex_rate, 3) << "\n";
+  }
+}
+
@@ -0,0 +1,156 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "file/path.h"
+#include "file/utils.h"
+#include "math/rng.h"
+#include "math/stats/typedefs.h"
+
+#include "fixel/matrix.h"
+#include "stats/cfe.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that CFE using the compressed sparse row connectivity matrix matches CFE using Fixel::Matrix::Reader";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+// CFE as computed from the connectivity of each fixel as provided by Fixel::Matrix::Reader:
+matrix_type reference (const Fixel::Matrix::Reader& matrix, const matrix_type& stats,
+                       const value_type dh, const value_type E, const value_type H, const value_type C, const bool normalise)
+{
+  matrix_type enhanced_stats (matrix_type::Zero (stats.rows(), 1));
+  for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
+    if (stats(fixel,0) < dh)
+      continue;
+    auto connections = matrix[fixel];
+    if (C != 1.0) {
+      default_type sum = 0.0;
+      for (auto& c : connections) {
+        c.exponentiate (C);
+        sum += c.value();
+      }
+      connections.normalise (Fixel::Matrix::connectivity_value_type (sum));
+    }
+    vector<Fixel::Matrix::connectivity_value_type> extents (std::floor (stats(fixel,0)/dh), Fixel::Matrix::connectivity_value_type(0));
+    for (const auto& connection : connections) {
+      const default_type connection_stat = stats(connection.index(),0);
+      if (connection_stat > dh) {
+        const size_t cluster_count = std::min (extents.size(), size_t(std::floor (connection_stat / dh)));
+        for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
+          extents[cluster_index] += connection.value();
+      }
+    }
+    for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
+      enhanced_stats(fixel,0) += std::pow (extents[cluster_index], E) * std::pow (dh*(cluster_index+1), H);
+    if (normalise)
+      enhanced_stats(fixel,0) *= connections.norm_multiplier;
+  }
+  return enhanced_stats;
+}
+
+
+
+void check (const Fixel::Matrix::Reader& matrix, const matrix_type& stats, const std::string& description)
+{
+  const value_type dh = 0.1, E = 2.0, H = 3.0;
+  for (const value_type C : { 1.0, 0.5 }) {
+    for (const bool normalise : { false, true }) {
+      matrix_type actual (stats.rows(), 1);
+      Stats::CFE cfe (matrix, dh, E, H, C, normalise);
+      static_cast<Stats::EnhancerBase&> (cfe) (stats, actual);
+      const matrix_type expected = reference (matrix, stats, dh, E, H, C, normalise);
+      for (ssize_t fixel = 0; fixel != stats.rows(); ++fixel) {
+        if (actual(fixel,0) != expected(fixel,0))
+          throw Exception ("CFE mismatch " + description + " (C=" + str(C) + ", normalise=" + str(normalise) + ") at fixel "
+                           + str(fixel) + ": expected " + str(expected(fixel,0)) + ", got " + str(actual(fixel,0)));
+      }
+    }
+  }
+}
+
+
+
+void run ()
+{
+  Math::RNG rng (1);
+  std::normal_distribution<value_type> normal;
+  std::uniform_int_distribution<ssize_t> uniform (-3, 3);
+
+  // synthetic connectivity from streamlines traversing nearby fixels:
+  const size_t num_fixels = 500;
+  Fixel::Matrix::init_matrix_type init_matrix (num_fixels);
+  for (size_t track = 0; track != 5000; ++track) {
+    ssize_t fixel = std::uniform_int_distribution<size_t> (0, num_fixels-1) (rng);
+    vector<Fixel::index_type> indices;
+    for (size_t step = 0; step != 10; ++step) {
+      fixel = std::max (ssize_t(0), std::min (ssize_t(num_fixels-1), fixel + uniform (rng)));
+      indices.push_back (fixel);
+    }
+    std::sort (indices.begin(), indices.end());
+    indices.erase (std::unique (indices.begin(), indices.end()), indices.end());
+    for (auto i : indices)
+      init_matrix[i].add (indices);
+  }
+
+  const std::string directory = File::create_tempfile (0, "matrix");
+  File::remove (directory);
+  try {
+    Fixel::Matrix::normalise_and_write (init_matrix, 0.01, directory);
+
+    // spatially smooth statistic, such that clusters span several thresholds:
+    matrix_type stats (num_fixels, 1);
+    value_type value = 0.0;
+    for (size_t fixel = 0; fixel != num_fixels; ++fixel) {
+      value = 0.8 * value + normal (rng);
+      stats(fixel,0) = std::abs (value);
+    }
+
+    check (Fixel::Matrix::Reader (directory), stats, "without mask");
+
+    Header header;
+    header.ndim() = 3;
+    header.size(0) = num_fixels;
+    header.size(1) = header.size(2) = 1;
+    header.spacing(0) = header.spacing(1) = header.spacing(2) = 1.0;
+    header.transform().setIdentity();
+    header.datatype() = DataType::Bit;
+    auto mask = Image<bool>::scratch (header, "fixel mask");
+    for (size_t fixel = 0; fixel != num_fixels; ++fixel) {
+      mask.index(0) = fixel;
+      mask.value() = (fixel % 7) && (fixel < 200 || fixel > 250);
+    }
+    check (Fixel::Matrix::Reader (directory, mask), stats, "with mask");
+  }
+  catch (...) {
+    File::rmdir (directory, true);
+    throw;
+  }
+  File::rmdir (directory, true);
+}
+
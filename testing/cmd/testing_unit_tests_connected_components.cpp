@@ -0,0 +1,155 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <deque>
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "filter/connected_components.h"
+#include "math/rng.h"
+#include "misc/voxel2vector.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that union-find connected component labelling matches a breadth-first search";
+  DESCRIPTION
+  + "This should be run with a range of values for the -nthreads option.";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+// labels & cluster sizes obtained from a breadth-first search over the voxel
+//   grid, visiting voxels in the order of their vectorised indices, such that
+//   clusters are labelled in the order of their lowest index:
+void reference (const Header& header, const Voxel2Vector& v2v, const vector<bool>& include, const bool use_26_neighbours,
+                vector<uint32_t>& labels, vector<uint32_t>& sizes)
+{
+  vector<std::array<int,3>> offsets;
+  for (int z = -1; z <= 1; ++z)
+    for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x)
+        if (std::abs (x) + std::abs (y) + std::abs (z) == 1 || (use_26_neighbours && (x || y || z)))
+          offsets.push_back ({ x, y, z });
+
+  labels.assign (v2v.size(), 0);
+  sizes.clear();
+  for (uint32_t seed = 0; seed != v2v.size(); ++seed) {
+    if (!include[seed] || labels[seed])
+      continue;
+    sizes.push_back (0);
+    labels[seed] = sizes.size();
+    std::deque<uint32_t> queue (1, seed);
+    while (queue.size()) {
+      const uint32_t i = queue.front();
+      queue.pop_front();
+      ++sizes.back();
+      for (const auto& o : offsets) {
+        vector<int> pos (3);
+        for (size_t axis = 0; axis != 3; ++axis)
+          pos[axis] = int(v2v[i][axis]) + o[axis];
+        if (pos[0] < 0 || pos[1] < 0 || pos[2] < 0 ||
+            pos[0] >= header.size(0) || pos[1] >= header.size(1) || pos[2] >= header.size(2))
+          continue;
+        const uint32_t j = v2v (pos);
+        if (j != v2v.invalid && include[j] && !labels[j]) {
+          labels[j] = labels[seed];
+          queue.push_back (j);
+        }
+      }
+    }
+  }
+}
+
+
+
+void compare (const std::string& description, const vector<Filter::Connector::Cluster>& clusters, const vector<uint32_t>& labels,
+              const vector<uint32_t>& expected_labels, const vector<uint32_t>& expected_sizes)
+{
+  if (clusters.size() != expected_sizes.size())
+    throw Exception (description + ": found " + str(clusters.size()) + " clusters, expected " + str(expected_sizes.size()));
+  for (size_t c = 0; c != clusters.size(); ++c) {
+    if (clusters[c].label != c+1 || clusters[c].size != expected_sizes[c])
+      throw Exception (description + ": cluster " + str(c) + " has label " + str(clusters[c].label) + " & size " + str(clusters[c].size)
+          + ", expected label " + str(c+1) + " & size " + str(expected_sizes[c]));
+  }
+  if (labels != expected_labels)
+    throw Exception (description + ": labels do not match breadth-first search");
+}
+
+
+
+void run ()
+{
+  Math::RNG rng (1);
+  std::uniform_real_distribution<float> uniform;
+
+  // large enough for labelling to be distributed across threads for the
+  //   denser masks:
+  Header header;
+  header.ndim() = 3;
+  header.size(0) = 91;
+  header.size(1) = 83;
+  header.size(2) = 37;
+  for (size_t axis = 0; axis != 3; ++axis)
+    header.spacing(axis) = 1.0;
+  header.transform().setIdentity();
+  header.datatype() = DataType::Bit;
+
+  for (const float density : { 0.1f, 0.25f, 0.35f, 0.6f }) {
+    auto mask = Image<bool>::scratch (header, "random mask");
+    for (auto l = Loop (mask) (mask); l; ++l)
+      mask.value() = uniform (rng) < density;
+    Voxel2Vector v2v (mask, header);
+    const vector<bool> include (v2v.size(), true);
+
+    // random values within the mask, to be thresholded:
+    vector<float> data (v2v.size());
+    for (auto& value : data)
+      value = uniform (rng);
+    vector<bool> above (v2v.size());
+    for (size_t i = 0; i != v2v.size(); ++i)
+      above[i] = data[i] > 0.5f;
+
+    for (const bool use_26_neighbours : { false, true }) {
+      Filter::Connector connector;
+      connector.adjacency.set_26_adjacency (use_26_neighbours);
+      connector.adjacency.initialise (header, v2v);
+      const std::string description = "density " + str(density) + ", " + str(use_26_neighbours ? 26 : 6) + "-neighbour";
+
+      vector<uint32_t> expected_labels, expected_sizes;
+      vector<Filter::Connector::Cluster> clusters;
+      vector<uint32_t> labels;
+
+      reference (header, v2v, include, use_26_neighbours, expected_labels, expected_sizes);
+      connector.run (clusters, labels);
+      compare (description, clusters, labels, expected_labels, expected_sizes);
+
+      reference (header, v2v, above, use_26_neighbours, expected_labels, expected_sizes);
+      clusters.clear();
+      connector.run (clusters, labels, data, 0.5f);
+      compare (description + ", thresholded", clusters, labels, expected_labels, expected_sizes);
+    }
+  }
+}
+
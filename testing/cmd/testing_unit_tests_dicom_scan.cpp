@@ -0,0 +1,201 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "command.h"
+#include "exception.h"
+#include "file/config.h"
+#include "file/path.h"
+#include "file/utils.h"
+#include "file/dicom/image.h"
+#include "file/dicom/series.h"
+#include "file/dicom/study.h"
+#include "file/dicom/patient.h"
+#include "file/dicom/tree.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::File::Dicom;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of parallel & cached DICOM folder scanning";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+std::string uint16 (uint16_t value)
+{
+  return { char (value & 0xFF), char (value >> 8) };
+}
+
+void put_element (std::string& out, uint16_t group, uint16_t element, const std::string& VR, std::string value)
+{
+  if (value.size() & 1)
+    value += ' ';
+  out += uint16 (group) + uint16 (element) + VR;
+  if (VR == "OW")
+    out += uint16 (0) + uint16 (value.size() & 0xFFFF) + uint16 (value.size() >> 16);
+  else
+    out += uint16 (value.size());
+  out += value;
+}
+
+// write a minimal explicit VR little-endian DICOM file, with an 8x8 image:
+void write_dicom (const std::string& filename, const std::string& patient, size_t series_number, size_t instance)
+{
+  std::string out (128, '\0');
+  out += "DICM";
+  put_element (out, 0x0008, 0x0060, "CS", "MR");
+  put_element (out, 0x0008, 0x103E, "LO", "series " + str(series_number));
+  put_element (out, 0x0010, 0x0010, "PN", patient);
+  put_element (out, 0x0020, 0x0011, "IS", str(series_number));
+  put_element (out, 0x0020, 0x0013, "IS", str(instance));
+  put_element (out, 0x0028, 0x0010, "US", uint16 (8));
+  put_element (out, 0x0028, 0x0011, "US", uint16 (8));
+  put_element (out, 0x0028, 0x0100, "US", uint16 (16));
+  put_element (out, 0x7FE0, 0x0010, "OW", std::string (128, char (instance)));
+
+  std::ofstream stream (filename, std::ios::out | std::ios::binary | std::ios::trunc);
+  stream.write (out.data(), out.size());
+  if (!stream)
+    throw Exception ("error writing test DICOM file \"" + filename + "\"");
+}
+
+
+
+// a summary of the tree, listing the files in each series in the order
+// in which they were merged:
+std::string describe (const std::string& folder)
+{
+  Tree tree;
+  tree.read (folder);
+  std::string summary;
+  for (const auto& patient : tree) {
+    summary += "patient " + patient->name + "\n";
+    for (const auto& study : *patient) {
+      for (const auto& series : *study) {
+        summary += "  series " + str(series->number) + ":";
+        vector<std::string> filenames;
+        for (const auto& image : *series)
+          filenames.push_back (image->filename);
+        if (!std::is_sorted (filenames.begin(), filenames.end()))
+          throw Exception ("files not merged into series in sorted order");
+        for (const auto& filename : filenames)
+          summary += " " + Path::basename (filename);
+        summary += "\n";
+      }
+    }
+  }
+  return summary;
+}
+
+
+
+void set_mtime (const std::string& filename, const struct timespec& mtime)
+{
+  const struct timespec times[2] = { mtime, mtime };
+  if (utimensat (AT_FDCWD, filename.c_str(), times, 0))
+    throw Exception ("error setting modification time of file \"" + filename + "\"");
+}
+
+
+
+void check (const std::string& folder, const std::string& cache_file)
+{
+  const vector<std::string> subfolders = { folder, Path::join (folder, "a"), Path::join (folder, "a/b"), Path::join (folder, "c") };
+  for (size_t n = 1; n != subfolders.size(); ++n)
+    File::mkdir (subfolders[n]);
+  vector<std::string> files;
+  for (size_t i = 0; i != 30; ++i) {
+    files.push_back (Path::join (subfolders[i%4], "im" + str(i, 2)));
+    write_dicom (files.back(), "P" + str(i%3), i%2 + 1, i);
+  }
+  {
+    std::ofstream notes (Path::join (subfolders[1], "notes.txt"));
+    notes << "not a DICOM file\n";
+  }
+
+  File::Config::set ("DicomScanCache", "");
+  const std::string reference = describe (folder);
+  if (reference.find ("patient P0") == std::string::npos || reference.find ("patient P2") == std::string::npos)
+    throw Exception ("unexpected contents of scanned folder:\n" + reference);
+
+  // without a cache file, then reusing it:
+  File::Config::set ("DicomScanCache", cache_file);
+  if (describe (folder) != reference)
+    throw Exception ("scan writing cache file does not match reference");
+  if (!Path::exists (cache_file))
+    throw Exception ("DICOM scan cache file not saved");
+  if (describe (folder) != reference)
+    throw Exception ("scan using cache file does not match reference");
+
+  // a modified file with unchanged size & modification time is not parsed
+  // again, so the change is not detected:
+  struct stat sbuf;
+  if (stat (files[0].c_str(), &sbuf))
+    throw Exception ("cannot stat test DICOM file");
+  write_dicom (files[0], "Q0", 1, 0);
+  set_mtime (files[0], sbuf.st_mtim);
+  if (describe (folder) != reference)
+    throw Exception ("cached entry not used for unchanged file");
+
+  // but is once its modification time has changed, even within the same second:
+  struct timespec mtime = sbuf.st_mtim;
+  mtime.tv_nsec = (mtime.tv_nsec + 500000000) % 1000000000;
+  set_mtime (files[0], mtime);
+  const std::string modified = describe (folder);
+  if (modified.find ("patient Q0") == std::string::npos)
+    throw Exception ("cached entry used for modified file");
+  File::Config::set ("DicomScanCache", "");
+  if (describe (folder) != modified)
+    throw Exception ("scan without cache does not match scan with updated cache");
+
+  // removed files must be dropped from the cache:
+  File::Config::set ("DicomScanCache", cache_file);
+  File::remove (files[0]);
+  const std::string removed = describe (folder);
+  if (removed.find ("patient Q0") != std::string::npos || removed.find ("im00") != std::string::npos)
+    throw Exception ("removed file still present in scan using cache");
+}
+
+
+
+void run ()
+{
+  const std::string folder = File::create_tempfile (0, "dicom");
+  const std::string cache_file = folder + ".cache";
+  File::remove (folder);
+  File::mkdir (folder);
+  try {
+    check (folder, cache_file);
+  }
+  catch (...) {
+    File::rmdir (folder, true);
+    if (Path::exists (cache_file))
+      File::remove (cache_file);
+    throw;
+  }
+  File::rmdir (folder, true);
+  File::remove (cache_file);
+}
+
@@ -0,0 +1,115 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+
+#include "command.h"
+#include "exception.h"
+#include "types.h"
+#include "math/rng.h"
+#include "math/stats/glm.h"
+#include "math/stats/typedefs.h"
+
+using namespace MR;
+using namespace App;
+using namespace Math::Stats;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that batched evaluation of shuffles in the GLM matches evaluation of each shuffle individually";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void run ()
+{
+  Math::RNG rng (1);
+  std::normal_distribution<default_type> normal;
+
+  // Sufficient inputs & shuffles that the batch is split across multiple passes
+  const size_t num_inputs = 300, num_elements = 100, num_shuffles = 40;
+
+  matrix_type design (num_inputs, 3);
+  matrix_type data (num_inputs, num_elements);
+  index_array_type variance_groups (num_inputs);
+  for (size_t i = 0; i != num_inputs; ++i) {
+    design (i, 0) = 1.0;
+    design (i, 1) = normal (rng);
+    design (i, 2) = i % 2 ? 1.0 : -1.0;
+    variance_groups[i] = i % 2;
+    for (size_t e = 0; e != num_elements; ++e)
+      data (i, e) = normal (rng) + (e % 5) * 0.1 * design (i, 1) * (1.0 + variance_groups[i]);
+  }
+
+  matrix_type t_contrast (matrix_type::Zero (1, 3));
+  t_contrast (0, 1) = 1.0;
+  matrix_type F_contrast (matrix_type::Zero (2, 3));
+  F_contrast (0, 1) = F_contrast (1, 2) = 1.0;
+  vector<GLM::Hypothesis> hypotheses;
+  matrix_type::ConstRowXpr t_row (static_cast<const matrix_type&> (t_contrast).row (0));
+  hypotheses.emplace_back (t_row, 0);
+  hypotheses.emplace_back (F_contrast, 1);
+
+  // Permutations combined with sign-flips
+  vector<matrix_type> shuffles;
+  vector<size_t> permutation (num_inputs);
+  for (size_t i = 0; i != num_inputs; ++i)
+    permutation[i] = i;
+  std::uniform_int_distribution<int> coin (0, 1);
+  for (size_t s = 0; s != num_shuffles; ++s) {
+    std::shuffle (permutation.begin(), permutation.end(), rng);
+    matrix_type S (matrix_type::Zero (num_inputs, num_inputs));
+    for (size_t i = 0; i != num_inputs; ++i)
+      S (i, permutation[i]) = coin (rng) ? 1.0 : -1.0;
+    shuffles.push_back (S);
+  }
+
+  vector<std::string> failed_tests;
+  auto test = [&] (const GLM::TestBase& glm, const std::string& name)
+  {
+    vector<matrix_type> batched;
+    glm (shuffles, batched);
+    if (batched.size() != num_shuffles) {
+      failed_tests.push_back (name + ": incorrect number of outputs");
+      return;
+    }
+    matrix_type individual;
+    for (size_t s = 0; s != num_shuffles; ++s) {
+      glm (shuffles[s], individual);
+      if (batched[s].rows() != individual.rows() || batched[s].cols() != individual.cols()) {
+        failed_tests.push_back (name + ": incorrect dimensions for shuffle " + str(s));
+        return;
+      }
+      const default_type max_diff = (batched[s] - individual).array().abs().maxCoeff();
+      if (!(max_diff < 1e-6)) {
+        failed_tests.push_back (name + ": shuffle " + str(s) + " differs by " + str(max_diff));
+        return;
+      }
+    }
+  };
+
+  test (GLM::TestFixedHomoscedastic (data, design, hypotheses), "fixed homoscedastic");
+  test (GLM::TestFixedHeteroscedastic (data, design, hypotheses, variance_groups), "fixed heteroscedastic");
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of batched GLM evaluation failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
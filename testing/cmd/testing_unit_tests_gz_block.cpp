@@ -0,0 +1,109 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "file/gz.h"
+#include "file/gz_block.h"
+#include "file/utils.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of block-compressed GZip file handling";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void run ()
+{
+  constexpr size_t lead_in_size = 352;
+  constexpr size_t data_size = 1000003;
+  constexpr size_t block_size = 65536;
+
+  vector<uint8_t> data (lead_in_size + data_size);
+  uint32_t state = 1;
+  for (size_t n = 0; n < data.size(); ++n) {
+    state = 1664525U * state + 1013904223U;
+    data[n] = (n % 7) ? uint8_t (n / 1024) : uint8_t (state >> 24);
+  }
+
+  const std::string filename = File::create_tempfile (0, "gz");
+  try {
+    {
+      File::GZBlock::Writer writer (filename, block_size);
+      writer.write (data.data(), lead_in_size);
+      writer.write (data.data() + lead_in_size, data_size);
+      writer.close();
+    }
+
+    // check output is a valid GZip stream:
+    {
+      vector<uint8_t> decoded (data.size() + 1);
+      File::GZ zf (filename, "rb");
+      if (zf.read (reinterpret_cast<char*> (decoded.data()), decoded.size()) != int (data.size()))
+        throw Exception ("size mismatch when reading block-compressed file as regular GZip stream");
+      decoded.resize (data.size());
+      if (decoded != data)
+        throw Exception ("data mismatch when reading block-compressed file as regular GZip stream");
+    }
+
+    File::GZBlock::Reader reader (filename);
+    if (!reader.is_block_compressed())
+      throw Exception ("block-compressed file not recognised as such");
+    if (reader.size() != int64_t (data.size()))
+      throw Exception ("size mismatch in block index: expected " + str(data.size()) + ", got " + str(reader.size()));
+    if (reader.index().size() != 1 + (data_size + block_size - 1) / block_size)
+      throw Exception ("unexpected number of blocks in index");
+
+    // check random access to ranges aligned and unaligned with block boundaries:
+    const vector<std::pair<int64_t,int64_t>> ranges = {
+      { 0, data.size() },
+      { 0, lead_in_size },
+      { lead_in_size, data_size },
+      { lead_in_size + block_size, block_size },
+      { lead_in_size + 1000, 3*block_size + 17 },
+      { data.size() - 5, 5 }
+    };
+    for (const auto& range : ranges) {
+      vector<uint8_t> decoded (range.second);
+      reader.read (range.first, decoded.data(), range.second);
+      if (memcmp (decoded.data(), data.data() + range.first, range.second))
+        throw Exception ("data mismatch when reading " + str(range.second) + " bytes at offset " + str(range.first));
+    }
+  }
+  catch (...) {
+    File::remove (filename);
+    throw;
+  }
+  File::remove (filename);
+
+  // regular GZip streams should not be detected as block-compressed:
+  const std::string regular = File::create_tempfile (0, "gz");
+  {
+    File::GZ zf (regular, "wb");
+    zf.write (reinterpret_cast<const char*> (data.data()), data.size());
+  }
+  const bool detected = File::GZBlock::Reader (regular).is_block_compressed();
+  File::remove (regular);
+  if (detected)
+    throw Exception ("regular GZip stream incorrectly detected as block-compressed");
+}
+
@@ -0,0 +1,85 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "header.h"
+#include "image_io/gz.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the byte ranges decompressed for images with restricted access";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+using Ranges = vector<std::pair<int64_t,int64_t>>;
+
+std::string to_string (const Ranges& ranges)
+{
+  std::string s;
+  for (const auto& r : ranges)
+    s += "[" + str(r.first) + "," + str(r.second) + ") ";
+  return s;
+}
+
+
+
+// a 4x5x6x10 float32 image with the given strides, with access
+// restricted to positions { 1, 2, 3, 5 } along axis:
+void check (const vector<ssize_t>& strides, size_t axis, const Ranges& expected)
+{
+  Header header;
+  header.ndim() = 4;
+  const vector<ssize_t> sizes = { 4, 5, 6, 10 };
+  for (size_t n = 0; n != 4; ++n) {
+    header.size(n) = sizes[n];
+    header.stride(n) = strides[n];
+  }
+  header.datatype() = DataType::Float32;
+
+  ImageIO::GZ io (header, 0);
+  io.files.push_back (File::Entry ("image.nii.gz", 0));
+  io.restrict_access (axis, { 5, 1, 3, 2 });
+  const Ranges ranges = io.required_ranges (header);
+  if (ranges != expected)
+    throw Exception ("incorrect ranges for strides " + str(strides) + ", axis " + str(axis) + ": expected "
+        + to_string (expected) + "got " + to_string (ranges));
+}
+
+
+
+void run ()
+{
+  // volumes outermost, forward & flipped:
+  const int64_t volume = 4*5*6*4;
+  check ({ 1, 2, 3, 4 }, 3, { { volume, 3*volume }, { 5*volume, volume } });
+  check ({ 1, 2, 3, -4 }, 3, { { 4*volume, volume }, { 6*volume, 3*volume } });
+
+  // permuted, with slices outermost, forward & flipped:
+  const int64_t slice = 4*5*10*4;
+  check ({ 2, 3, 4, 1 }, 2, { { slice, 3*slice }, { 5*slice, slice } });
+  check ({ -2, 3, -4, 1 }, 2, { { 0, slice }, { 2*slice, 3*slice } });
+
+  // access along an axis that is not outermost cannot be restricted:
+  const Ranges full = { { 0, 0 } };
+  check ({ 1, 2, 4, 3 }, 3, full);
+}
+
@@ -0,0 +1,106 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "math/lanczos.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the Ritz values & residuals of the Lanczos partial eigendecomposition";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+template <typename T> T random_value (std::mt19937& rng);
+template <> double random_value (std::mt19937& rng) { return std::normal_distribution<double>() (rng); }
+template <> cdouble random_value (std::mt19937& rng) { return { random_value<double> (rng), random_value<double> (rng) }; }
+
+
+
+// a covariance matrix of size r with the spectrum typical of a DWI patch: a
+// few large signal eigenvalues, and a bulk of noise eigenvalues:
+template <typename T>
+void check (ssize_t r, ssize_t k)
+{
+  using MatrixType = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+  using VectorType = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+
+  std::mt19937 rng (r);
+  MatrixType X (r, 2*r);
+  for (ssize_t j = 0; j < X.cols(); ++j)
+    for (ssize_t i = 0; i < r; ++i)
+      X(i,j) = random_value<T> (rng);
+  for (ssize_t n = 0; n < 6; ++n)
+    X.col(n) *= 1000.0 / (n+1);
+  const MatrixType A = X * X.adjoint();
+
+  VectorType v0 (r);
+  for (ssize_t i = 0; i < r; ++i)
+    v0[i] = random_value<T> (rng);
+  v0.normalize();
+
+  Math::Lanczos<MatrixType> lanczos;
+  if (!lanczos.compute (A, v0, k))
+    throw Exception ("unexpected breakdown of Lanczos iteration for r = " + str(r) + ", k = " + str(k));
+
+  const Eigen::VectorXd lambda = Eigen::SelfAdjointEigenSolver<MatrixType> (A).eigenvalues();
+  const Eigen::VectorXd& theta = lanczos.eigenvalues();
+  const Eigen::VectorXd& residual = lanczos.residuals();
+  const MatrixType U = lanczos.eigenvectors (k);
+
+  for (ssize_t i = 0; i < k; ++i) {
+    // the residuals reported must match those of the Ritz vectors:
+    const double actual = (A * U.col(i) - T(theta[i]) * U.col(i)).norm();
+    if (std::abs (actual - residual[i]) > 1.0e-6 * lambda[r-1])
+      throw Exception ("residual of Ritz pair " + str(i) + " is " + str(actual) + ", reported as " + str(residual[i]));
+
+    // and bound the distance to the nearest eigenvalue:
+    const double distance = (lambda.array() - theta[i]).abs().minCoeff();
+    if (distance > residual[i] + 1.0e-9 * lambda[r-1])
+      throw Exception ("Ritz value " + str(i) + " (" + str(theta[i]) + ") lies " + str(distance)
+          + " from nearest eigenvalue, greater than residual " + str(residual[i]));
+  }
+
+  // the largest (signal) eigenvalues must have converged:
+  for (ssize_t i = 1; i <= 6; ++i) {
+    if (residual[k-i] > 1.0e-6 * theta[k-i])
+      throw Exception ("Ritz value " + str(k-i) + " has not converged: residual " + str(residual[k-i]));
+    if (std::abs (theta[k-i] - lambda[r-i]) > 1.0e-9 * lambda[r-i])
+      throw Exception ("Ritz value " + str(k-i) + " (" + str(theta[k-i]) + ") does not match eigenvalue " + str(lambda[r-i]));
+  }
+
+  // Ritz values must lie within the range of the eigenvalues:
+  if (theta[0] < lambda[0] - 1.0e-9 * lambda[r-1] || theta[k-1] > lambda[r-1] * (1.0 + 1.0e-9))
+    throw Exception ("Ritz values lie outside the range of the eigenvalues");
+}
+
+
+
+void run ()
+{
+  check<double> (64, 32);
+  check<double> (100, 50);
+  check<double> (150, 64);
+  check<cdouble> (100, 50);
+}
+
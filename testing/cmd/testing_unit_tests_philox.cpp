@@ -0,0 +1,98 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "math/rng.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of the Math::Philox random number generator";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void check_block (const std::array<uint32_t,2>& key, const std::array<uint32_t,4>& counter, const std::array<uint32_t,4>& expected)
+{
+  const auto result = Math::Philox::block (key, counter);
+  if (result != expected)
+    throw Exception ("Philox4x32-10 output does not match known answer: expected "
+        + str(expected[0]) + " " + str(expected[1]) + " " + str(expected[2]) + " " + str(expected[3]) + ", got "
+        + str(result[0]) + " " + str(result[1]) + " " + str(result[2]) + " " + str(result[3]));
+}
+
+
+
+void run ()
+{
+  // known-answer tests from the Random123 distribution:
+  check_block ({{ 0x00000000, 0x00000000 }}, {{ 0x00000000, 0x00000000, 0x00000000, 0x00000000 }},
+               {{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }});
+  check_block ({{ 0xffffffff, 0xffffffff }}, {{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }},
+               {{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd }});
+  check_block ({{ 0xa4093822, 0x299f31d0 }}, {{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }},
+               {{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }});
+
+  // the sequence is determined by key & stream, and discard() skips ahead exactly:
+  Math::Philox reference (12345, 67), rng (1, 2);
+  vector<uint32_t> sequence (1000);
+  for (auto& x : sequence)
+    x = reference();
+  rng.seed (12345, 67);
+  for (size_t n = 0; n != sequence.size(); ++n)
+    if (rng() != sequence[n])
+      throw Exception ("Philox sequence not reproduced after re-seeding (at position " + str(n) + ")");
+  for (size_t skip : { 0, 1, 3, 4, 5, 7, 8, 9, 63, 64, 65, 401 }) {
+    for (size_t start : { 0, 1, 2, 3, 4, 5 }) {
+      rng.seed (12345, 67);
+      for (size_t n = 0; n != start; ++n)
+        rng();
+      rng.discard (skip);
+      if (rng() != sequence[start+skip])
+        throw Exception ("Philox::discard (" + str(skip) + ") after " + str(start) + " outputs does not match sequence");
+    }
+  }
+
+  // neighbouring streams and keys are distinct:
+  for (const auto other : { std::make_pair (12345, 68), std::make_pair (12346, 67) }) {
+    rng.seed (other.first, other.second);
+    size_t matches = 0;
+    for (size_t n = 0; n != sequence.size(); ++n)
+      matches += (rng() == sequence[n]);
+    if (matches > 1)
+      throw Exception ("Philox streams (" + str(other.first) + "," + str(other.second) + ") and (12345,67) are not independent");
+  }
+
+  // usable with the standard distributions:
+  rng.seed (0);
+  std::uniform_real_distribution<default_type> uniform;
+  default_type sum = 0.0;
+  const size_t N = 100000;
+  for (size_t n = 0; n != N; ++n) {
+    const default_type x = uniform (rng);
+    if (x < 0.0 || x >= 1.0)
+      throw Exception ("uniform sample out of range: " + str(x));
+    sum += x;
+  }
+  if (std::abs (sum / N - 0.5) > 5.0 / std::sqrt (12.0 * N))
+    throw Exception ("mean of uniform samples deviates from 0.5: " + str(sum / N));
+}
+
@@ -54,5 +54,36 @@ void run ()
       throw Exception ("difference exceeds tolerance");
   }
 
+  // batched evaluation, spanning several blocks of directions, including the poles:
+  const ssize_t num = 150;
+  Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic> batch_coefs = Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic>::Random (num, NforL (lmax));
+  Eigen::Matrix<value_type,Eigen::Dynamic,3> batch_dirs (num, 3);
+  for (ssize_t n = 0; n < num; ++n)
+    batch_dirs.row(n) = dir_type::Random().normalized().transpose();
+  batch_dirs.row(0) << 0.0, 0.0, 1.0;
+  batch_dirs.row(1) << 0.0, 0.0, -1.0;
+
+  coefs_type amplitudes (num), precomputed_amplitudes (num);
+  values (amplitudes, batch_coefs, batch_dirs, lmax);
+  precomputer.values (precomputed_amplitudes, batch_coefs, batch_dirs);
+  for (ssize_t n = 0; n < num; ++n) {
+    const coefs_type c = batch_coefs.row(n).transpose();
+    const dir_type direction = batch_dirs.row(n).transpose();
+    if (std::abs (value (c, direction, lmax) - amplitudes[n]) > 1e-4)
+      throw Exception ("difference exceeds tolerance for batched evaluation");
+    if (std::abs (precomputer.value (c, direction) - precomputed_amplitudes[n]) > 1e-4)
+      throw Exception ("difference exceeds tolerance for batched precomputed evaluation");
+  }
+
+  // lookup table of the full SH basis, with 1 degree angular spacing:
+  PrecomputedBasis<value_type> lookup (lmax, Math::pi / 180.0);
+  if (!(lookup.max_error() < 5e-3))
+    throw Exception ("estimated error of SH basis lookup table exceeds tolerance (" + str(lookup.max_error()) + ")");
+  for (size_t n = 0; n < 10000; ++n) {
+    dir_type direction = dir_type::Random().normalized();
+    if (std::abs (value (coefs, direction, lmax) - lookup.value (coefs, direction)) > 1e-2)
+      throw Exception ("difference exceeds tolerance for SH basis lookup table");
+  }
+
 }
 
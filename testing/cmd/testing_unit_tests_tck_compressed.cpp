@@ -0,0 +1,244 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <zlib.h>
+
+#include "command.h"
+#include "exception.h"
+#include "file/config.h"
+#include "file/utils.h"
+#include "raw.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of compressed track file writing & reading";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+template <typename ValueType>
+void check_equal (const Streamline<ValueType>& a, const Streamline<ValueType>& b, size_t index)
+{
+  if (a.get_index() != index)
+    throw Exception ("streamline read with incorrect index: expected " + str(index) + ", got " + str(a.get_index()));
+  if (a.size() != b.size())
+    throw Exception ("streamline " + str(index) + " read with incorrect length: expected " + str(b.size()) + ", got " + str(a.size()));
+  // allow for quantisation error, and rounding of the decoded position:
+  const default_type tolerance = 0.5 * Compressed::quantisation() + 1e-5;
+  for (size_t n = 0; n != a.size(); ++n)
+    if ((a[n] - b[n]).cwiseAbs().maxCoeff() > tolerance)
+      throw Exception ("vertex mismatch at position " + str(n) + " in streamline " + str(index));
+}
+
+
+
+template <typename ValueType, class WriterType>
+void check (const std::string& filename)
+{
+  // generate streamlines of varying length, including empty streamlines,
+  // with vertices spread over a range of positions:
+  vector<Streamline<ValueType>> tracks (1000);
+  uint32_t state = 1;
+  for (size_t i = 0; i != tracks.size(); ++i) {
+    tracks[i].resize ((i % 97 == 0) ? 0 : (i * 7) % 61 + 1);
+    for (auto& p : tracks[i]) {
+      for (size_t axis = 0; axis != 3; ++axis) {
+        state = 1664525U * state + 1013904223U;
+        p[axis] = ValueType (state >> 8) / ValueType (1 << 16) - ValueType(128.0);
+      }
+    }
+  }
+
+  {
+    Properties properties;
+    WriterType writer (filename, properties);
+    for (const auto& tck : tracks)
+      writer (tck);
+  }
+
+  // sequential access:
+  {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    Streamline<ValueType> tck;
+    size_t count = 0;
+    while (reader (tck)) {
+      if (count >= tracks.size())
+        throw Exception ("more streamlines read than written");
+      check_equal (tck, tracks[count], count);
+      ++count;
+    }
+    if (count != tracks.size())
+      throw Exception ("fewer streamlines read than written: expected " + str(tracks.size()) + ", got " + str(count));
+    if (to<size_t> (properties["count"]) != tracks.size())
+      throw Exception ("incorrect count in header: " + properties["count"]);
+  }
+
+  // seeking, direct access & range-restricted reading:
+  {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    if (reader.num_streamlines() != tracks.size())
+      throw Exception ("index contains incorrect number of streamlines: expected " + str(tracks.size()) + ", got " + str(reader.num_streamlines()));
+    Streamline<ValueType> tck;
+    for (size_t start : { 0, 1, 96, 97, 500, 999 }) {
+      reader.seek (start);
+      for (size_t i = start; i != std::min (start + 3, tracks.size()); ++i) {
+        if (!reader (tck))
+          throw Exception ("failed to read streamline " + str(i) + " after seeking to " + str(start));
+        check_equal (tck, tracks[i], i);
+      }
+    }
+    reader.seek (tracks.size());
+    if (reader (tck))
+      throw Exception ("streamline read after seeking to end of file");
+
+    for (size_t i : { 999, 0, 97, 500 }) {
+      reader.get (i, tck);
+      check_equal (tck, tracks[i], i);
+    }
+    vector<Streamline<ValueType>> range;
+    reader.get_range (90, 300, range);
+    for (size_t i = 0; i != range.size(); ++i)
+      check_equal (range[i], tracks[90+i], 90+i);
+
+    const size_t num_shards = 7;
+    size_t next = 0;
+    for (size_t n = 0; n != num_shards; ++n) {
+      const auto shard = reader.shard (n, num_shards);
+      if (shard.first != next || shard.second < shard.first)
+        throw Exception ("shard " + str(n) + " of " + str(num_shards) + " is not contiguous with previous shard");
+      reader.set_range (shard.first, shard.second);
+      size_t count = 0;
+      while (reader (tck)) {
+        check_equal (tck, tracks[shard.first + count], count);
+        ++count;
+      }
+      if (count != shard.second - shard.first)
+        throw Exception ("unexpected number of streamlines read from shard " + str(n) + ": expected " + str(shard.second - shard.first) + ", got " + str(count));
+      next = shard.second;
+    }
+    if (next != tracks.size())
+      throw Exception ("shards do not cover all streamlines");
+  }
+
+  // an incomplete file must only yield the streamlines in its complete blocks:
+  {
+    vector<char> contents;
+    {
+      std::ifstream in (filename, std::ios::in | std::ios::binary);
+      contents.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char>());
+    }
+    contents.resize (contents.size() - Compressed::block_header_size - 1);
+    {
+      std::ofstream out (filename, std::ios::out | std::ios::binary | std::ios::trunc);
+      out.write (contents.data(), contents.size());
+    }
+
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    const size_t num = reader.num_streamlines();
+    if (num >= tracks.size())
+      throw Exception ("streamlines of incomplete block indexed in incomplete file");
+    Streamline<ValueType> tck;
+    size_t count = 0;
+    while (reader (tck)) {
+      check_equal (tck, tracks[count], count);
+      ++count;
+    }
+    if (count != num)
+      throw Exception ("unexpected number of streamlines read from incomplete file: expected " + str(num) + ", got " + str(count));
+  }
+
+  // a corrupt block must be reported as such, rather than attempting to
+  // allocate the streamline or vertex counts it claims to contain:
+  for (const auto& counts : { std::make_pair (uint32_t (1), uint64_t (1) << 40),
+                              std::make_pair (uint32_t (0xFFFFFFFF), uint64_t (0)) }) {
+    {
+      Properties properties;
+      WriterType writer (filename, properties);
+    }
+    vector<char> contents;
+    {
+      std::ifstream in (filename, std::ios::in | std::ios::binary);
+      contents.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char>());
+    }
+    const std::string header (contents.begin(), contents.end());
+    const size_t pos = header.find ("\nfile: . ");
+    if (pos == std::string::npos)
+      throw Exception ("data offset not found in compressed tracks file header");
+    contents.resize (to<size_t> (header.substr (pos + 9, header.find ('\n', pos + 1) - pos - 9)));
+
+    vector<uint8_t> raw;
+    Compressed::put_varint (raw, counts.second);
+    vector<uint8_t> block (Compressed::block_header_size + compressBound (raw.size()));
+    uLongf compressed_size = block.size() - Compressed::block_header_size;
+    compress (block.data() + Compressed::block_header_size, &compressed_size, raw.data(), raw.size());
+    Raw::store_LE<uint32_t> (counts.first, block.data(), 0);
+    Raw::store_LE<uint32_t> (raw.size(), block.data(), 1);
+    Raw::store_LE<uint32_t> (compressed_size, block.data(), 2);
+    block.resize (Compressed::block_header_size + compressed_size);
+    block.resize (block.size() + Compressed::block_header_size, 0);
+    contents.insert (contents.end(), block.begin(), block.end());
+    {
+      std::ofstream out (filename, std::ios::out | std::ios::binary | std::ios::trunc);
+      out.write (contents.data(), contents.size());
+    }
+
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    Streamline<ValueType> tck;
+    bool rejected = false;
+    try {
+      reader (tck);
+    }
+    catch (Exception& e) {
+      rejected = e.description.back().find ("malformed") != std::string::npos;
+    }
+    if (!rejected)
+      throw Exception ("corrupt block not reported as malformed in compressed tracks file");
+  }
+}
+
+
+
+void run ()
+{
+  // use small blocks, so that the data span many blocks:
+  File::Config::set ("TrackCompressionBlockSize", "4096");
+
+  App::overwrite_files = true;
+  const std::string filename = File::create_tempfile (0, "tckz");
+  try {
+    check<float, Writer<float>> (filename);
+    check<double, Writer<double>> (filename);
+    check<float, WriterUnbuffered<float>> (filename);
+  }
+  catch (...) {
+    File::remove (filename);
+    throw;
+  }
+  File::remove (filename);
+}
+
@@ -0,0 +1,274 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "command.h"
+#include "exception.h"
+#include "file/config.h"
+#include "file/utils.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of memory-mapped track file reading and indexing";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void remove_index (const std::string& filename)
+{
+  if (Path::exists (MappedStreamlines::index_path (filename)))
+    File::remove (MappedStreamlines::index_path (filename));
+}
+
+
+
+template <typename ValueType>
+void check_equal (const Streamline<ValueType>& a, const Streamline<ValueType>& b, size_t index)
+{
+  if (a.get_index() != index)
+    throw Exception ("streamline read with incorrect index: expected " + str(index) + ", got " + str(a.get_index()));
+  if (a.size() != b.size())
+    throw Exception ("streamline " + str(index) + " read with incorrect length: expected " + str(b.size()) + ", got " + str(a.size()));
+  for (size_t n = 0; n != a.size(); ++n)
+    if (a[n] != b[n])
+      throw Exception ("vertex mismatch at position " + str(n) + " in streamline " + str(index));
+}
+
+
+
+template <typename ValueType>
+void check (const std::string& filename)
+{
+  using point_type = typename Streamline<ValueType>::point_type;
+
+  // generate streamlines of varying length, including empty streamlines
+  // and streamlines longer than the block size used to locate delimiters:
+  vector<Streamline<ValueType>> tracks (1000);
+  uint32_t state = 1;
+  for (size_t i = 0; i != tracks.size(); ++i) {
+    tracks[i].resize ((i % 97 == 0) ? 0 : (i * 7) % 61 + 1);
+    for (auto& p : tracks[i]) {
+      for (size_t axis = 0; axis != 3; ++axis) {
+        state = 1664525U * state + 1013904223U;
+        p[axis] = ValueType (state >> 8) / ValueType (1 << 20) - ValueType(8.0);
+      }
+    }
+  }
+
+  remove_index (filename);
+  {
+    Properties properties;
+    Writer<ValueType> writer (filename, properties);
+    for (const auto& tck : tracks)
+      writer (tck);
+  }
+
+  // sequential access:
+  {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    Streamline<ValueType> tck;
+    size_t count = 0;
+    while (reader (tck)) {
+      if (count >= tracks.size())
+        throw Exception ("more streamlines read than written");
+      check_equal (tck, tracks[count], count);
+      ++count;
+    }
+    if (count != tracks.size())
+      throw Exception ("fewer streamlines read than written: expected " + str(tracks.size()) + ", got " + str(count));
+  }
+
+  // by default, no sidecar index is saved:
+  {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    if (reader.num_streamlines() != tracks.size())
+      throw Exception ("index contains incorrect number of streamlines: expected " + str(tracks.size()) + ", got " + str(reader.num_streamlines()));
+    if (Path::exists (MappedStreamlines::index_path (filename)))
+      throw Exception ("sidecar index file saved without TrackIndexSidecar config file option");
+  }
+  File::Config::set ("TrackIndexSidecar", "1");
+
+  // random access, generating the index then reusing the sidecar file:
+  for (size_t pass = 0; pass != 2; ++pass) {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    if (reader.num_streamlines() != tracks.size())
+      throw Exception ("index contains incorrect number of streamlines: expected " + str(tracks.size()) + ", got " + str(reader.num_streamlines()));
+    if (!Path::exists (MappedStreamlines::index_path (filename)))
+      throw Exception ("sidecar index file not saved");
+    Streamline<ValueType> tck;
+    for (size_t start : { 0, 1, 96, 97, 500, 999 }) {
+      reader.seek (start);
+      for (size_t i = start; i != std::min (start + 3, tracks.size()); ++i) {
+        if (!reader (tck))
+          throw Exception ("failed to read streamline " + str(i) + " after seeking to " + str(start));
+        check_equal (tck, tracks[i], i);
+      }
+    }
+    reader.seek (tracks.size());
+    if (reader (tck))
+      throw Exception ("streamline read after seeking to end of file");
+  }
+
+  // a sidecar index must not be reused once the data have changed, even if
+  // the file size and modification time have not: swap the delimiter after
+  // streamline 500 with the vertex that follows it, and restore the timestamp
+  {
+    struct stat sbuf;
+    if (stat (filename.c_str(), &sbuf))
+      throw Exception ("cannot stat tracks file \"" + filename + "\"");
+    size_t num_points = 1, delimiter = 0;
+    for (size_t i = 0; i != tracks.size(); ++i) {
+      num_points += tracks[i].size() + 1;
+      if (i == 500)
+        delimiter = num_points - 2;
+    }
+    const int64_t offset = sbuf.st_size - num_points * sizeof (point_type);
+    {
+      std::fstream file (filename, std::ios::in | std::ios::out | std::ios::binary);
+      char vertices[2 * sizeof (point_type)];
+      file.seekg (offset + delimiter * sizeof (point_type));
+      file.read (vertices, sizeof (vertices));
+      std::swap_ranges (vertices, vertices + sizeof (point_type), vertices + sizeof (point_type));
+      file.seekp (offset + delimiter * sizeof (point_type));
+      file.write (vertices, sizeof (vertices));
+      if (!file)
+        throw Exception ("error modifying tracks file \"" + filename + "\"");
+    }
+    struct utimbuf times;
+    times.actime = sbuf.st_atime;
+    times.modtime = sbuf.st_mtime;
+    utime (filename.c_str(), &times);
+
+    auto modified = tracks;
+    modified[500].push_back (modified[501].front());
+    modified[501].erase (modified[501].begin());
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    Streamline<ValueType> tck;
+    for (size_t i : { 499, 500, 501, 502 }) {
+      reader.get (i, tck);
+      check_equal (tck, modified[i], i);
+    }
+  }
+  {
+    Properties properties;
+    Writer<ValueType> writer (filename, properties);
+    for (const auto& tck : tracks)
+      writer (tck);
+  }
+
+  // direct access & range-restricted reading:
+  {
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    Streamline<ValueType> tck;
+    for (size_t i : { 999, 0, 97, 500 }) {
+      reader.get (i, tck);
+      check_equal (tck, tracks[i], i);
+    }
+    vector<Streamline<ValueType>> range;
+    reader.get_range (95, 99, range);
+    for (size_t i = 0; i != range.size(); ++i)
+      check_equal (range[i], tracks[95+i], 95+i);
+
+    // shards must cover all streamlines contiguously, and streamlines read
+    // within a range are indexed relative to its start:
+    const size_t num_shards = 7;
+    size_t next = 0;
+    for (size_t n = 0; n != num_shards; ++n) {
+      const auto shard = reader.shard (n, num_shards);
+      if (shard.first != next || shard.second < shard.first)
+        throw Exception ("shard " + str(n) + " of " + str(num_shards) + " is not contiguous with previous shard");
+      reader.set_range (shard.first, shard.second);
+      size_t count = 0;
+      while (reader (tck)) {
+        check_equal (tck, tracks[shard.first + count], count);
+        ++count;
+      }
+      if (count != shard.second - shard.first)
+        throw Exception ("unexpected number of streamlines read from shard " + str(n) + ": expected " + str(shard.second - shard.first) + ", got " + str(count));
+      next = shard.second;
+    }
+    if (next != tracks.size())
+      throw Exception ("shards do not cover all streamlines");
+  }
+
+  // an incomplete file must only yield its complete streamlines, and must
+  // not produce a sidecar index:
+  {
+    vector<char> contents;
+    {
+      std::ifstream in (filename, std::ios::in | std::ios::binary);
+      contents.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char>());
+    }
+    contents.resize (contents.size() - 5 * sizeof (point_type) - 1);
+    {
+      std::ofstream out (filename, std::ios::out | std::ios::binary | std::ios::trunc);
+      out.write (contents.data(), contents.size());
+    }
+    remove_index (filename);
+
+    Properties properties;
+    Reader<ValueType> reader (filename, properties);
+    if (reader.num_streamlines() != tracks.size() - 1)
+      throw Exception ("unexpected number of streamlines indexed in incomplete file: " + str(reader.num_streamlines()));
+    if (Path::exists (MappedStreamlines::index_path (filename)))
+      throw Exception ("sidecar index file saved for incomplete file");
+    Streamline<ValueType> tck;
+    size_t count = 0;
+    while (reader (tck))
+      ++count;
+    if (count != tracks.size() - 1)
+      throw Exception ("unexpected number of streamlines read from incomplete file: " + str(count));
+  }
+
+  File::Config::set ("TrackIndexSidecar", "0");
+}
+
+
+
+void run ()
+{
+  App::overwrite_files = true;
+  const std::string filename = File::create_tempfile (0, "tck");
+  try {
+    check<float> (filename);
+    check<double> (filename);
+  }
+  catch (...) {
+    File::remove (filename);
+    remove_index (filename);
+    throw;
+  }
+  File::remove (filename);
+  remove_index (filename);
+}
+
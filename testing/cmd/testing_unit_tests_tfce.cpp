@@ -0,0 +1,151 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "filter/connected_components.h"
+#include "math/rng.h"
+#include "math/stats/typedefs.h"
+#include "misc/voxel2vector.h"
+
+#include "connectome/enhance.h"
+#include "stats/cluster.h"
+#include "stats/tfce.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that incremental TFCE integration matches explicit integration over thresholds";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+// TFCE as computed by invoking the cluster enhancer once per threshold:
+template <class EnhancerType>
+matrix_type reference (EnhancerType& enhancer, const matrix_type& in, const value_type dH, const value_type E, const value_type H)
+{
+  matrix_type out (matrix_type::Zero (in.rows(), 1)), temp (in.rows(), 1);
+  const value_type max_input_value = in.maxCoeff();
+  for (value_type h = dH; (h-dH) < max_input_value; h += dH) {
+    enhancer.set_threshold (h);
+    static_cast<Stats::EnhancerBase&> (enhancer) (in, temp);
+    const value_type h_multiplier = std::pow (h, H);
+    for (ssize_t index = 0; index != in.rows(); ++index)
+      out(index,0) += std::pow (temp(index,0), E) * h_multiplier;
+  }
+  return out;
+}
+
+
+
+void check (const std::string& description, const matrix_type& expected, const matrix_type& actual)
+{
+  const value_type scale = std::max (expected.array().abs().maxCoeff(), value_type(1.0));
+  const value_type max_diff = (expected - actual).array().abs().maxCoeff();
+  if (!(max_diff <= 1e-10 * scale))
+    throw Exception ("incremental TFCE does not match explicit integration for " + description
+                     + " (max. difference " + str(max_diff) + ", max. value " + str(scale) + ")");
+}
+
+
+
+void run ()
+{
+  Math::RNG rng (1);
+  std::normal_distribution<value_type> normal;
+
+  const vector<std::tuple<value_type,value_type,value_type>> parameters = {
+    std::make_tuple (0.1, 0.5, 2.0),
+    std::make_tuple (0.05, 1.0, 1.0),
+    std::make_tuple (0.25, 0.0, 2.0),
+    std::make_tuple (0.1, 2.0, 0.0)
+  };
+
+  // voxel-wise clusters within a spherical mask:
+  Header header;
+  header.ndim() = 3;
+  for (size_t axis = 0; axis != 3; ++axis) {
+    header.size(axis) = 20;
+    header.spacing(axis) = 1.0;
+  }
+  header.transform().setIdentity();
+  header.datatype() = DataType::Bit;
+  auto mask = Image<bool>::scratch (header, "mask");
+  for (auto l = Loop (mask) (mask); l; ++l)
+    mask.value() = Math::pow2 (mask.index(0)-9.5) + Math::pow2 (mask.index(1)-9.5) + Math::pow2 (mask.index(2)-9.5) < 90.0;
+  Voxel2Vector v2v (mask, header);
+
+  for (const bool use_26_neighbours : { false, true }) {
+    Filter::Connector connector;
+    connector.adjacency.set_26_adjacency (use_26_neighbours);
+    connector.adjacency.initialise (header, v2v);
+
+    // spatially smooth random field, with some values quantised onto the
+    //   threshold grid so that ties with the thresholds are exercised:
+    matrix_type data (v2v.size(), 1);
+    for (ssize_t i = 0; i != data.rows(); ++i)
+      data(i,0) = normal (rng);
+    for (size_t iter = 0; iter != 3; ++iter) {
+      matrix_type smoothed (data);
+      for (size_t i = 0; i != v2v.size(); ++i) {
+        for (auto j : connector.adjacency[i])
+          smoothed(i,0) += data(j,0);
+        smoothed(i,0) /= connector.adjacency[i].size() + 1;
+      }
+      data = 3.0 * smoothed;
+    }
+    for (ssize_t i = 0; i < data.rows(); i += 7)
+      data(i,0) = 0.1 * std::round (10.0 * data(i,0));
+
+    Stats::Cluster::ClusterSize cluster_size (connector, 0.0);
+    for (const auto& p : parameters) {
+      const value_type dH = std::get<0>(p), E = std::get<1>(p), H = std::get<2>(p);
+      matrix_type actual (data.rows(), 1);
+      Stats::TFCE::Wrapper tfce (std::make_shared<Stats::Cluster::ClusterSize> (connector, 0.0), dH, E, H);
+      static_cast<Stats::EnhancerBase&> (tfce) (data, actual);
+      check ("voxel clusters (" + str(use_26_neighbours ? 26 : 6) + "-neighbour, dh=" + str(dH) + ", E=" + str(E) + ", H=" + str(H) + ")",
+             reference (cluster_size, data, dH, E, H), actual);
+    }
+  }
+
+  // network-based statistic on connectome edges:
+  {
+    const Connectome::node_t num_nodes = 12;
+    Connectome::Enhance::NBS nbs (num_nodes);
+    const size_t num_edges = num_nodes * (num_nodes+1) / 2;
+    matrix_type data (num_edges, 1);
+    for (size_t i = 0; i != num_edges; ++i)
+      data(i,0) = 1.0 + normal (rng);
+    for (const auto& p : parameters) {
+      const value_type dH = std::get<0>(p), E = std::get<1>(p), H = std::get<2>(p);
+      matrix_type actual (data.rows(), 1);
+      Stats::TFCE::Wrapper tfce (std::make_shared<Connectome::Enhance::NBS> (num_nodes), dH, E, H);
+      static_cast<Stats::EnhancerBase&> (tfce) (data, actual);
+      check ("network-based statistic (dh=" + str(dH) + ", E=" + str(E) + ", H=" + str(H) + ")",
+             reference (nbs, data, dH, E, H), actual);
+    }
+  }
+}
+
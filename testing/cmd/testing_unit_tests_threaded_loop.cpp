@@ -0,0 +1,107 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+
+#include "command.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that multi-threaded image loops visit every voxel exactly once";
+  DESCRIPTION
+  + "This should be run with a range of values for the -nthreads option, "
+    "and with both settings of the ThreadedLoopWorkStealing config file option.";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+// count the visits to each voxel, and sum the values visited:
+class Visit { MEMALIGN(Visit)
+  public:
+    Visit (std::atomic<uint64_t>& total) : total (total), sum (0) { }
+    Visit (const Visit& other) : total (other.total), sum (0) { }
+    ~Visit () { total += sum; }
+
+    void operator() (Image<uint32_t>& count, Image<uint32_t>& value) {
+      count.value() = count.value() + 1;
+      sum += value.value();
+    }
+
+  protected:
+    std::atomic<uint64_t>& total;
+    uint64_t sum;
+};
+
+
+
+template <class LoopType>
+void check (LoopType&& loop, const std::string& description, Image<uint32_t>& value, uint64_t expected)
+{
+  auto count = Image<uint32_t>::scratch (value, "visit counts");
+  std::atomic<uint64_t> total (0);
+  {
+    Visit visit (total);
+    loop.run (visit, count, value);
+  }
+  for (auto l = Loop (count) (count); l; ++l) {
+    if (count.value() != 1)
+      throw Exception (description + ": voxel [ " + str(count.index(0)) + " " + str(count.index(1)) + " " + str(count.index(2))
+          + " ] visited " + str(count.value()) + " times");
+  }
+  if (total != expected)
+    throw Exception (description + ": sum of values visited is " + str(uint64_t (total)) + ", expected " + str(expected));
+}
+
+
+
+void run ()
+{
+  Header header;
+  header.ndim() = 3;
+  header.size(0) = 23;
+  header.size(1) = 17;
+  header.size(2) = 19;
+  for (size_t axis = 0; axis != 3; ++axis)
+    header.spacing(axis) = 1.0;
+  header.transform().setIdentity();
+  header.datatype() = DataType::UInt32;
+
+  auto value = Image<uint32_t>::scratch (header, "values");
+  uint32_t state = 1;
+  uint64_t expected = 0;
+  for (auto l = Loop (value) (value); l; ++l) {
+    state = 1664525U * state + 1013904223U;
+    value.value() = state >> 12;
+    expected += state >> 12;
+  }
+
+  // vary the number of outer positions to schedule, from a few (fewer than
+  // some thread counts) to one per row:
+  check (ThreadedLoop (value, 0, 3, 2), "2 inner axes", value, expected);
+  check (ThreadedLoop (value, 0, 3, 1), "1 inner axis", value, expected);
+  check (ThreadedLoop (value, { 2, 0, 1 }, 1), "permuted axes", value, expected);
+  check (ThreadedLoop ("looping with progress", value, 0, 3, 1), "with progress", value, expected);
+}
+
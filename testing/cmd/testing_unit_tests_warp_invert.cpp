@@ -0,0 +1,118 @@
+/* Copyright (c) 2008-2025 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "header.h"
+#include "image.h"
+#include "transform.h"
+#include "algo/loop.h"
+#include "algo/threaded_copy.h"
+#include "registration/warp/compose.h"
+#include "registration/warp/convert.h"
+#include "registration/warp/invert.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that composing a smooth displacement field with its estimated inverse gives the identity";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+// maximum norm of the displacement over voxels at least margin voxels away from the boundary:
+default_type max_interior_norm (Image<default_type>& disp, const ssize_t margin)
+{
+  default_type max_norm = 0.0;
+  for (auto l = Loop (disp, 0, 3) (disp); l; ++l) {
+    bool interior = true;
+    for (size_t axis = 0; axis != 3; ++axis)
+      if (disp.index(axis) < margin || disp.index(axis) >= disp.size(axis) - margin)
+        interior = false;
+    if (interior)
+      max_norm = std::max (max_norm, Eigen::Vector3d (disp.row(3)).norm());
+  }
+  return max_norm;
+}
+
+
+
+void check (const std::string& description, const default_type max_diff, const default_type tolerance)
+{
+  if (!(max_diff <= tolerance))
+    throw Exception ("warp inversion failed for " + description
+                     + " (max. difference " + str(max_diff) + ", tolerance " + str(tolerance) + ")");
+}
+
+
+
+void run ()
+{
+  Header header;
+  header.ndim() = 4;
+  header.size(0) = 48; header.size(1) = 40; header.size(2) = 36; header.size(3) = 3;
+  header.spacing(0) = 1.5; header.spacing(1) = 1.25; header.spacing(2) = 2.0; header.spacing(3) = 1.0;
+  header.transform().setIdentity();
+  header.transform().translation() = Eigen::Vector3d (-30.0, 12.0, 5.0);
+  header.datatype() = DataType::Float64;
+
+  // a smooth displacement of up to 3mm, whose Jacobian is well away from singular:
+  auto disp = Image<default_type>::scratch (header);
+  const MR::Transform transform (disp);
+  for (auto l = Loop (disp, 0, 3) (disp); l; ++l) {
+    const Eigen::Vector3d p = transform.voxel2scanner * Eigen::Vector3d (disp.index(0), disp.index(1), disp.index(2));
+    disp.row(3) = Eigen::Vector3d (1.5 * std::sin (p[1] / 12.0) + 0.5 * std::cos (p[2] / 15.0),
+                                   1.5 * std::cos (p[0] / 14.0) * std::sin (p[2] / 20.0),
+                                   1.0 * std::sin ((p[0] + p[1]) / 16.0));
+  }
+  // (voxels whose inverse would map from beyond the boundary cannot be inverted)
+  const ssize_t margin = 4;
+  // (iterations stop once the squared update, relative to the voxel size, is below this)
+  const default_type error_tolerance = 1e-8;
+
+  // from a zero field, and from the inverse of the neighbouring voxel:
+  for (const bool is_initialised : { true, false }) {
+    auto inverse = Image<default_type>::scratch (header);
+    Registration::Warp::invert_displacement (disp, inverse, 50, error_tolerance, is_initialised);
+
+    auto composed = Image<default_type>::scratch (header);
+    Registration::Warp::update_displacement (inverse, disp, composed);
+    check (std::string ("displacement composed with its inverse, ") + (is_initialised ? "from a zero field" : "not initialised"),
+           max_interior_norm (composed, margin), 1e-3);
+
+    // an initial estimate is used as the starting point:
+    auto estimate = Image<default_type>::scratch (header);
+    threaded_copy (inverse, estimate);
+    Registration::Warp::invert_displacement (disp, estimate, 0);
+    for (auto l = Loop (estimate) (estimate, inverse); l; ++l)
+      estimate.value() -= inverse.value();
+    check ("initial estimate without iterations", max_interior_norm (estimate, 0), 1e-12);
+  }
+
+  // likewise for the deformation field:
+  auto deform = Image<default_type>::scratch (header);
+  Registration::Warp::displacement2deformation (disp, deform);
+  auto inverse = Image<default_type>::scratch (header);
+  Registration::Warp::invert_deformation (deform, inverse, false, 50, error_tolerance);
+  Registration::Warp::deformation2displacement (inverse, inverse);
+  auto composed = Image<default_type>::scratch (header);
+  Registration::Warp::update_displacement (inverse, disp, composed);
+  check ("deformation composed with its inverse", max_interior_norm (composed, margin), 1e-3);
+}
+